@@ -0,0 +1,145 @@
+#include "Address.hh"
+
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <cstddef> // offsetof()
+#include <cstring> // memset(), memcpy(), memcmp()
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/un.h>
+
+using namespace net;
+
+Address::Address()
+: length_(0)
+{
+	memset(&storage_, 0, sizeof(storage_));
+}
+
+Address::Address(const struct sockaddr *addr, socklen_t length)
+{
+	memset(&storage_, 0, sizeof(storage_));
+	setLength(length);
+	memcpy(&storage_, addr, length);
+}
+
+Address
+Address::resolve(const Host &host, const Service &serv, int socktype)
+{
+	int ret;
+	struct addrinfo hints, *res;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = socktype;
+	hints.ai_flags = host.aiFlags() | serv.aiFlags();
+
+	ret = getaddrinfo(host.spec().empty() ? 0 : host.spec().c_str(), serv.spec().c_str(), &hints, &res);
+	if (ret) {
+		throw std::runtime_error(gai_strerror(ret));
+	}
+
+	Address result(res->ai_addr, res->ai_addrlen);
+
+	freeaddrinfo(res);
+	return result;
+}
+
+namespace {
+
+Address
+makeLocal(const std::string &path, size_t offset)
+{
+	struct sockaddr_un sun;
+
+	memset(&sun, 0, sizeof(sun));
+	if (offset + path.size() >= sizeof(sun.sun_path)) {
+		throw std::length_error("unix socket path too long");
+	}
+	sun.sun_family = AF_UNIX;
+	memcpy(sun.sun_path + offset, path.data(), path.size());
+	return Address(reinterpret_cast<struct sockaddr *>(&sun), offsetof(struct sockaddr_un, sun_path) + offset + path.size() + !offset);
+}
+
+} // namespace
+
+Address
+Address::local(const std::string &path)
+{
+	return makeLocal(path, 0);
+}
+
+Address
+Address::abstract(const std::string &name)
+{
+	return makeLocal(name, 1);
+}
+
+void
+Address::setLength(socklen_t length)
+{
+	if (length > sizeof(storage_)) {
+		throw std::length_error("address too long");
+	}
+	length_ = length;
+}
+
+int
+Address::port()
+const
+{
+	switch (family()) {
+	case AF_INET:
+		return ntohs(reinterpret_cast<const struct sockaddr_in *>(&storage_)->sin_port);
+	case AF_INET6:
+		return ntohs(reinterpret_cast<const struct sockaddr_in6 *>(&storage_)->sin6_port);
+	default:
+		return 0;
+	}
+}
+
+std::string
+Address::toString()
+const
+{
+	char host[NI_MAXHOST];
+	char serv[NI_MAXSERV];
+
+	if (family() == AF_UNIX) {
+		const struct sockaddr_un *sun = reinterpret_cast<const struct sockaddr_un *>(&storage_);
+		size_t length = length_ - offsetof(struct sockaddr_un, sun_path);
+
+		if (!length) {
+			return std::string();
+		} else if (!sun->sun_path[0]) {
+			return "@" + std::string(sun->sun_path + 1, length - 1);
+		}
+		return std::string(sun->sun_path, strnlen(sun->sun_path, length));
+	}
+
+	if (!valid() || getnameinfo(get(), length_, host, sizeof(host), serv, sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV)) {
+		return std::string();
+	}
+
+	if (family() == AF_INET6) {
+		return std::string("[") + host + "]:" + serv;
+	}
+	return std::string(host) + ":" + serv;
+}
+
+bool
+Address::operator==(const Address &rhs)
+const
+{
+	return length_ == rhs.length_ && !memcmp(&storage_, &rhs.storage_, length_);
+}
+
+bool
+Address::operator<(const Address &rhs)
+const
+{
+	if (length_ != rhs.length_) {
+		return length_ < rhs.length_;
+	}
+	return memcmp(&storage_, &rhs.storage_, length_) < 0;
+}
@@ -0,0 +1,43 @@
+#ifndef REACTOR_NET_ADDRESS_HEADER
+#define REACTOR_NET_ADDRESS_HEADER
+
+#include <net/Host.hh>
+#include <net/Service.hh>
+
+#include <string>
+#include <sys/socket.h>
+
+namespace net {
+
+class Address {
+	struct sockaddr_storage storage_;
+	socklen_t length_;
+
+public:
+	Address();
+	Address(const struct sockaddr *addr, socklen_t length);
+
+	static Address resolve(const Host &host, const Service &serv, int socktype = 0);
+	// AF_UNIX addresses, abstract ones live outside the filesystem
+	static Address local(const std::string &path);
+	static Address abstract(const std::string &name);
+
+	const struct sockaddr *get() const { return reinterpret_cast<const struct sockaddr *>(&storage_); }
+	struct sockaddr *get() { return reinterpret_cast<struct sockaddr *>(&storage_); }
+	socklen_t length() const { return length_; }
+	void setLength(socklen_t length);
+	static socklen_t capacity() { return sizeof(struct sockaddr_storage); }
+
+	bool valid() const { return length_ != 0; }
+	int family() const { return storage_.ss_family; }
+	int port() const;
+	std::string toString() const;
+
+	bool operator==(const Address &rhs) const;
+	bool operator!=(const Address &rhs) const { return !(*this == rhs); }
+	bool operator<(const Address &rhs) const;
+};
+
+} // namespace net
+
+#endif // REACTOR_NET_ADDRESS_HEADER
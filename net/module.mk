@@ -3,6 +3,7 @@
 all: out/libnet.a
 
 libnet_SOURCE_NAMES := \
+	Address.cc \
 	Host.cc \
 	Ip.cc \
 	Port.cc \
@@ -0,0 +1,13 @@
+#ifndef REACTOR_REACTOR_ACCEPTCOMMAND_HEADER
+#define REACTOR_REACTOR_ACCEPTCOMMAND_HEADER
+
+#include <util/Command.hh>
+#include <util/Fd.hh>
+
+namespace reactor {
+
+typedef util::Command1<void, const util::Fd &> AcceptCommand;
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_ACCEPTCOMMAND_HEADER
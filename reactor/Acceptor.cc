@@ -0,0 +1,155 @@
+#include "Acceptor.hh"
+
+#include <util/ErrnoException.hh>
+
+#include <algorithm> // std::min
+#include <stdexcept>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_DEFER_ACCEPT
+#include <sys/socket.h>
+
+using namespace reactor;
+
+const int Acceptor::DEFAULT_BACKLOG = SOMAXCONN;
+const size_t Acceptor::DEFAULT_BATCH_SIZE = 64;
+const util::DiffTime Acceptor::DEFAULT_PAUSE_DELAY = util::DiffTime::ms(10);
+const util::DiffTime Acceptor::MAX_PAUSE_DELAY = util::DiffTime::ms(1000);
+
+Acceptor::Acceptor(Dispatcher &dispatcher, const AcceptCommand &command)
+: dispatcher_(dispatcher)
+, command_(command.clone())
+, backlog_(DEFAULT_BACKLOG)
+, batchSize_(DEFAULT_BATCH_SIZE)
+, pauseDelay_(DEFAULT_PAUSE_DELAY)
+, delay_(DEFAULT_PAUSE_DELAY)
+, paused_(false)
+, registered_(false)
+, exhausted_(0)
+{}
+
+Acceptor::~Acceptor()
+{
+	dispatcher_.removeTimers(this);
+	if (registered_) {
+		dispatcher_.remove(FdEvent(sock_.fd(), FdEvent::READ));
+	}
+}
+
+void
+Acceptor::setBatchSize(size_t batchSize)
+{
+	if (!batchSize) {
+		throw std::invalid_argument("batch size must be positive");
+	}
+	batchSize_ = batchSize;
+}
+
+void
+Acceptor::setReuseAddr(bool on)
+{
+	sock_.setOption(SOL_SOCKET, SO_REUSEADDR, on);
+}
+
+void
+Acceptor::setReusePort(bool on)
+{
+	sock_.setOption(SOL_SOCKET, SO_REUSEPORT, on);
+}
+
+void
+Acceptor::setDeferAccept(int seconds)
+{
+	sock_.setOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds);
+}
+
+void
+Acceptor::setIncomingCpu(int cpu)
+{
+	sock_.setOption(SOL_SOCKET, SO_INCOMING_CPU, cpu);
+}
+
+int
+Acceptor::incomingCpu(const util::Fd &fd)
+{
+	int cpu;
+	socklen_t len = sizeof(cpu);
+
+	if (getsockopt(fd.get(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len)) {
+		throw util::ErrnoException("getsockopt");
+	}
+	return cpu;
+}
+
+void
+Acceptor::listen(const net::Host &host, const net::Service &serv)
+{
+	if (sock_.fd().valid()) {
+		throw std::runtime_error("acceptor is already listening");
+	}
+
+	sock_.bind(host, serv);
+	try {
+		sock_.blocking(false);
+		sock_.listen(backlog_);
+		dispatcher_.add(FdEvent(sock_.fd(), FdEvent::READ), util::commandForMethod(*this, &Acceptor::onReadable));
+	} catch (...) {
+		// a later listen() may try again
+		sock_.close();
+		throw;
+	}
+	registered_ = true;
+}
+
+void
+Acceptor::onReadable(const FdEvent &event)
+{
+	for (size_t i = 0; i < batchSize_; ++i) {
+		int fd = accept4(event.fd.get(), 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+		if (fd < 0) {
+			switch (errno) {
+			case EINTR:
+			case ECONNABORTED:
+			case EPROTO:
+				continue;
+			case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+			case EWOULDBLOCK:
+#endif
+				return;
+			case EMFILE:
+			case ENFILE:
+			case ENOBUFS:
+			case ENOMEM:
+				++exhausted_;
+				pause();
+				return;
+			default:
+				throw util::ErrnoException("accept4");
+			}
+		}
+
+		delay_ = pauseDelay_;
+		command_->execute(util::Fd(fd));
+	}
+}
+
+void
+Acceptor::pause()
+{
+	// the pending connections wait in the listen queue meanwhile
+	dispatcher_.remove(FdEvent(sock_.fd(), FdEvent::READ));
+	registered_ = false;
+	dispatcher_.add(Timer(delay_, 1), util::commandForMethod(*this, &Acceptor::onResume), this);
+	paused_ = true;
+	delay_ = util::DiffTime::raw(std::min(delay_.raw() * 2, MAX_PAUSE_DELAY.raw()));
+}
+
+void
+Acceptor::onResume(const TimerEvent &)
+{
+	paused_ = false;
+	dispatcher_.add(FdEvent(sock_.fd(), FdEvent::READ), util::commandForMethod(*this, &Acceptor::onReadable));
+	registered_ = true;
+}
@@ -0,0 +1,67 @@
+#ifndef REACTOR_REACTOR_ACCEPTOR_HEADER
+#define REACTOR_REACTOR_ACCEPTOR_HEADER
+
+#include <reactor/AcceptCommand.hh>
+#include <reactor/Dispatcher.hh>
+#include <reactor/StreamSock.hh>
+
+#include <net/Host.hh>
+#include <net/Service.hh>
+#include <util/Noncopyable.hh>
+
+#include <memory> // unique_ptr
+
+namespace reactor {
+
+// Out of descriptors or memory, accept() keeps failing while the listening
+// socket stays readable, so accepting pauses for a delay that doubles while
+// the shortage lasts instead of spinning the loop.
+class Acceptor : public util::Noncopyable {
+	Dispatcher &dispatcher_;
+	std::unique_ptr<AcceptCommand> command_;
+	StreamSock sock_;
+	int backlog_;
+	size_t batchSize_;
+	util::DiffTime pauseDelay_;
+	util::DiffTime delay_;
+	bool paused_;
+	// the listening socket is watched by the dispatcher
+	bool registered_;
+	size_t exhausted_;
+
+	void pause();
+
+	void onReadable(const FdEvent &event);
+	void onResume(const TimerEvent &event);
+
+public:
+	static const int DEFAULT_BACKLOG;
+	static const size_t DEFAULT_BATCH_SIZE;
+	static const util::DiffTime DEFAULT_PAUSE_DELAY;
+	static const util::DiffTime MAX_PAUSE_DELAY;
+
+	Acceptor(Dispatcher &dispatcher, const AcceptCommand &command);
+	~Acceptor();
+
+	void setBacklog(int backlog) { backlog_ = backlog; }
+	void setBatchSize(size_t batchSize);
+	void setPauseDelay(const util::DiffTime &pauseDelay) { pauseDelay_ = delay_ = pauseDelay; }
+	void setReuseAddr(bool on);
+	void setReusePort(bool on);
+	void setDeferAccept(int seconds);
+	void setIncomingCpu(int cpu);
+
+	void listen(const net::Host &host, const net::Service &serv);
+
+	const util::Fd &fd() const { return sock_.fd(); }
+	net::Address localAddress() const { return sock_.localAddress(); }
+	bool paused() const { return paused_; }
+	// accept() failures for lack of descriptors or memory
+	size_t exhausted() const { return exhausted_; }
+
+	static int incomingCpu(const util::Fd &fd);
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_ACCEPTOR_HEADER
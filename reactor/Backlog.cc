@@ -4,27 +4,166 @@
 
 using namespace reactor;
 
-Backlog::~Backlog()
+const size_t Backlog::DEFAULT_CAPACITY = 64;
+
+namespace {
+
+size_t
+roundUp(size_t n)
 {
-	while (!queue_.empty()) {
-		delete queue_.front();
-		queue_.pop();
+	size_t result = 1;
+
+	while (result < n) {
+		result <<= 1;
 	}
+	return result;
 }
 
+} // namespace
+
+Backlog::Backlog(util::Arena &arena, size_t capacity)
+: arena_(arena)
+, ring_(roundUp(capacity ? capacity : 1))
+, head_(0)
+, count_(0)
+, policy_(GROW)
+, highWaterMark_(0)
+, rejected_(0)
+, shed_(0)
+{}
+
 void
-Backlog::enqueueClone(const Job &job)
+Backlog::resize(size_t capacity)
 {
-	queue_.push(job.clone());
+	Ring ring(capacity);
+
+	for (size_t i = 0; i < count_; ++i) {
+		ring[i] = at(i);
+	}
+	ring_.swap(ring);
+	head_ = 0;
+}
+
+void
+Backlog::setCapacity(size_t capacity)
+{
+	if (!capacity) {
+		throw std::invalid_argument("backlog capacity must be positive");
+	}
+
+	size_t rounded = roundUp(capacity);
+
+	if (rounded < count_) {
+		throw std::invalid_argument("backlog capacity below queued jobs");
+	}
+	if (rounded != ring_.size()) {
+		resize(rounded);
+	}
+}
+
+void
+Backlog::reserve(size_t jobs)
+{
+	if (jobs > ring_.size()) {
+		resize(roundUp(jobs));
+	}
+}
+
+bool
+Backlog::admit(Priority priority)
+{
+	if (count_ < ring_.size() || priority == HIGH || policy_ == GROW) {
+		return true;
+	} else if (policy_ == SHED) {
+		for (size_t i = 0; i < count_; ++i) {
+			if (at(i).priority < priority) {
+				return true;
+			}
+		}
+		++shed_;
+	} else {
+		++rejected_;
+	}
+	return false;
+}
+
+// drops the oldest job with the lowest priority under the given one
+bool
+Backlog::shedBelow(Priority priority)
+{
+	size_t victim = count_;
+
+	for (size_t i = 0; i < count_; ++i) {
+		Priority p = at(i).priority;
+
+		if (p < priority && (victim == count_ || p < at(victim).priority)) {
+			victim = i;
+		}
+	}
+	if (victim == count_) {
+		return false;
+	}
+
+	// the arena still destroys the job, which releases whatever it holds
+	for (size_t i = victim; i + 1 < count_; ++i) {
+		at(i) = at(i + 1);
+	}
+	--count_;
+	++shed_;
+	return true;
+}
+
+bool
+Backlog::makeRoom(Priority priority)
+{
+	if (count_ == ring_.size()) {
+		if (!admit(priority)) {
+			return false;
+		}
+		if (priority == HIGH || policy_ == GROW || !shedBelow(priority)) {
+			resize(ring_.size() * 2);
+		}
+	}
+	return true;
+}
+
+void
+Backlog::push(Job *job, Priority priority)
+{
+	at(count_) = Entry(job, priority);
+	if (++count_ > highWaterMark_) {
+		highWaterMark_ = count_;
+	}
+}
+
+bool
+Backlog::enqueueClone(const Job &job, Priority priority)
+{
+	if (!makeRoom(priority)) {
+		return false;
+	}
+	push(job.clone(arena_), priority);
+	return true;
+}
+
+bool
+Backlog::enqueue(Job *job, Priority priority)
+{
+	if (!makeRoom(priority)) {
+		return false;
+	}
+	push(job, priority);
+	return true;
 }
 
 Backlog::Job *
 Backlog::dequeue()
 {
-	if (!queue_.empty()) {
-		Job *job = queue_.front();
-		queue_.pop();
+	if (!empty()) {
+		Job *job = ring_[head_].job;
 
+		head_ = (head_ + 1) & (ring_.size() - 1);
+		--count_;
 		return job;
 	} else {
 		throw std::runtime_error("no jobs in backlog to execute");
@@ -35,5 +174,5 @@ bool
 Backlog::empty()
 const
 {
-	return queue_.empty();
+	return !count_;
 }
@@ -1,28 +1,92 @@
 #ifndef REACTOR_REACTOR_BACKLOG_HEADER
 #define REACTOR_REACTOR_BACKLOG_HEADER
 
+#include <util/Arena.hh>
 #include <util/BoundCommand.hh>
 
-#include <queue>
+#include <vector>
 #include <cstddef>
 
 namespace reactor {
 
+// A ring of jobs with power-of-two capacity. Jobs are cloned into the arena
+// and stay valid until it is reset, so dequeued jobs are not deleted by the
+// caller. When the ring is full the overload policy decides: GROW doubles
+// it, REJECT refuses new jobs until it drains, SHED drops the oldest job of
+// the lowest priority to make room. HIGH priority jobs are never refused or
+// shed, the ring grows for them instead.
 class Backlog {
 public:
 	typedef util::Command0<void> Job;
 
+	enum Priority {
+		LOW,
+		NORMAL,
+		HIGH
+	};
+
+	enum OverloadPolicy {
+		GROW,
+		REJECT,
+		SHED
+	};
+
+	static const size_t DEFAULT_CAPACITY;
+
 private:
-	typedef std::queue<Job *> Queue;
+	struct Entry {
+		Job *job;
+		Priority priority;
+
+		Entry(Job *job0 = 0, Priority priority0 = NORMAL)
+		: job(job0)
+		, priority(priority0)
+		{}
+	};
+	typedef std::vector<Entry> Ring;
+
+	util::Arena &arena_;
+	Ring ring_;
+	size_t head_;
+	size_t count_;
+	OverloadPolicy policy_;
 
-	Queue queue_;
+	size_t highWaterMark_;
+	size_t rejected_;
+	size_t shed_;
+
+	Entry &at(size_t i) { return ring_[(head_ + i) & (ring_.size() - 1)]; }
+	void resize(size_t capacity);
+	bool shedBelow(Priority priority);
+	bool makeRoom(Priority priority);
+	void push(Job *job, Priority priority);
 
 public:
-	~Backlog();
+	explicit Backlog(util::Arena &arena, size_t capacity = DEFAULT_CAPACITY);
+
+	void setOverloadPolicy(OverloadPolicy policy) { policy_ = policy; }
+	// rounds up to a power of two, cannot drop queued jobs
+	void setCapacity(size_t capacity);
+	void reserve(size_t jobs);
 
-	void enqueueClone(const Job &job);
+	// whether a job of this priority would be queued right now, a refusal is counted
+	bool admit(Priority priority);
+	// returns false when the job was refused or shed on arrival
+	bool enqueueClone(const Job &job, Priority priority = NORMAL);
+	// for a job the arena already owns
+	bool enqueue(Job *job, Priority priority = NORMAL);
 	Job *dequeue();
 	bool empty() const;
+
+	size_t size() const { return count_; }
+	size_t capacity() const { return ring_.size(); }
+	OverloadPolicy overloadPolicy() const { return policy_; }
+	size_t highWaterMark() const { return highWaterMark_; }
+	size_t rejected() const { return rejected_; }
+	size_t shed() const { return shed_; }
+	void resetHighWaterMark() { highWaterMark_ = count_; }
+
+	util::Arena &arena() const { return arena_; }
 };
 
 } // namespace reactor
@@ -0,0 +1,269 @@
+#include "ChildProcess.hh"
+
+#include <util/ErrnoException.hh>
+#include <util/Pipe.hh>
+
+#include <algorithm> // std::find
+#include <stdexcept>
+#include <cerrno>
+#include <cstring> // memset()
+#include <fcntl.h> // O_CLOEXEC
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+using namespace reactor;
+
+namespace {
+
+int
+pidfdOpen(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return syscall(SYS_pidfd_open, pid, 0);
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+class SpawnActions : public util::Noncopyable {
+	posix_spawn_file_actions_t actions_;
+
+public:
+	SpawnActions() { posix_spawn_file_actions_init(&actions_); }
+	~SpawnActions() { posix_spawn_file_actions_destroy(&actions_); }
+
+	void dup2(const util::Fd &fd, int target) { posix_spawn_file_actions_adddup2(&actions_, fd.get(), target); }
+	const posix_spawn_file_actions_t *get() const { return &actions_; }
+};
+
+class SpawnAttributes : public util::Noncopyable {
+	posix_spawnattr_t attributes_;
+
+public:
+	SpawnAttributes()
+	{
+		sigset_t none;
+
+		// the dispatcher's signalfd signals are blocked here and must not stay blocked in the child
+		sigemptyset(&none);
+		posix_spawnattr_init(&attributes_);
+		posix_spawnattr_setsigmask(&attributes_, &none);
+		posix_spawnattr_setflags(&attributes_, POSIX_SPAWN_SETSIGMASK);
+	}
+	~SpawnAttributes() { posix_spawnattr_destroy(&attributes_); }
+
+	const posix_spawnattr_t *get() const { return &attributes_; }
+};
+
+} // namespace
+
+// SIGCHLD says nothing about which child exited, so every child watched
+// through it is checked. One dispatcher per thread owns the registration.
+struct ChildProcess::SignalWatch {
+	typedef std::vector<ChildProcess *> Children;
+
+	Dispatcher *dispatcher;
+	Children children;
+
+	SignalWatch() : dispatcher(0) {}
+
+	void
+	onSignal(const SignalEvent &)
+	{
+		// an exit command may spawn or destroy children, walk a copy
+		Children copy(children);
+
+		for (Children::const_iterator i(copy.begin()); i != copy.end(); ++i) {
+			if (std::find(children.begin(), children.end(), *i) != children.end()) {
+				(*i)->reap();
+			}
+		}
+	}
+};
+
+ChildProcess::SignalWatch &
+ChildProcess::signalWatch()
+{
+	static thread_local SignalWatch watch;
+
+	return watch;
+}
+
+ChildProcess::ChildProcess(Dispatcher &dispatcher, const ExitCommand &exitCommand)
+: dispatcher_(dispatcher)
+, exitCommand_(exitCommand.clone())
+, watch_(PIDFD)
+, pid_(0)
+{}
+
+ChildProcess::~ChildProcess()
+{
+	unwatch();
+}
+
+void
+ChildProcess::spawn(const Arguments &arguments, int stdio)
+{
+	if (running()) {
+		throw std::runtime_error("child process is already running");
+	} else if (arguments.empty()) {
+		throw std::invalid_argument("no program to spawn");
+	}
+
+	// parent ends must not leak into other children
+	std::unique_ptr<util::Pipe> in(stdio & STDIN ? new util::Pipe(O_CLOEXEC) : 0);
+	std::unique_ptr<util::Pipe> out(stdio & STDOUT ? new util::Pipe(O_CLOEXEC) : 0);
+	std::unique_ptr<util::Pipe> err(stdio & STDERR ? new util::Pipe(O_CLOEXEC) : 0);
+	SpawnActions actions;
+	SpawnAttributes attributes;
+	std::vector<char *> argv;
+
+	if (in) {
+		actions.dup2(in->readFd(), STDIN_FILENO);
+	}
+	if (out) {
+		actions.dup2(out->writeFd(), STDOUT_FILENO);
+	}
+	if (err) {
+		actions.dup2(err->writeFd(), STDERR_FILENO);
+	}
+	for (Arguments::const_iterator i(arguments.begin()); i != arguments.end(); ++i) {
+		argv.push_back(const_cast<char *>(i->c_str()));
+	}
+	argv.push_back(0);
+
+	// with the SIGCHLD watch the signal has to be blocked before the child can exit
+	if (watch_ == SIGNAL) {
+		watch();
+	}
+
+	pid_t pid;
+	int ret = posix_spawnp(&pid, argv[0], actions.get(), attributes.get(), &argv[0], environ);
+
+	if (ret) {
+		unwatch();
+		throw util::ErrnoException("posix_spawnp", ret);
+	}
+	pid_ = pid;
+	if (watch_ == PIDFD) {
+		try {
+			watch();
+		} catch (...) {
+			// nothing would ever reap the child
+			unwatch();
+			::kill(pid_, SIGKILL);
+			waitpid(pid_, 0, 0);
+			pid_ = 0;
+			throw;
+		}
+	}
+
+	if (in) {
+		in_.reset(new StreamConnection(dispatcher_));
+		in_->adopt(util::Fd(in->releaseWriteFd()));
+		// nothing to read from the write end
+		in_->pauseReading();
+	}
+	if (out) {
+		out_.reset(new StreamConnection(dispatcher_));
+		out_->adopt(util::Fd(out->releaseReadFd()));
+	}
+	if (err) {
+		err_.reset(new StreamConnection(dispatcher_));
+		err_->adopt(util::Fd(err->releaseReadFd()));
+	}
+}
+
+void
+ChildProcess::watch()
+{
+	if (watch_ == PIDFD) {
+		int fd = pidfdOpen(pid_);
+
+		if (fd >= 0) {
+			pidfd_.reset(fd);
+			dispatcher_.add(FdEvent(pidfd_, FdEvent::READ), util::commandForMethod(*this, &ChildProcess::onPidfd));
+			return;
+		}
+		// ENOSYS on old kernels, EMFILE and the like leave SIGCHLD just as good
+		watch_ = SIGNAL;
+	}
+
+	SignalWatch &watch = signalWatch();
+
+	if (!watch.dispatcher) {
+		dispatcher_.add(Signal(SIGCHLD), util::commandForMethod(watch, &SignalWatch::onSignal));
+		watch.dispatcher = &dispatcher_;
+	} else if (watch.dispatcher != &dispatcher_) {
+		throw std::runtime_error("SIGCHLD is watched by another dispatcher");
+	}
+	watch.children.push_back(this);
+	// the child may have exited before SIGCHLD was blocked
+	if (running()) {
+		reap();
+	}
+}
+
+void
+ChildProcess::unwatch()
+{
+	if (pidfd_.valid()) {
+		dispatcher_.remove(FdEvent(pidfd_, FdEvent::READ));
+		pidfd_.reset();
+		return;
+	}
+
+	SignalWatch &watch = signalWatch();
+	SignalWatch::Children::iterator i(std::find(watch.children.begin(), watch.children.end(), this));
+
+	if (i == watch.children.end()) {
+		return;
+	}
+	watch.children.erase(i);
+	if (watch.children.empty()) {
+		dispatcher_.remove(Signal(SIGCHLD));
+		watch.dispatcher = 0;
+	}
+}
+
+bool
+ChildProcess::reap()
+{
+	siginfo_t info;
+
+	memset(&info, 0, sizeof(info));
+	if (waitid(P_PID, pid_, &info, WEXITED | WNOHANG)) {
+		throw util::ErrnoException("waitid");
+	} else if (!info.si_pid) {
+		return false;
+	}
+
+	ExitEvent event(pid_, info.si_code, info.si_status);
+
+	unwatch();
+	pid_ = 0;
+	exitCommand_->execute(event);
+	return true;
+}
+
+void
+ChildProcess::kill(int signal)
+{
+	if (!running()) {
+		throw std::runtime_error("child process is not running");
+	} else if (::kill(pid_, signal)) {
+		throw util::ErrnoException("kill");
+	}
+}
+
+void
+ChildProcess::onPidfd(const FdEvent &)
+{
+	reap();
+}
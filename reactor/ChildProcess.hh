@@ -0,0 +1,101 @@
+#ifndef REACTOR_REACTOR_CHILDPROCESS_HEADER
+#define REACTOR_REACTOR_CHILDPROCESS_HEADER
+
+#include <reactor/Dispatcher.hh>
+#include <reactor/StreamConnection.hh>
+
+#include <util/AutoFd.hh>
+#include <util/Noncopyable.hh>
+
+#include <memory> // unique_ptr
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <sys/types.h> // pid_t
+
+namespace reactor {
+
+// Spawns a child and reports its exit as a dispatcher event. The exit is
+// watched through a pidfd, or through SIGCHLD on a signalfd where
+// pidfd_open fails, on old kernels or out of fds. A child that cannot be
+// watched at all is killed and reaped before spawn() throws. Captured stdio ends are non-blocking stream
+// connections; output may still arrive after the exit event, the
+// connections close at end of file. Writing to a child that closed its
+// stdin raises SIGPIPE unless the signal is ignored.
+class ChildProcess : public util::Noncopyable {
+public:
+	typedef std::vector<std::string> Arguments;
+
+	enum Stdio {
+		NONE = 0,
+		STDIN = 1,
+		STDOUT = 2,
+		STDERR = 4,
+		ALL = STDIN | STDOUT | STDERR
+	};
+
+	enum Watch {
+		PIDFD, // falls back to SIGNAL when pidfd_open fails
+		SIGNAL
+	};
+
+	struct ExitEvent {
+		pid_t pid;
+		int code; // CLD_EXITED, CLD_KILLED or CLD_DUMPED
+		int status; // exit status or terminating signal
+
+		ExitEvent(pid_t pid0, int code0, int status0)
+		: pid(pid0)
+		, code(code0)
+		, status(status0)
+		{}
+
+		bool exited() const { return code == CLD_EXITED; }
+	};
+	typedef util::Command1<void, const ExitEvent &> ExitCommand;
+
+private:
+	// children watched through SIGCHLD in this thread
+	struct SignalWatch;
+
+	Dispatcher &dispatcher_;
+	std::unique_ptr<ExitCommand> exitCommand_;
+	std::unique_ptr<StreamConnection> in_;
+	std::unique_ptr<StreamConnection> out_;
+	std::unique_ptr<StreamConnection> err_;
+	Watch watch_;
+	pid_t pid_;
+	util::AutoFd pidfd_;
+
+	void watch();
+	void unwatch();
+	bool reap();
+
+	void onPidfd(const FdEvent &event);
+
+	static SignalWatch &signalWatch();
+
+public:
+	ChildProcess(Dispatcher &dispatcher, const ExitCommand &exitCommand);
+	// stops watching, the child is neither killed nor reaped
+	~ChildProcess();
+
+	void setWatch(Watch watch) { watch_ = watch; }
+
+	// searches PATH like execvp(), uncaptured stdio is inherited
+	void spawn(const Arguments &arguments, int stdio = ALL);
+	void kill(int signal = SIGTERM);
+
+	// the captured ends, or null
+	StreamConnection *in() const { return in_.get(); }
+	StreamConnection *out() const { return out_.get(); }
+	StreamConnection *err() const { return err_.get(); }
+
+	pid_t pid() const { return pid_; }
+	bool running() const { return pid_ > 0; }
+	bool pidfd() const { return pidfd_.valid(); }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_CHILDPROCESS_HEADER
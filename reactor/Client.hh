@@ -17,7 +17,9 @@ class Client : public util::Noncopyable {
 
 public:
 	void setTarget(const net::Host &targetHost, const net::Service &targetServ);
+	void setOptions(const SocketOptions &options) { sock_.setOptions(options); }
 	void connect();
+	int release() { return sock_.release(); }
 
 	const util::Fd &fd() const { return sock_.fd(); }
 };
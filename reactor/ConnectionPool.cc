@@ -0,0 +1,348 @@
+#include "ConnectionPool.hh"
+
+#include <algorithm> // std::find
+#include <memory> // unique_ptr
+#include <stdexcept>
+
+using namespace reactor;
+
+const size_t ConnectionPool::DEFAULT_MAX_PER_TARGET = 8;
+const util::DiffTime ConnectionPool::DEFAULT_IDLE_TIMEOUT = util::DiffTime::ms(60 * 1000);
+
+ConnectionPool::Pending::Pending(ConnectionPool &pool0, Target &target0)
+: pool(pool0)
+, target(target0)
+, connector(pool0.dispatcher_, util::commandForMethod(*this, &Pending::onConnect))
+{}
+
+ConnectionPool::ConnectionPool(Dispatcher &dispatcher)
+: dispatcher_(dispatcher)
+, maxPerTarget_(DEFAULT_MAX_PER_TARGET)
+, idleTimeout_(DEFAULT_IDLE_TIMEOUT)
+, reused_(0)
+, connected_(0)
+, idleTimer_(false)
+{}
+
+ConnectionPool::~ConnectionPool()
+{
+	dispatcher_.removeTimers(this);
+	dispatcher_.cancelDeferred(this);
+	retire();
+	for (Targets::iterator i(targets_.begin()); i != targets_.end(); ++i) {
+		Target &t = i->second;
+
+		for (Pendings::const_iterator j(t.connecting.begin()); j != t.connecting.end(); ++j) {
+			delete *j;
+		}
+		for (Idles::iterator j(t.idle.begin()); j != t.idle.end(); ++j) {
+			dispatcher_.remove(FdEvent(j->fd, FdEvent::READ));
+			j->fd.close();
+		}
+		for (Waiters::const_iterator j(t.waiters.begin()); j != t.waiters.end(); ++j) {
+			delete *j;
+		}
+	}
+}
+
+void
+ConnectionPool::setMaxPerTarget(size_t maxPerTarget)
+{
+	if (!maxPerTarget) {
+		throw std::invalid_argument("connection limit must be positive");
+	}
+	maxPerTarget_ = maxPerTarget;
+}
+
+ConnectionPool::Target &
+ConnectionPool::target(const net::Host &host, const net::Service &serv)
+{
+	Key key(host.spec(), serv.spec());
+	Targets::iterator i(targets_.find(key));
+
+	if (i == targets_.end()) {
+		i = targets_.insert(std::make_pair(key, Target(host, serv))).first;
+	}
+	return i->second;
+}
+
+ConnectionPool::Target &
+ConnectionPool::owner(const util::Fd &fd)
+{
+	Owners::iterator i(owners_.find(fd.get()));
+
+	if (i == owners_.end()) {
+		throw std::invalid_argument("connection does not belong to the pool");
+	}
+	return *i->second;
+}
+
+void
+ConnectionPool::connect(Target &target)
+{
+	std::unique_ptr<Pending> pending(new Pending(*this, target));
+
+	// resolving is synchronous, but only once per target
+	if (target.addresses.empty()) {
+		target.addresses = Connector::resolve(target.host, target.serv);
+	}
+	target.connecting.push_back(pending.get());
+	try {
+		// a connect that completes at once calls connected() from here
+		pending->connector.connect(target.addresses);
+	} catch (...) {
+		Pendings::iterator i(std::find(target.connecting.begin(), target.connecting.end(), pending.get()));
+
+		// connected() has retired it already if it ran
+		if (i == target.connecting.end()) {
+			pending.release();
+		} else {
+			target.connecting.erase(i);
+		}
+		target.addresses.clear();
+		throw;
+	}
+	pending.release();
+}
+
+void
+ConnectionPool::connected(Pending &pending, const util::Fd &fd)
+{
+	Target &t = pending.target;
+
+	t.connecting.erase(std::find(t.connecting.begin(), t.connecting.end(), &pending));
+	// the connector is still on the stack, it goes once the dispatcher is done with the job
+	if (retired_.empty()) {
+		dispatcher_.defer(this, util::commandForMethod(*this, &ConnectionPool::retire));
+	}
+	retired_.push_back(&pending);
+
+	if (fd.valid()) {
+		owners_[fd.get()] = &t;
+		++t.open;
+		++connected_;
+		if (t.waiters.empty()) {
+			park(t, fd);
+		} else {
+			std::unique_ptr<AcquireCommand> waiter(t.waiters.front());
+
+			t.waiters.pop_front();
+			waiter->execute(fd);
+		}
+	} else {
+		// the addresses may be stale, resolve again next time
+		t.addresses.clear();
+		if (!t.waiters.empty()) {
+			std::unique_ptr<AcquireCommand> waiter(t.waiters.front());
+
+			// an invalid fd tells a queued waiter that connecting failed
+			t.waiters.pop_front();
+			waiter->execute(fd);
+		}
+	}
+	serveWaiters(t);
+}
+
+void
+ConnectionPool::retire()
+{
+	for (Pendings::const_iterator i(retired_.begin()); i != retired_.end(); ++i) {
+		delete *i;
+	}
+	retired_.clear();
+}
+
+void
+ConnectionPool::close(Target &target, const util::Fd &fd)
+{
+	util::Fd closing(fd);
+
+	owners_.erase(fd.get());
+	--target.open;
+	closing.close();
+}
+
+void
+ConnectionPool::park(Target &target, const util::Fd &fd)
+{
+	target.idle.push_back(Idle(fd, util::Time::now()));
+	dispatcher_.add(FdEvent(fd, FdEvent::READ), util::commandForMethod(*this, &ConnectionPool::onIdleReadable));
+	if (!idleTimer_) {
+		armIdleTimer(idleTimeout_);
+	}
+}
+
+void
+ConnectionPool::armIdleTimer(const util::DiffTime &delay)
+{
+	dispatcher_.add(Timer(delay, 1), util::commandForMethod(*this, &ConnectionPool::onIdleTimer), this);
+	idleTimer_ = true;
+}
+
+void
+ConnectionPool::acquire(const net::Host &host, const net::Service &serv, const AcquireCommand &command)
+{
+	Target &t = target(host, serv);
+
+	if (!t.idle.empty()) {
+		util::Fd fd(t.idle.back().fd);
+
+		// the most recently used connection is the least likely to have been dropped
+		t.idle.pop_back();
+		dispatcher_.remove(FdEvent(fd, FdEvent::READ));
+		++reused_;
+		command.execute(fd);
+	} else {
+		t.waiters.push_back(command.clone());
+		serveWaiters(t);
+	}
+}
+
+void
+ConnectionPool::release(const util::Fd &fd)
+{
+	Target &t = owner(fd);
+
+	if (t.waiters.empty()) {
+		park(t, fd);
+		return;
+	}
+
+	std::unique_ptr<AcquireCommand> waiter(t.waiters.front());
+
+	t.waiters.pop_front();
+	++reused_;
+	waiter->execute(fd);
+}
+
+void
+ConnectionPool::discard(const util::Fd &fd)
+{
+	Target &t = owner(fd);
+
+	close(t, fd);
+	serveWaiters(t);
+}
+
+void
+ConnectionPool::serveWaiters(Target &target)
+{
+	while (!target.waiters.empty() && !target.idle.empty()) {
+		std::unique_ptr<AcquireCommand> waiter(target.waiters.front());
+		util::Fd fd(target.idle.back().fd);
+
+		target.waiters.pop_front();
+		target.idle.pop_back();
+		dispatcher_.remove(FdEvent(fd, FdEvent::READ));
+		++reused_;
+		waiter->execute(fd);
+	}
+	// one connect per waiter that no connect in flight will serve
+	while (target.waiters.size() > target.connecting.size() && target.open + target.connecting.size() < maxPerTarget_) {
+		try {
+			connect(target);
+		} catch (const std::exception &) {
+			std::unique_ptr<AcquireCommand> waiter(target.waiters.front());
+
+			// an invalid fd tells a queued waiter that connecting failed
+			target.waiters.pop_front();
+			waiter->execute(util::Fd());
+		}
+	}
+}
+
+void
+ConnectionPool::onIdleReadable(const FdEvent &event)
+{
+	Owners::iterator o(owners_.find(event.fd.get()));
+
+	if (o == owners_.end()) {
+		return;
+	}
+
+	Target &t = *o->second;
+	Idles::iterator i(t.idle.begin());
+
+	while (i != t.idle.end() && i->fd != event.fd) {
+		++i;
+	}
+	// handed out earlier in this iteration, the new holder owns it now
+	if (i == t.idle.end()) {
+		return;
+	}
+
+	// an idle connection has nothing to read, so this is EOF, an error or garbage
+	t.idle.erase(i);
+	dispatcher_.remove(event);
+	close(t, event.fd);
+	serveWaiters(t);
+}
+
+void
+ConnectionPool::onIdleTimer(const TimerEvent &)
+{
+	util::Time now(util::Time::now());
+	bool waiting = false;
+	util::DiffTime next(idleTimeout_);
+
+	idleTimer_ = false;
+	for (Targets::iterator i(targets_.begin()); i != targets_.end(); ++i) {
+		Target &t = i->second;
+
+		while (!t.idle.empty() && !((t.idle.front().since + idleTimeout_) - now).positive()) {
+			util::Fd fd(t.idle.front().fd);
+
+			t.idle.pop_front();
+			dispatcher_.remove(FdEvent(fd, FdEvent::READ));
+			close(t, fd);
+		}
+		// parked in order, the front of each target expires first
+		if (!t.idle.empty()) {
+			util::DiffTime left((t.idle.front().since + idleTimeout_) - now);
+
+			if (!waiting || left.raw() < next.raw()) {
+				next = left;
+			}
+			waiting = true;
+		}
+	}
+	if (waiting) {
+		armIdleTimer(next);
+	}
+}
+
+size_t
+ConnectionPool::open(const net::Host &host, const net::Service &serv)
+const
+{
+	Targets::const_iterator i(targets_.find(Key(host.spec(), serv.spec())));
+
+	return i == targets_.end() ? 0 : i->second.open;
+}
+
+size_t
+ConnectionPool::idle(const net::Host &host, const net::Service &serv)
+const
+{
+	Targets::const_iterator i(targets_.find(Key(host.spec(), serv.spec())));
+
+	return i == targets_.end() ? 0 : i->second.idle.size();
+}
+
+size_t
+ConnectionPool::waiting(const net::Host &host, const net::Service &serv)
+const
+{
+	Targets::const_iterator i(targets_.find(Key(host.spec(), serv.spec())));
+
+	return i == targets_.end() ? 0 : i->second.waiters.size();
+}
+
+size_t
+ConnectionPool::connecting(const net::Host &host, const net::Service &serv)
+const
+{
+	Targets::const_iterator i(targets_.find(Key(host.spec(), serv.spec())));
+
+	return i == targets_.end() ? 0 : i->second.connecting.size();
+}
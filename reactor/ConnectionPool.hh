@@ -0,0 +1,123 @@
+#ifndef REACTOR_REACTOR_CONNECTIONPOOL_HEADER
+#define REACTOR_REACTOR_CONNECTIONPOOL_HEADER
+
+#include <reactor/Connector.hh>
+#include <reactor/Dispatcher.hh>
+
+#include <net/Host.hh>
+#include <net/Service.hh>
+#include <util/Noncopyable.hh>
+#include <util/Time.hh>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace reactor {
+
+// Connections handed out by acquire() belong to the caller until they are
+// given back with release() (reusable) or discard() (closed). New
+// connections are made with a Connector, so acquire() may complete later
+// from the dispatcher; a failed connect completes a waiter with an invalid fd.
+class ConnectionPool : public util::Noncopyable {
+public:
+	typedef util::Command1<void, const util::Fd &> AcquireCommand;
+
+	static const size_t DEFAULT_MAX_PER_TARGET;
+	static const util::DiffTime DEFAULT_IDLE_TIMEOUT;
+
+private:
+	typedef std::pair<std::string, std::string> Key;
+
+	struct Idle {
+		util::Fd fd;
+		util::Time since;
+
+		Idle(const util::Fd &fd0, const util::Time &since0)
+		: fd(fd0)
+		, since(since0)
+		{}
+	};
+	typedef std::deque<Idle> Idles;
+	typedef std::deque<AcquireCommand *> Waiters;
+	struct Target;
+
+	// a connect in flight for a target
+	struct Pending : public util::Noncopyable {
+		ConnectionPool &pool;
+		Target &target;
+		Connector connector;
+
+		Pending(ConnectionPool &pool0, Target &target0);
+
+		void onConnect(const util::Fd &fd) { pool.connected(*this, fd); }
+	};
+	typedef std::vector<Pending *> Pendings;
+
+	struct Target {
+		net::Host host;
+		net::Service serv;
+		// resolved on the first connect and reused after
+		Connector::Addresses addresses;
+		size_t open;
+		Idles idle;
+		Waiters waiters;
+		Pendings connecting;
+
+		Target(const net::Host &host0, const net::Service &serv0)
+		: host(host0)
+		, serv(serv0)
+		, open(0)
+		{}
+	};
+	typedef std::map<Key, Target> Targets;
+	typedef std::map<int, Target *> Owners;
+
+	Dispatcher &dispatcher_;
+	Targets targets_;
+	Owners owners_;
+	size_t maxPerTarget_;
+	util::DiffTime idleTimeout_;
+	size_t reused_;
+	size_t connected_;
+	// one timer for all idle connections, due when the oldest one expires
+	bool idleTimer_;
+	// finished connects, deleted once their completion has returned
+	Pendings retired_;
+
+	Target &target(const net::Host &host, const net::Service &serv);
+	Target &owner(const util::Fd &fd);
+	void connect(Target &target);
+	void connected(Pending &pending, const util::Fd &fd);
+	void retire();
+	void close(Target &target, const util::Fd &fd);
+	void park(Target &target, const util::Fd &fd);
+	void armIdleTimer(const util::DiffTime &delay);
+	void serveWaiters(Target &target);
+
+	void onIdleReadable(const FdEvent &event);
+	void onIdleTimer(const TimerEvent &event);
+
+public:
+	explicit ConnectionPool(Dispatcher &dispatcher);
+	~ConnectionPool();
+
+	void setMaxPerTarget(size_t maxPerTarget);
+	void setIdleTimeout(const util::DiffTime &idleTimeout) { idleTimeout_ = idleTimeout; }
+
+	void acquire(const net::Host &host, const net::Service &serv, const AcquireCommand &command);
+	void release(const util::Fd &fd);
+	void discard(const util::Fd &fd);
+
+	size_t open(const net::Host &host, const net::Service &serv) const;
+	size_t idle(const net::Host &host, const net::Service &serv) const;
+	size_t waiting(const net::Host &host, const net::Service &serv) const;
+	size_t connecting(const net::Host &host, const net::Service &serv) const;
+	size_t reused() const { return reused_; }
+	size_t connected() const { return connected_; }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_CONNECTIONPOOL_HEADER
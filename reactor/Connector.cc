@@ -0,0 +1,228 @@
+#include "Connector.hh"
+
+#include <algorithm> // std::find
+#include <stdexcept>
+#include <cerrno>
+#include <cstring> // memset()
+#include <netdb.h>
+#include <sys/socket.h>
+
+using namespace reactor;
+
+const util::DiffTime Connector::DEFAULT_ATTEMPT_DELAY = util::DiffTime::ms(250);
+const util::DiffTime Connector::DEFAULT_TIMEOUT = util::DiffTime::ms(30 * 1000);
+
+Connector::Connector(Dispatcher &dispatcher, const ConnectCommand &connectCommand)
+: dispatcher_(dispatcher)
+, connectCommand_(connectCommand.clone())
+, attemptDelay_(DEFAULT_ATTEMPT_DELAY)
+, timeout_(DEFAULT_TIMEOUT)
+, next_(0)
+, attemptCount_(0)
+{}
+
+Connector::~Connector()
+{
+	cancel();
+}
+
+Connector::Addresses
+Connector::resolve(const net::Host &host, const net::Service &serv)
+{
+	int ret;
+	struct addrinfo hints, *res;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_ADDRCONFIG | host.aiFlags() | serv.aiFlags();
+
+	ret = getaddrinfo(host.spec().c_str(), serv.spec().c_str(), &hints, &res);
+	if (ret) {
+		throw std::runtime_error(gai_strerror(ret));
+	}
+
+	Addresses result;
+
+	for (struct addrinfo *p = res; p; p = p->ai_next) {
+		result.push_back(net::Address(p->ai_addr, p->ai_addrlen));
+	}
+	freeaddrinfo(res);
+	return result;
+}
+
+Connector::Addresses
+Connector::interleave(const Addresses &addresses)
+{
+	Addresses preferred, other, result;
+
+	for (Addresses::const_iterator i(addresses.begin()); i != addresses.end(); ++i) {
+		(i->family() == addresses.front().family() ? preferred : other).push_back(*i);
+	}
+	for (size_t i = 0; i < preferred.size() || i < other.size(); ++i) {
+		if (i < preferred.size()) {
+			result.push_back(preferred[i]);
+		}
+		if (i < other.size()) {
+			result.push_back(other[i]);
+		}
+	}
+	return result;
+}
+
+void
+Connector::connect(const net::Host &host, const net::Service &serv)
+{
+	connect(resolve(host, serv));
+}
+
+void
+Connector::connect(const Addresses &addresses)
+{
+	if (connecting()) {
+		throw std::runtime_error("connect already in progress");
+	}
+	if (addresses.empty()) {
+		throw std::invalid_argument("no address to connect to");
+	}
+
+	addresses_ = interleave(addresses);
+	next_ = 0;
+	attemptCount_ = 0;
+	if (timeout_.positive()) {
+		dispatcher_.add(Timer(timeout_, 1), util::commandForMethod(*this, &Connector::onTimeout), &timeout_);
+	}
+	startNext();
+}
+
+void
+Connector::startNext()
+{
+	dispatcher_.removeTimers(this);
+	while (next_ < addresses_.size()) {
+		if (startAttempt()) {
+			return;
+		}
+	}
+	if (attempts_.empty()) {
+		complete(util::Fd());
+	}
+}
+
+bool
+Connector::startAttempt()
+{
+	const net::Address &address = addresses_[next_++];
+	util::Fd fd(socket(address.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+
+	++attemptCount_;
+	if (!fd.valid()) {
+		return false;
+	}
+
+	if (!::connect(fd.get(), address.get(), address.length())) {
+		complete(fd);
+		return true;
+	} else if (errno != EINPROGRESS) {
+		fd.close();
+		return false;
+	}
+
+	attempts_.push_back(fd);
+	dispatcher_.add(FdEvent(fd, FdEvent::WRITE), util::commandForMethod(*this, &Connector::onWritable));
+	if (next_ < addresses_.size()) {
+		dispatcher_.add(Timer(attemptDelay_, 1), util::commandForMethod(*this, &Connector::onAttemptTimer), this);
+	}
+	return true;
+}
+
+bool
+Connector::attempting(const util::Fd &fd)
+const
+{
+	return std::find(attempts_.begin(), attempts_.end(), fd) != attempts_.end();
+}
+
+void
+Connector::abandon(const util::Fd &fd)
+{
+	for (std::vector<util::Fd>::iterator i(attempts_.begin()); i != attempts_.end(); ++i) {
+		if (*i == fd) {
+			dispatcher_.remove(FdEvent(*i, FdEvent::WRITE));
+			i->close();
+			attempts_.erase(i);
+			break;
+		}
+	}
+}
+
+void
+Connector::cancel()
+{
+	dispatcher_.removeTimers(this);
+	dispatcher_.removeTimers(&timeout_);
+	for (std::vector<util::Fd>::iterator i(attempts_.begin()); i != attempts_.end(); ++i) {
+		dispatcher_.remove(FdEvent(*i, FdEvent::WRITE));
+		i->close();
+	}
+	attempts_.clear();
+	addresses_.clear();
+	next_ = 0;
+}
+
+void
+Connector::complete(const util::Fd &fd)
+{
+	for (std::vector<util::Fd>::iterator i(attempts_.begin()); i != attempts_.end(); ++i) {
+		if (*i == fd) {
+			// the winner leaves the race without being closed
+			dispatcher_.remove(FdEvent(*i, FdEvent::WRITE));
+			attempts_.erase(i);
+			break;
+		}
+	}
+	cancel();
+	connectCommand_->execute(fd);
+}
+
+void
+Connector::onWritable(const FdEvent &event)
+{
+	int error = 0;
+	socklen_t length = sizeof(error);
+
+	// another attempt may have decided the race earlier in this iteration
+	if (!connecting() || !attempting(event.fd)) {
+		return;
+	}
+
+	if (getsockopt(event.fd.get(), SOL_SOCKET, SO_ERROR, &error, &length)) {
+		error = errno;
+	}
+
+	if (!error) {
+		complete(event.fd);
+		return;
+	}
+
+	// a failed attempt hands over to the next address right away
+	abandon(event.fd);
+	startNext();
+}
+
+void
+Connector::onAttemptTimer(const TimerEvent &)
+{
+	// the timer may have been harvested before the race was decided
+	if (connecting()) {
+		startNext();
+	}
+}
+
+void
+Connector::onTimeout(const TimerEvent &)
+{
+	if (connecting()) {
+		complete(util::Fd());
+	}
+}
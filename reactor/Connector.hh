@@ -0,0 +1,69 @@
+#ifndef REACTOR_REACTOR_CONNECTOR_HEADER
+#define REACTOR_REACTOR_CONNECTOR_HEADER
+
+#include <reactor/Dispatcher.hh>
+
+#include <net/Address.hh>
+#include <net/Host.hh>
+#include <net/Service.hh>
+#include <util/Noncopyable.hh>
+
+#include <memory> // unique_ptr
+#include <vector>
+
+namespace reactor {
+
+// Races non-blocking connects to the resolved addresses of a target in the
+// style of RFC 8305 (Happy Eyeballs): address families are interleaved, a
+// new attempt starts whenever the previous one fails or the attempt delay
+// passes, and the first connection to complete wins.
+class Connector : public util::Noncopyable {
+public:
+	// the command receives the connected fd and owns it, or an invalid fd on failure
+	typedef util::Command1<void, const util::Fd &> ConnectCommand;
+	typedef std::vector<net::Address> Addresses;
+
+	static const util::DiffTime DEFAULT_ATTEMPT_DELAY;
+	static const util::DiffTime DEFAULT_TIMEOUT;
+
+private:
+	Dispatcher &dispatcher_;
+	std::unique_ptr<ConnectCommand> connectCommand_;
+	util::DiffTime attemptDelay_;
+	util::DiffTime timeout_;
+	Addresses addresses_;
+	size_t next_;
+	std::vector<util::Fd> attempts_;
+	size_t attemptCount_;
+
+	bool attempting(const util::Fd &fd) const;
+	bool startAttempt();
+	void startNext();
+	void abandon(const util::Fd &fd);
+	void complete(const util::Fd &fd);
+
+	void onWritable(const FdEvent &event);
+	void onAttemptTimer(const TimerEvent &event);
+	void onTimeout(const TimerEvent &event);
+
+public:
+	Connector(Dispatcher &dispatcher, const ConnectCommand &connectCommand);
+	~Connector();
+
+	void setAttemptDelay(const util::DiffTime &attemptDelay) { attemptDelay_ = attemptDelay; }
+	void setTimeout(const util::DiffTime &timeout) { timeout_ = timeout; }
+
+	void connect(const net::Host &host, const net::Service &serv);
+	void connect(const Addresses &addresses);
+	void cancel();
+
+	bool connecting() const { return !attempts_.empty() || next_ < addresses_.size(); }
+	size_t attemptCount() const { return attemptCount_; }
+
+	static Addresses resolve(const net::Host &host, const net::Service &serv);
+	static Addresses interleave(const Addresses &addresses);
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_CONNECTOR_HEADER
@@ -0,0 +1,357 @@
+#include "DatagramEndpoint.hh"
+
+#include <util/BufferPool.hh>
+#include <util/ErrnoException.hh>
+
+#include <algorithm> // min(), max()
+#include <stdexcept>
+#include <cerrno>
+#include <cstdint>
+#include <cstring> // memset()
+#include <sys/uio.h>
+
+using namespace reactor;
+
+const size_t DatagramEndpoint::DEFAULT_BATCH_SIZE = 64;
+const size_t DatagramEndpoint::DEFAULT_MAX_DATAGRAM_SIZE = 2048;
+const size_t DatagramEndpoint::DEFAULT_MAX_QUEUED = 4096;
+const size_t DatagramEndpoint::MAX_GRO_SIZE = 65535;
+
+namespace {
+
+const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(int));
+
+} // namespace
+
+DatagramEndpoint::DatagramEndpoint(Dispatcher &dispatcher, const ReceiveCommand &receiveCommand)
+: dispatcher_(dispatcher)
+, receiveCommand_(receiveCommand.clone())
+, batchSize_(DEFAULT_BATCH_SIZE)
+, maxDatagramSize_(DEFAULT_MAX_DATAGRAM_SIZE)
+, maxQueued_(DEFAULT_MAX_QUEUED)
+, receiveSize_(0)
+, gro_(false)
+, writing_(false)
+, flushDeferred_(false)
+, received_(0)
+, truncated_(0)
+, sent_(0)
+, dropped_(0)
+{
+	prepare();
+}
+
+DatagramEndpoint::~DatagramEndpoint()
+{
+	close();
+	releaseBuffers();
+}
+
+void
+DatagramEndpoint::setBatchSize(size_t batchSize)
+{
+	if (!batchSize) {
+		throw std::invalid_argument("batch size must be positive");
+	}
+	batchSize_ = batchSize;
+	prepare();
+}
+
+void
+DatagramEndpoint::setMaxDatagramSize(size_t maxDatagramSize)
+{
+	if (!maxDatagramSize) {
+		throw std::invalid_argument("datagram size must be positive");
+	}
+	maxDatagramSize_ = maxDatagramSize;
+	prepare();
+}
+
+void
+DatagramEndpoint::setGro(bool on)
+{
+	sock_.setGro(on);
+	gro_ = on;
+	prepare();
+}
+
+void
+DatagramEndpoint::prepare()
+{
+	// a coalesced receive can carry up to a full IP payload
+	releaseBuffers();
+	receiveSize_ = gro_ ? std::max(maxDatagramSize_, MAX_GRO_SIZE) : maxDatagramSize_;
+	iovecs_.resize(batchSize_ * util::IoBuffer::MAX_IOVECS);
+	controls_.resize(batchSize_ * CONTROL_SIZE);
+	headers_.resize(batchSize_);
+	sources_.resize(batchSize_);
+}
+
+void
+DatagramEndpoint::acquireBuffers()
+{
+	util::BufferPool &pool = util::BufferPool::instance();
+
+	buffers_.reserve(batchSize_);
+	while (buffers_.size() < batchSize_) {
+		buffers_.push_back(static_cast<char *>(pool.allocate(receiveSize_)));
+	}
+}
+
+void
+DatagramEndpoint::releaseBuffers()
+{
+	util::BufferPool &pool = util::BufferPool::instance();
+
+	for (std::vector<char *>::const_iterator i(buffers_.begin()); i != buffers_.end(); ++i) {
+		pool.release(*i, receiveSize_);
+	}
+	buffers_.clear();
+}
+
+void
+DatagramEndpoint::bind(const net::Host &host, const net::Service &serv)
+{
+	if (open()) {
+		throw std::runtime_error("endpoint is already open");
+	}
+	sock_.bind(host, serv);
+	start();
+}
+
+void
+DatagramEndpoint::adopt(const util::Fd &fd)
+{
+	if (open()) {
+		throw std::runtime_error("endpoint is already open");
+	}
+	sock_.adopt(fd);
+	start();
+}
+
+void
+DatagramEndpoint::start()
+{
+	sock_.blocking(false);
+	dispatcher_.add(FdEvent(sock_.fd(), FdEvent::READ), util::commandForMethod(*this, &DatagramEndpoint::onReadable));
+}
+
+void
+DatagramEndpoint::close()
+{
+	if (!open()) {
+		return;
+	}
+
+	if (flushDeferred_) {
+		dispatcher_.cancelDeferred(this);
+		flushDeferred_ = false;
+	}
+	watchWritable(false);
+	dispatcher_.remove(FdEvent(sock_.fd(), FdEvent::READ));
+	sock_.close();
+	queue_.clear();
+}
+
+void
+DatagramEndpoint::watchWritable(bool on)
+{
+	if (on == writing_) {
+		return;
+	}
+
+	FdEvent event(sock_.fd(), FdEvent::WRITE);
+
+	if (on) {
+		dispatcher_.add(event, util::commandForMethod(*this, &DatagramEndpoint::onWritable));
+	} else {
+		dispatcher_.remove(event);
+	}
+	writing_ = on;
+}
+
+void
+DatagramEndpoint::send(const void *data, size_t length, const net::Address &destination)
+{
+	util::IoBuffer buffer;
+
+	buffer.append(data, length);
+	enqueue(destination, buffer, 0);
+}
+
+void
+DatagramEndpoint::send(const util::IoBuffer &data, const net::Address &destination)
+{
+	enqueue(destination, data, 0);
+}
+
+void
+DatagramEndpoint::send(const util::IoBuffer &data, const net::Address &destination, size_t segmentSize)
+{
+	if (!segmentSize || segmentSize > UINT16_MAX) {
+		throw std::invalid_argument("invalid segment size");
+	}
+	enqueue(destination, data, data.size() > segmentSize ? segmentSize : 0);
+}
+
+void
+DatagramEndpoint::enqueue(const net::Address &destination, const util::IoBuffer &data, size_t segmentSize)
+{
+	if (!open()) {
+		throw std::runtime_error("endpoint is not open");
+	}
+
+	if (queue_.size() >= maxQueued_) {
+		dropped_ += segmentSize ? (data.size() + segmentSize - 1) / segmentSize : 1;
+		return;
+	}
+	queue_.push_back(Outgoing(destination, data, segmentSize));
+
+	if (writing_ || flushDeferred_) {
+		return;
+	}
+
+	// datagrams sent while handling events go out together once the iteration ends
+	if (dispatcher_.draining()) {
+		dispatcher_.defer(this, util::commandForMethod(*this, &DatagramEndpoint::flushAtIterationEnd));
+		flushDeferred_ = true;
+	} else {
+		flush();
+	}
+}
+
+void
+DatagramEndpoint::flushAtIterationEnd()
+{
+	flushDeferred_ = false;
+	flush();
+}
+
+void
+DatagramEndpoint::flush()
+{
+	while (!queue_.empty()) {
+		size_t count = std::min(queue_.size(), batchSize_);
+
+		for (size_t i = 0; i < count; ++i) {
+			Outgoing &outgoing = queue_[i];
+			struct iovec *iov = &iovecs_[i * util::IoBuffer::MAX_IOVECS];
+			struct msghdr &msg = headers_[i].msg_hdr;
+
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_name = const_cast<struct sockaddr *>(outgoing.destination.get());
+			msg.msg_namelen = outgoing.destination.length();
+			msg.msg_iov = iov;
+			msg.msg_iovlen = outgoing.data.fillIovecs(iov, util::IoBuffer::MAX_IOVECS);
+			if (outgoing.segmentSize) {
+				msg.msg_control = &controls_[i * CONTROL_SIZE];
+				msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+				struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+				uint16_t segmentSize = outgoing.segmentSize;
+
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(segmentSize));
+				memcpy(CMSG_DATA(cm), &segmentSize, sizeof(segmentSize));
+			}
+		}
+
+		int ret = sendmmsg(sock_.fd().get(), &headers_[0], count, MSG_DONTWAIT);
+
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				watchWritable(true);
+				return;
+			} else if (errno != EINTR) {
+				// the first datagram cannot be sent, give up on it and carry on
+				dropped_ += queue_.front().datagrams();
+				queue_.pop_front();
+			}
+			continue;
+		}
+
+		for (int i = 0; i < ret; ++i) {
+			sent_ += queue_[i].datagrams();
+		}
+		queue_.erase(queue_.begin(), queue_.begin() + ret);
+	}
+	watchWritable(false);
+}
+
+void
+DatagramEndpoint::deliver(const char *data, size_t length, size_t segmentSize, bool truncated, const net::Address &source)
+{
+	if (!segmentSize) {
+		++received_;
+		receiveCommand_->execute(Datagram(data, length, truncated, source));
+		return;
+	}
+
+	// split a GRO coalesced receive back into the datagrams the peer sent
+	while (length && open()) {
+		size_t size = std::min(length, segmentSize);
+
+		++received_;
+		receiveCommand_->execute(Datagram(data, size, truncated && size == length, source));
+		data += size;
+		length -= size;
+	}
+}
+
+void
+DatagramEndpoint::onReadable(const FdEvent &event)
+{
+	acquireBuffers();
+	for (size_t i = 0; i < batchSize_; ++i) {
+		struct msghdr &msg = headers_[i].msg_hdr;
+
+		iovecs_[i].iov_base = buffers_[i];
+		iovecs_[i].iov_len = receiveSize_;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = sources_[i].get();
+		msg.msg_namelen = net::Address::capacity();
+		msg.msg_iov = &iovecs_[i];
+		msg.msg_iovlen = 1;
+		if (gro_) {
+			msg.msg_control = &controls_[i * CONTROL_SIZE];
+			msg.msg_controllen = CONTROL_SIZE;
+		}
+	}
+
+	int ret = recvmmsg(event.fd.get(), &headers_[0], batchSize_, MSG_DONTWAIT, 0);
+
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNREFUSED) {
+			return;
+		}
+		throw util::ErrnoException("recvmmsg");
+	}
+
+	for (int i = 0; i < ret && open(); ++i) {
+		struct msghdr &msg = headers_[i].msg_hdr;
+		bool truncated = msg.msg_flags & MSG_TRUNC;
+		size_t segmentSize = 0;
+
+		for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+				int size;
+
+				memcpy(&size, CMSG_DATA(cm), sizeof(size));
+				segmentSize = size;
+			}
+		}
+
+		if (truncated) {
+			++truncated_;
+		}
+		sources_[i].setLength(msg.msg_namelen);
+		deliver(buffers_[i], headers_[i].msg_len, segmentSize, truncated, sources_[i]);
+	}
+}
+
+void
+DatagramEndpoint::onWritable(const FdEvent &)
+{
+	flush();
+}
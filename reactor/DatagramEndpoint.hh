@@ -0,0 +1,128 @@
+#ifndef REACTOR_REACTOR_DATAGRAMENDPOINT_HEADER
+#define REACTOR_REACTOR_DATAGRAMENDPOINT_HEADER
+
+#include <reactor/DgramSock.hh>
+#include <reactor/Dispatcher.hh>
+
+#include <net/Address.hh>
+#include <util/IoBuffer.hh>
+#include <util/Noncopyable.hh>
+
+#include <deque>
+#include <memory> // unique_ptr
+#include <sys/socket.h> // mmsghdr
+#include <vector>
+
+namespace reactor {
+
+class DatagramEndpoint : public util::Noncopyable {
+public:
+	struct Datagram {
+		const char *data;
+		size_t length;
+		bool truncated;
+		const net::Address &source;
+
+		Datagram(const char *data0, size_t length0, bool truncated0, const net::Address &source0)
+		: data(data0)
+		, length(length0)
+		, truncated(truncated0)
+		, source(source0)
+		{}
+	};
+	typedef util::Command1<void, const Datagram &> ReceiveCommand;
+
+	static const size_t DEFAULT_BATCH_SIZE;
+	static const size_t DEFAULT_MAX_DATAGRAM_SIZE;
+	static const size_t DEFAULT_MAX_QUEUED;
+	static const size_t MAX_GRO_SIZE;
+
+private:
+	struct Outgoing {
+		net::Address destination;
+		util::IoBuffer data;
+		size_t segmentSize;
+
+		Outgoing(const net::Address &destination0, const util::IoBuffer &data0, size_t segmentSize0)
+		: destination(destination0)
+		, data(data0)
+		, segmentSize(segmentSize0)
+		{}
+
+		size_t datagrams() const { return segmentSize ? (data.size() + segmentSize - 1) / segmentSize : 1; }
+	};
+	typedef std::deque<Outgoing> Queue;
+
+	Dispatcher &dispatcher_;
+	DgramSock sock_;
+	std::unique_ptr<ReceiveCommand> receiveCommand_;
+	size_t batchSize_;
+	size_t maxDatagramSize_;
+	size_t maxQueued_;
+	size_t receiveSize_;
+	bool gro_;
+
+	// receive and send scratch space, sized once per batch size; the receive
+	// buffers come from the buffer pool on the first read and stay until the
+	// sizes change or the endpoint goes away
+	std::vector<char *> buffers_;
+	std::vector<struct iovec> iovecs_;
+	std::vector<char> controls_;
+	std::vector<struct mmsghdr> headers_;
+	std::vector<net::Address> sources_;
+
+	Queue queue_;
+	bool writing_;
+	bool flushDeferred_;
+
+	size_t received_;
+	size_t truncated_;
+	size_t sent_;
+	size_t dropped_;
+
+	void prepare();
+	void acquireBuffers();
+	void releaseBuffers();
+	void start();
+	void watchWritable(bool on);
+	void enqueue(const net::Address &destination, const util::IoBuffer &data, size_t segmentSize);
+	void deliver(const char *data, size_t length, size_t segmentSize, bool truncated, const net::Address &source);
+	void flush();
+	void flushAtIterationEnd();
+
+	void onReadable(const FdEvent &event);
+	void onWritable(const FdEvent &event);
+
+public:
+	DatagramEndpoint(Dispatcher &dispatcher, const ReceiveCommand &receiveCommand);
+	~DatagramEndpoint();
+
+	void setBatchSize(size_t batchSize);
+	void setMaxDatagramSize(size_t maxDatagramSize);
+	void setMaxQueued(size_t maxQueued) { maxQueued_ = maxQueued; }
+	void setGro(bool on);
+	void setOption(int level, int name, int value) { sock_.setOption(level, name, value); }
+
+	void bind(const net::Host &host, const net::Service &serv);
+	void adopt(const util::Fd &fd);
+	void close();
+
+	void send(const void *data, size_t length, const net::Address &destination);
+	void send(const util::IoBuffer &data, const net::Address &destination);
+	// the kernel splits data into datagrams of segmentSize bytes (UDP_SEGMENT)
+	void send(const util::IoBuffer &data, const net::Address &destination, size_t segmentSize);
+
+	size_t received() const { return received_; }
+	size_t truncated() const { return truncated_; }
+	size_t sent() const { return sent_; }
+	size_t dropped() const { return dropped_; }
+	size_t queued() const { return queue_.size(); }
+
+	bool open() const { return sock_.fd().valid(); }
+	const util::Fd &fd() const { return sock_.fd(); }
+	net::Address localAddress() const { return sock_.localAddress(); }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_DATAGRAMENDPOINT_HEADER
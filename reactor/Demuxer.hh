@@ -7,19 +7,21 @@
 #include <util/Fd.hh>
 #include <util/Noncopyable.hh>
 
-#include <list>
+#include <vector>
 
 namespace reactor {
 
 class Demuxer : public util::Noncopyable {
 public:
-	typedef std::list<FdEvent> FdEvents;
+	typedef std::vector<FdEvent> FdEvents;
 
 	virtual ~Demuxer() {}
 
+	virtual void reserve(size_t fds) { (void)fds; }
 	virtual void add(const FdEvent &fdEvent) = 0;
 	virtual void remove(const FdEvent &fdEvent) = 0;
-	virtual FdEvents *demux(const util::DiffTime *interval) = 0;
+	// appends the ready events to fdEvents, which the caller reuses across calls
+	virtual void demux(const util::DiffTime *interval, FdEvents &fdEvents) = 0;
 };
 
 } // namespace reactor
@@ -0,0 +1,19 @@
+#ifndef REACTOR_REACTOR_DGRAMSOCK_HEADER
+#define REACTOR_REACTOR_DGRAMSOCK_HEADER
+
+#include <reactor/Socket.hh>
+
+#include <netinet/udp.h>
+
+namespace reactor {
+
+class DgramSock : public Socket {
+public:
+	DgramSock() : Socket(DGRAM) {}
+
+	void setGro(bool on) { setOption(SOL_UDP, UDP_GRO, on); }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_DGRAMSOCK_HEADER
@@ -1,61 +1,110 @@
 #include "Dispatcher.hh"
 
+#include <util/ErrnoException.hh>
+
 #include <algorithm> // std::for_each
 #include <stdexcept>
+#include <sys/resource.h>
 
 using namespace reactor;
 
-namespace reactor {
+thread_local Dispatcher *Dispatcher::current_ = 0;
+
+namespace {
 
-class BoundResumingCommand : public util::BoundCommand1<void, FdEvent, util::Command1<void, const FdEvent &> > {
-	typedef util::Command1<void, const FdEvent &> C;
-	typedef util::BoundCommand1<void, FdEvent, C> Base;
+const size_t EVENT_KINDS = 3;
+// a job, the command clone it runs and their destructor records
+const size_t JOB_FOOTPRINT = 128;
 
+size_t
+index(const FdEvent &fdEvent)
+{
+	size_t kind = fdEvent.what == FdEvent::READ ? 0 : fdEvent.what == FdEvent::WRITE ? 1 : 2;
+
+	return fdEvent.fd.get() * EVENT_KINDS + kind;
+}
+
+} // namespace
+
+namespace reactor {
+
+// runs a registration's command and puts the fd back into the demuxer once
+// the job is destroyed at the end of the iteration; a registration removed
+// before the job runs is not called, its owner may be gone already
+class BoundResumingCommand : public Backlog::Job {
+	const FdCommand &command_;
+	const FdEvent event_;
 	Dispatcher &dispatcher_;
+	const unsigned generation_;
+	mutable bool own_;
+
+	BoundResumingCommand &operator=(const BoundResumingCommand &);
 
 public:
-	BoundResumingCommand(const C &command, const FdEvent &event, Dispatcher &dispatcher)
-	: Base(command, event)
+	BoundResumingCommand(const FdCommand &command, const FdEvent &event, Dispatcher &dispatcher, unsigned generation)
+	: command_(command)
+	, event_(event)
 	, dispatcher_(dispatcher)
+	, generation_(generation)
+	, own_(true)
 	{}
 
-	~BoundResumingCommand()
+	BoundResumingCommand(const BoundResumingCommand &orig)
+	: command_(orig.command_)
+	, event_(orig.event_)
+	, dispatcher_(orig.dispatcher_)
+	, generation_(orig.generation_)
+	, own_(true)
 	{
-		if (own()) {
-			dispatcher_.resume(Base::p1_);
-		}
+		orig.own_ = false;
 	}
 
-	virtual BoundResumingCommand *
-	clone()
-	const
+	~BoundResumingCommand()
 	{
-		return new BoundResumingCommand(*this);
+		if (own_) {
+			dispatcher_.resume(event_);
+		}
 	}
 
+	virtual BoundResumingCommand *clone() const { return new BoundResumingCommand(*this); }
+	virtual BoundResumingCommand *clone(util::Arena &arena) const { return arena.make<BoundResumingCommand>(*this); }
 	virtual void
 	execute()
 	const
 	{
-		Base::execute();
+		if (dispatcher_.live(event_, generation_)) {
+			command_.execute(event_);
+		}
 	}
 };
 
 } // namespace reactor
 
 Dispatcher::Dispatcher(Demuxer *demuxer, const Timers::NowFunc nowFunc)
-: timers_(backlog_, nowFunc)
+: backlog_(arena_)
+, draining_(false)
+, timers_(backlog_, nowFunc)
 , lazyTimers_(backlog_, nowFunc)
+, signals_(backlog_)
 , defaultDemuxer_(demuxer ? 0 : new DefaultDemuxer())
 , demuxer_(demuxer ? demuxer : defaultDemuxer_.get())
+, measuring_(false)
 {
 	demuxer_->add(FdEvent(notifier_.readFd(), FdEvent::READ));
 }
 
 Dispatcher::~Dispatcher()
 {
+	if (current_ == this) {
+		current_ = 0;
+	}
+	// pending jobs resume their registrations, which must still exist
+	arena_.reset();
 	for (FdCommands::const_iterator i(fdCommands_.begin()); i != fdCommands_.end(); ++i) {
-		delete i->second;
+		delete i->command;
+	}
+	for (PostedJobs::const_iterator i(posted_.begin()); i != posted_.end(); ++i) {
+		delete *i;
 	}
 }
 
@@ -67,23 +116,222 @@ Dispatcher::instance()
 	return instance;
 }
 
+Dispatcher &
+Dispatcher::current()
+{
+	return current_ ? *current_ : instance();
+}
+
 void
-Dispatcher::add(const FdEvent &fdEvent, const FdCommand &command)
+Dispatcher::reserve(size_t expectedFds, size_t expectedTimers, size_t expectedJobs)
+{
+	raiseFdLimit(expectedFds);
+	fdCommands_.reserve(expectedFds * EVENT_KINDS);
+	fdEvents_.reserve(expectedFds);
+	demuxer_->reserve(expectedFds);
+	timers_.reserve(expectedTimers);
+	lazyTimers_.reserve(expectedTimers);
+	backlog_.reserve(expectedJobs);
+	deferredJobs_.reserve(expectedJobs);
+	arena_.reserve(expectedJobs * JOB_FOOTPRINT);
+}
+
+size_t
+Dispatcher::raiseFdLimit(size_t wanted)
+{
+	struct rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit)) {
+		throw util::ErrnoException("getrlimit");
+	}
+	if (limit.rlim_cur == RLIM_INFINITY) {
+		return (size_t)-1;
+	} else if (limit.rlim_cur >= wanted) {
+		return limit.rlim_cur;
+	}
+
+	struct rlimit raised(limit);
+
+	raised.rlim_cur = wanted;
+	if (raised.rlim_max != RLIM_INFINITY && raised.rlim_max < wanted) {
+		raised.rlim_max = wanted;
+	}
+	if (setrlimit(RLIMIT_NOFILE, &raised)) {
+		// raising the hard limit needs CAP_SYS_RESOURCE, go as far as it allows
+		raised.rlim_cur = raised.rlim_max = limit.rlim_max;
+		if (raised.rlim_cur == RLIM_INFINITY || setrlimit(RLIMIT_NOFILE, &raised)) {
+			return limit.rlim_cur;
+		}
+	}
+	return raised.rlim_cur;
+}
+
+Dispatcher::Registration *
+Dispatcher::find(const FdEvent &fdEvent)
 {
-	demuxer_->add(fdEvent);
-	fdCommands_.insert(std::make_pair(fdEvent, command.clone()));
+	size_t i = index(fdEvent);
+
+	return fdEvent.fd.valid() && i < fdCommands_.size() ? &fdCommands_[i] : 0;
+}
+
+Dispatcher::Registration &
+Dispatcher::slot(const FdEvent &fdEvent)
+{
+	if (!fdEvent.fd.valid()) {
+		throw std::invalid_argument("invalid fd");
+	}
+
+	size_t i = index(fdEvent);
+
+	if (i >= fdCommands_.size()) {
+		fdCommands_.resize((fdEvent.fd.get() + 1) * EVENT_KINDS);
+	}
+	return fdCommands_[i];
+}
+
+void
+Dispatcher::add(const FdEvent &fdEvent, const FdCommand &command, Backlog::Priority priority)
+{
+	Registration &reg = slot(fdEvent);
+
+	if (reg.command) {
+		throw std::runtime_error("fd event is already registered");
+	}
+
+	reg.command = command.clone();
+	reg.priority = priority;
+	if (!reg.pending && !reg.parked) {
+		demuxer_->add(fdEvent);
+	}
+}
+
+void
+Dispatcher::remove(const FdEvent &fdEvent)
+{
+	Registration *reg = find(fdEvent);
+
+	if (!reg || !reg->command) {
+		throw std::runtime_error("fd event is not registered");
+	}
+
+	delete reg->command;
+	reg->command = 0;
+	++reg->generation;
+	if (!reg->pending && !reg->parked) {
+		demuxer_->remove(fdEvent);
+	}
+	reg->parked = false;
 }
 
 void
-Dispatcher::add(const Timer &timer, const TimerCommand &command)
+Dispatcher::add(const Timer &timer, const TimerCommand &command, const void *owner)
 {
-	timers_.add(timer, command);
+	timers_.add(timer, command, owner);
 }
 
 void
-Dispatcher::add(const LazyTimer &lazyTimer, const TimerCommand &command)
+Dispatcher::add(const LazyTimer &lazyTimer, const TimerCommand &command, const void *owner)
 {
-	lazyTimers_.add(lazyTimer, command);
+	lazyTimers_.add(lazyTimer, command, owner);
+}
+
+void
+Dispatcher::removeTimers(const void *owner)
+{
+	timers_.remove(owner);
+	lazyTimers_.remove(owner);
+}
+
+void
+Dispatcher::add(const Signal &signal, const SignalCommand &command)
+{
+	bool first = signals_.empty();
+
+	signals_.add(signal, command);
+	if (first) {
+		demuxer_->add(FdEvent(signals_.fd(), FdEvent::READ));
+	}
+}
+
+void
+Dispatcher::remove(const Signal &signal)
+{
+	signals_.remove(signal);
+	if (signals_.empty()) {
+		demuxer_->remove(FdEvent(signals_.fd(), FdEvent::READ));
+	}
+}
+
+void
+Dispatcher::defer(const void *owner, const Backlog::Job &job)
+{
+	deferredJobs_.push_back(DeferredJob(owner, job.clone(arena_)));
+}
+
+void
+Dispatcher::post(const Backlog::Job &job)
+{
+	std::unique_ptr<Backlog::Job> clone(job.clone());
+	bool wasEmpty;
+
+	{
+		std::lock_guard<std::mutex> lock(postedMutex_);
+
+		wasEmpty = posted_.empty();
+		posted_.push_back(clone.get());
+		clone.release();
+	}
+	if (wasEmpty) {
+		notify();
+	}
+}
+
+void
+Dispatcher::cancelDeferred(const void *owner)
+{
+	// the arena destroys the job, leaving a hole keeps a running drain's position valid
+	for (DeferredJobs::iterator i(deferredJobs_.begin()); i != deferredJobs_.end(); ++i) {
+		if (i->first == owner) {
+			i->second = 0;
+		}
+	}
+}
+
+void
+Dispatcher::setMetricsEnabled(bool on)
+{
+	if (on && !metrics_) {
+		metrics_.reset(new LoopMetrics());
+	}
+	measuring_ = on;
+	timers_.setMetrics(on ? metrics_.get() : 0);
+	lazyTimers_.setMetrics(on ? metrics_.get() : 0);
+}
+
+LoopMetrics::Snapshot
+Dispatcher::metrics()
+const
+{
+	if (!metrics_) {
+		return LoopMetrics().snapshot();
+	}
+	return metrics_->snapshot();
+}
+
+void
+Dispatcher::resetMetrics()
+{
+	if (metrics_) {
+		metrics_->reset();
+	}
+}
+
+bool
+Dispatcher::live(const FdEvent &fdEvent, unsigned generation)
+{
+	Registration *reg = find(fdEvent);
+
+	return reg && reg->command && reg->generation == generation;
 }
 
 void
@@ -95,7 +343,50 @@ Dispatcher::suspend(const FdEvent &fdEvent)
 void
 Dispatcher::resume(const FdEvent &fdEvent)
 {
-	demuxer_->add(fdEvent);
+	Registration *reg = find(fdEvent);
+
+	if (!reg) {
+		return;
+	}
+
+	reg->pending = false;
+	if (reg->command && !reg->parked) {
+		demuxer_->add(fdEvent);
+	}
+}
+
+void
+Dispatcher::park(const FdEvent &fdEvent)
+{
+	Registration *reg = find(fdEvent);
+
+	if (!reg || !reg->command) {
+		throw std::runtime_error("fd event is not registered");
+	} else if (reg->parked) {
+		return;
+	}
+
+	// from within its own job the fd is already out of the demuxer
+	if (!reg->pending) {
+		suspend(fdEvent);
+	}
+	reg->parked = true;
+}
+
+void
+Dispatcher::unpark(const FdEvent &fdEvent)
+{
+	Registration *reg = find(fdEvent);
+
+	// removing the registration has already cleared it
+	if (!reg || !reg->parked) {
+		return;
+	}
+
+	reg->parked = false;
+	if (!reg->pending) {
+		demuxer_->add(fdEvent);
+	}
 }
 
 void
@@ -104,40 +395,57 @@ Dispatcher::lookupAndSchedule(FdEvent event)
 	if (event.fd == notifier_.readFd()) {
 		handleNotification(event);
 		return;
+	} else if (event.fd == signals_.fd()) {
+		signals_.harvest();
+		return;
 	}
 
-	FdCommands::iterator j(fdCommands_.find(event));
+	Registration *reg = find(event);
 
-	if (j == fdCommands_.end()) {
+	if (!reg || !reg->command) {
 		throw std::runtime_error("invalid fd");
 	}
+	// a refused fd stays in the demuxer and is reported again once the backlog drains
+	if (!backlog_.admit(reg->priority)) {
+		return;
+	}
 
 	suspend(event);
-	backlog_.enqueueClone(BoundResumingCommand(*j->second, event, *this));
+	reg->pending = true;
+	backlog_.enqueueClone(BoundResumingCommand(*reg->command->clone(arena_), event, *this, reg->generation), reg->priority);
 }
 
 util::DiffTime *
 Dispatcher::remaining()
-const
 {
-	return timers_.isTicking() ? new util::DiffTime(timers_.remainingTime()) : 0;
+	return timers_.isTicking() ? arena_.make<util::DiffTime>(timers_.remainingTime()) : 0;
 }
 
 Dispatcher::FdEvents *
 Dispatcher::wait(const util::DiffTime *remaining)
-const
 {
-	std::unique_ptr<const util::DiffTime> dt(remaining);
-	return demuxer_->demux(dt.get());
+	fdEvents_.clear();
+	if (!measuring_) {
+		demuxer_->demux(remaining, fdEvents_);
+		return &fdEvents_;
+	}
+
+	uint64_t start = LoopMetrics::clock();
+
+	demuxer_->demux(remaining, fdEvents_);
+	metrics_->recordWait(LoopMetrics::clock() - start, fdEvents_.size());
+	return &fdEvents_;
 }
 
 void
 Dispatcher::collectEvents(FdEvents *fdEvents)
 {
-	std::unique_ptr<FdEvents> e(fdEvents);
-	std::for_each(e->begin(), e->end(), std::bind1st(std::mem_fun(&Dispatcher::lookupAndSchedule), this));
+	std::for_each(fdEvents->begin(), fdEvents->end(), std::bind1st(std::mem_fun(&Dispatcher::lookupAndSchedule), this));
 	timers_.harvest();
 	lazyTimers_.harvest();
+	if (measuring_) {
+		metrics_->recordBacklog(backlog_.size());
+	}
 }
 
 bool
@@ -153,14 +461,70 @@ Dispatcher::dequeueEvent()
 	return backlog_.dequeue();
 }
 
+size_t
+Dispatcher::runDeferredJobs()
+{
+	size_t count = 0;
+
+	// jobs deferred meanwhile are appended and run in the same pass
+	for (size_t i = 0; i < deferredJobs_.size(); ++i) {
+		Backlog::Job *job = deferredJobs_[i].second;
+
+		if (job) {
+			deferredJobs_[i].second = 0;
+			job->execute();
+			++count;
+		}
+	}
+	deferredJobs_.clear();
+	return count;
+}
+
+void
+Dispatcher::drain()
+{
+	// jobs may switch metrics on or off meanwhile
+	LoopMetrics *metrics = measuring_ ? metrics_.get() : 0;
+	uint64_t start = metrics ? LoopMetrics::clock() : 0;
+	size_t jobs = 0;
+
+	// a throwing job leaves the iteration unrecorded
+	do {
+		while (hasPendingEvents()) {
+			dequeueEvent()->execute();
+			++jobs;
+		}
+		jobs += runDeferredJobs();
+	} while (hasPendingEvents());
+	if (metrics) {
+		metrics->recordRun(LoopMetrics::clock() - start, jobs);
+	}
+}
+
 void
 Dispatcher::stepSingleThread()
 {
+	current_ = this;
 	collectEvents(wait(remaining()));
-	while (hasPendingEvents()) {
-		Backlog::Job *job = dequeueEvent();
-		job->execute();
-		delete job;
+
+	draining_ = true;
+	try {
+		drain();
+	} catch (...) {
+		draining_ = false;
+		endIteration();
+		throw;
+	}
+	draining_ = false;
+	endIteration();
+}
+
+void
+Dispatcher::endIteration()
+{
+	// after a throwing job the rest of the work stays until the next drain
+	if (backlog_.empty() && deferredJobs_.empty()) {
+		arena_.reset();
 	}
 }
 
@@ -173,6 +537,19 @@ Dispatcher::notify()
 void
 Dispatcher::handleNotification(const FdEvent &event)
 {
-	char dummy;
-	event.fd.read(&dummy, sizeof(dummy));
+	char dummy[64];
+
+	// a failed read leaves the bytes in the pipe and the next poll retries
+	event.fd.tryRead(dummy, sizeof(dummy));
+
+	{
+		std::lock_guard<std::mutex> lock(postedMutex_);
+
+		collected_.swap(posted_);
+	}
+	// posted jobs are not refused or shed, their senders cannot retry
+	for (PostedJobs::const_iterator i(collected_.begin()); i != collected_.end(); ++i) {
+		backlog_.enqueue(arena_.adopt(*i), Backlog::HIGH);
+	}
+	collected_.clear();
 }
@@ -2,15 +2,19 @@
 #define REACTOR_REACTOR_DISPATCHER_HEADER
 
 #include <reactor/Timers.hh>
+#include <reactor/Signals.hh>
 #include <reactor/DefaultDemuxer.hh>
 #include <reactor/FdCommand.hh>
 #include <reactor/Backlog.hh>
+#include <reactor/LoopMetrics.hh>
 
+#include <util/Arena.hh>
 #include <util/Pipe.hh>
 #include <util/Noncopyable.hh>
 
-#include <map>
 #include <memory> // unique_ptr
+#include <mutex>
+#include <vector>
 
 namespace reactor {
 
@@ -19,20 +23,62 @@ public:
 	typedef Demuxer::FdEvents FdEvents;
 
 private:
-	typedef std::map<FdEvent, FdCommand *> FdCommands;
+	struct Registration {
+		FdCommand *command;
+		Backlog::Priority priority;
+		// bumped on removal, a queued job of an earlier generation is stale
+		unsigned generation;
+		bool pending;
+		bool parked;
 
+		explicit Registration(FdCommand *command0 = 0)
+		: command(command0)
+		, priority(Backlog::NORMAL)
+		, generation(0)
+		, pending(false)
+		, parked(false)
+		{}
+	};
+	// indexed by fd and event kind, an unused slot has no command and is not pending
+	typedef std::vector<Registration> FdCommands;
+	typedef std::pair<const void *, Backlog::Job *> DeferredJob;
+	typedef std::vector<DeferredJob> DeferredJobs;
+	typedef std::vector<Backlog::Job *> PostedJobs;
+
+	// per-iteration objects: jobs, their command clones and the wait interval
+	util::Arena arena_;
 	FdCommands fdCommands_;
+	FdEvents fdEvents_;
 	Backlog backlog_;
+	DeferredJobs deferredJobs_;
+	bool draining_;
 	Timers timers_, lazyTimers_;
+	Signals signals_;
 	std::unique_ptr<DefaultDemuxer> defaultDemuxer_;
 	Demuxer *demuxer_;
 	util::Pipe notifier_;
+	// jobs from other threads, heap allocated and adopted by the arena once collected
+	std::mutex postedMutex_;
+	PostedJobs posted_;
+	PostedJobs collected_;
+	// allocated when first enabled and kept for the snapshots of other threads
+	std::unique_ptr<LoopMetrics> metrics_;
+	bool measuring_;
 
+	Registration *find(const FdEvent &fdEvent);
+	Registration &slot(const FdEvent &fdEvent);
+	bool live(const FdEvent &fdEvent, unsigned generation);
 	void suspend(const FdEvent &fdEvent);
 	void resume(const FdEvent &fdEvent);
 	void lookupAndSchedule(FdEvent event);
 	void collectFdEvents();
 	void handleNotification(const FdEvent &event);
+	void drain();
+	size_t runDeferredJobs();
+	void endIteration();
+
+	// the dispatcher last stepped on each thread
+	static thread_local Dispatcher *current_;
 
 	friend class BoundResumingCommand;
 
@@ -42,18 +88,57 @@ protected:
 
 public:
 	static Dispatcher &instance();
+	// the dispatcher that last stepped on the calling thread, instance() before any did;
+	// lets a command find the loop it runs on, for instance in a ShardedAcceptor shard
+	static Dispatcher &current();
+
+	// Sizes the containers up front so that growing to the expected load
+	// does not reallocate in the middle of traffic. Also raises the
+	// descriptor limit towards expectedFds.
+	void reserve(size_t expectedFds, size_t expectedTimers, size_t expectedJobs);
+	// Raises RLIMIT_NOFILE to at least wanted where permitted, returns the resulting soft limit.
+	static size_t raiseFdLimit(size_t wanted);
 
+	// the events, jobs and interval live until the iteration ends and are not freed by the caller
 	void collectEvents(FdEvents *fdEvents);
 	bool hasPendingEvents() const;
 	Backlog::Job *dequeueEvent();
 	void stepSingleThread();
-	util::DiffTime *remaining() const;
-	FdEvents *wait(const util::DiffTime *remaining = 0) const;
+	util::DiffTime *remaining();
+	FdEvents *wait(const util::DiffTime *remaining = 0);
 	void notify();
+	bool draining() const { return draining_; }
+
+	// overload policy, capacity and high-water mark of the job backlog
+	Backlog &backlog() { return backlog_; }
+	const Backlog &backlog() const { return backlog_; }
+
+	// the priority decides which readiness is refused or shed when the backlog overloads
+	void add(const FdEvent &fdEvent, const FdCommand &command, Backlog::Priority priority = Backlog::NORMAL);
+	void remove(const FdEvent &fdEvent);
+	void add(const Timer &timer, const TimerCommand &command, const void *owner = 0);
+	void add(const LazyTimer &lazyTimer, const TimerCommand &command, const void *owner = 0);
+	void removeTimers(const void *owner);
+	// blocks the signal in the calling thread and delivers it through a signalfd
+	void add(const Signal &signal, const SignalCommand &command);
+	void remove(const Signal &signal);
+	void defer(const void *owner, const Backlog::Job &job);
+	// Thread-safe: queues a job for the dispatcher's thread, waking it only
+	// when the queue was empty, so a burst of posts costs one pipe write.
+	void post(const Backlog::Job &job);
+	// keeps a registered fd out of the demuxer until unparked, even when its job finishes
+	void park(const FdEvent &fdEvent);
+	void unpark(const FdEvent &fdEvent);
+	void cancelDeferred(const void *owner);
 
-	void add(const FdEvent &fdEvent, const FdCommand &command);
-	void add(const Timer &timer, const TimerCommand &command);
-	void add(const LazyTimer &lazyTimer, const TimerCommand &command);
+	// Records the time blocked in the demuxer, ready events, backlog depth,
+	// jobs run and their time, and fired timers with their lateness, per
+	// iteration. Enable it before other threads take snapshots.
+	void setMetricsEnabled(bool on);
+	bool metricsEnabled() const { return measuring_; }
+	// all zero until metrics have been enabled
+	LoopMetrics::Snapshot metrics() const;
+	void resetMetrics();
 };
 
 } // namespace reactor
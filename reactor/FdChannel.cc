@@ -0,0 +1,262 @@
+#include "FdChannel.hh"
+
+#include <util/ErrnoException.hh>
+
+#include <stdexcept>
+#include <cerrno>
+#include <cstring> // memset()
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+using namespace reactor;
+
+const size_t FdChannel::MAX_FDS = 253; // SCM_MAX_FD
+const size_t FdChannel::MAX_MESSAGE_SIZE = 4096;
+
+namespace {
+
+const size_t MAX_MESSAGES_PER_WAKEUP = 64;
+
+} // namespace
+
+FdChannel::Outgoing::~Outgoing()
+{
+	for (std::vector<util::AutoFd *>::const_iterator i(fds.begin()); i != fds.end(); ++i) {
+		delete *i;
+	}
+}
+
+FdChannel::FdChannel(Dispatcher &dispatcher, const ReceiveCommand &receiveCommand)
+: dispatcher_(dispatcher)
+, sock_(Socket::ANY)
+, type_(0)
+, receiveCommand_(receiveCommand.clone())
+, data_(MAX_MESSAGE_SIZE)
+, control_(CMSG_SPACE(MAX_FDS * sizeof(int)))
+, writing_(false)
+, truncated_(0)
+{}
+
+FdChannel::~FdChannel()
+{
+	close();
+}
+
+void
+FdChannel::adopt(const util::Fd &fd)
+{
+	int type;
+	socklen_t length = sizeof(type);
+
+	if (open()) {
+		throw std::runtime_error("channel is already open");
+	}
+	if (getsockopt(fd.get(), SOL_SOCKET, SO_TYPE, &type, &length)) {
+		throw util::ErrnoException("getsockopt");
+	} else if (type == SOCK_STREAM) {
+		// a short write would split a message and the receiver could not tell where it ends
+		throw std::invalid_argument("stream sockets do not keep message boundaries");
+	}
+	sock_.adopt(fd);
+	type_ = type;
+	start();
+}
+
+void
+FdChannel::connect(const net::Address &address, int type)
+{
+	Socket sock(type);
+
+	sock.connect(address);
+	adopt(util::Fd(sock.release()));
+}
+
+void
+FdChannel::start()
+{
+	sock_.blocking(false);
+	dispatcher_.add(FdEvent(sock_.fd(), FdEvent::READ), util::commandForMethod(*this, &FdChannel::onReadable));
+}
+
+void
+FdChannel::close()
+{
+	if (!open()) {
+		return;
+	}
+
+	watchWritable(false);
+	dispatcher_.remove(FdEvent(sock_.fd(), FdEvent::READ));
+	sock_.close();
+	while (!queue_.empty()) {
+		delete queue_.front();
+		queue_.pop_front();
+	}
+}
+
+void
+FdChannel::finish()
+{
+	close();
+	if (closeCommand_) {
+		closeCommand_->execute(*this);
+	}
+}
+
+void
+FdChannel::watchWritable(bool on)
+{
+	if (on == writing_) {
+		return;
+	}
+
+	FdEvent event(sock_.fd(), FdEvent::WRITE);
+
+	if (on) {
+		dispatcher_.add(event, util::commandForMethod(*this, &FdChannel::onWritable));
+	} else {
+		dispatcher_.remove(event);
+	}
+	writing_ = on;
+}
+
+bool
+FdChannel::transmit(const char *data, size_t length, const Fds &fds)
+{
+	struct iovec iov;
+	struct msghdr msg;
+
+	iov.iov_base = const_cast<char *>(data);
+	iov.iov_len = length;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (!fds.empty()) {
+		msg.msg_control = &control_[0];
+		msg.msg_controllen = CMSG_SPACE(fds.size() * sizeof(int));
+
+		struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+		int *p = reinterpret_cast<int *>(CMSG_DATA(cm));
+
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_RIGHTS;
+		cm->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+		for (size_t i = 0; i < fds.size(); ++i) {
+			p[i] = fds[i].get();
+		}
+	}
+
+	if (sendmsg(sock_.fd().get(), &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return false;
+		}
+		throw util::ErrnoException("sendmsg");
+	}
+	return true;
+}
+
+void
+FdChannel::send(const Fds &fds, const void *data, size_t length)
+{
+	if (!open()) {
+		throw std::runtime_error("channel is not open");
+	}
+	if (fds.size() > MAX_FDS) {
+		throw std::invalid_argument("too many descriptors in one message");
+	} else if (!length && fds.empty() && type_ == SOCK_SEQPACKET) {
+		throw std::invalid_argument("empty message without descriptors");
+	}
+
+	if (queue_.empty() && transmit(static_cast<const char *>(data), length, fds)) {
+		return;
+	}
+
+	std::unique_ptr<Outgoing> outgoing(new Outgoing());
+
+	outgoing->data.assign(static_cast<const char *>(data), length);
+	for (Fds::const_iterator i(fds.begin()); i != fds.end(); ++i) {
+		int dup = fcntl(i->get(), F_DUPFD_CLOEXEC, 0);
+
+		if (dup < 0) {
+			throw util::ErrnoException("fcntl");
+		}
+		outgoing->fds.push_back(new util::AutoFd(dup));
+	}
+	queue_.push_back(outgoing.release());
+	watchWritable(true);
+}
+
+void
+FdChannel::onWritable(const FdEvent &)
+{
+	while (!queue_.empty()) {
+		Outgoing *outgoing = queue_.front();
+		Fds fds;
+
+		for (std::vector<util::AutoFd *>::const_iterator i(outgoing->fds.begin()); i != outgoing->fds.end(); ++i) {
+			fds.push_back(**i);
+		}
+
+		try {
+			if (!transmit(outgoing->data.data(), outgoing->data.size(), fds)) {
+				return;
+			}
+		} catch (const util::ErrnoException &) {
+			finish();
+			return;
+		}
+		queue_.pop_front();
+		delete outgoing;
+	}
+	watchWritable(false);
+}
+
+void
+FdChannel::onReadable(const FdEvent &event)
+{
+	for (size_t n = 0; n < MAX_MESSAGES_PER_WAKEUP && open(); ++n) {
+		struct iovec iov;
+		struct msghdr msg;
+
+		iov.iov_base = &data_[0];
+		iov.iov_len = data_.size();
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = &control_[0];
+		msg.msg_controllen = control_.size();
+
+		ssize_t ret = recvmsg(event.fd.get(), &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+
+		if (ret < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				finish();
+			}
+			return;
+		} else if (!ret && type_ == SOCK_SEQPACKET && !msg.msg_controllen) {
+			// only the end of stream comes without payload and descriptors
+			finish();
+			return;
+		}
+
+		Fds fds;
+
+		for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) {
+				continue;
+			}
+
+			const int *p = reinterpret_cast<const int *>(CMSG_DATA(cm));
+			size_t count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+			for (size_t i = 0; i < count; ++i) {
+				fds.push_back(util::Fd(p[i]));
+			}
+		}
+		if (msg.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) {
+			++truncated_;
+		}
+		receiveCommand_->execute(Message(&data_[0], ret, fds));
+	}
+}
@@ -0,0 +1,93 @@
+#ifndef REACTOR_REACTOR_FDCHANNEL_HEADER
+#define REACTOR_REACTOR_FDCHANNEL_HEADER
+
+#include <reactor/Dispatcher.hh>
+#include <reactor/Socket.hh>
+
+#include <util/AutoFd.hh>
+#include <util/Noncopyable.hh>
+
+#include <deque>
+#include <memory> // unique_ptr
+#include <string>
+#include <vector>
+
+namespace reactor {
+
+// Passes descriptors between processes over an AF_UNIX socket with
+// SCM_RIGHTS. The socket must be SEQPACKET or DGRAM, which keep message
+// boundaries; a stream socket is refused.
+class FdChannel : public util::Noncopyable {
+public:
+	typedef std::vector<util::Fd> Fds;
+
+	// the receive command owns the passed descriptors and must close them
+	struct Message {
+		const char *data;
+		size_t length;
+		const Fds &fds;
+
+		Message(const char *data0, size_t length0, const Fds &fds0)
+		: data(data0)
+		, length(length0)
+		, fds(fds0)
+		{}
+	};
+	typedef util::Command1<void, const Message &> ReceiveCommand;
+	typedef util::Command1<void, FdChannel &> CloseCommand;
+
+	static const size_t MAX_FDS;
+	static const size_t MAX_MESSAGE_SIZE;
+
+private:
+	struct Outgoing : public util::Noncopyable {
+		std::string data;
+		std::vector<util::AutoFd *> fds;
+
+		~Outgoing();
+	};
+	typedef std::deque<Outgoing *> Queue;
+
+	Dispatcher &dispatcher_;
+	Socket sock_;
+	int type_;
+	std::unique_ptr<ReceiveCommand> receiveCommand_;
+	std::unique_ptr<CloseCommand> closeCommand_;
+	std::vector<char> data_;
+	std::vector<char> control_;
+	Queue queue_;
+	bool writing_;
+	size_t truncated_;
+
+	void start();
+	void watchWritable(bool on);
+	bool transmit(const char *data, size_t length, const Fds &fds);
+	void finish();
+
+	void onReadable(const FdEvent &event);
+	void onWritable(const FdEvent &event);
+
+public:
+	FdChannel(Dispatcher &dispatcher, const ReceiveCommand &receiveCommand);
+	~FdChannel();
+
+	void setCloseCommand(const CloseCommand &command) { closeCommand_.reset(command.clone()); }
+
+	void adopt(const util::Fd &fd);
+	void connect(const net::Address &address, int type = Socket::SEQPACKET);
+	void close();
+
+	// Descriptors are duplicated when the message has to wait, so the caller
+	// may close its copies. On a SEQPACKET socket a message without payload
+	// must carry descriptors, an empty one would read as end of stream.
+	void send(const Fds &fds, const void *data = 0, size_t length = 0);
+
+	size_t queued() const { return queue_.size(); }
+	size_t truncated() const { return truncated_; }
+	bool open() const { return sock_.fd().valid(); }
+	const util::Fd &fd() const { return sock_.fd(); }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_FDCHANNEL_HEADER
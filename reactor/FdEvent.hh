@@ -8,7 +8,8 @@ namespace reactor {
 struct FdEvent {
 	enum What {
 		READ = 4,
-		WRITE = 2
+		WRITE = 2,
+		ERROR = 1
 	};
 
 	util::Fd fd;
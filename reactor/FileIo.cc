@@ -0,0 +1,519 @@
+#include "FileIo.hh"
+
+#include <util/AutoFd.hh>
+#include <util/BufferPool.hh>
+#include <util/ErrnoException.hh>
+
+#include <algorithm> // std::find(), std::max(), std::min()
+#include <atomic>
+#include <thread> // std::this_thread::yield()
+#include <cerrno>
+#include <cstdint> // UINT32_MAX
+#include <cstring> // memset()
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace reactor;
+
+const size_t FileIo::DEFAULT_DEPTH = 64;
+
+struct FileIo::Request : public util::Noncopyable {
+	util::Fd fd;
+	void *buffer;
+	size_t length;
+	off_t offset;
+	bool write;
+	Command *command;
+	const void *owner;
+	bool releaseBuffer;
+	util::IoResult result;
+
+	Request()
+	: buffer(0)
+	, length(0)
+	, offset(0)
+	, write(false)
+	, command(0)
+	, owner(0)
+	, releaseBuffer(false)
+	, result(util::IoResult::success(0))
+	{}
+};
+
+struct FileIo::Shared {
+	FileIo *io;
+	// pool work not yet finished, it may still touch its request and buffer
+	std::atomic<size_t> working;
+
+	explicit Shared(FileIo *io0) : io(io0), working(0) {}
+};
+
+// A minimal io_uring: one submission per call and completions reaped when
+// the registered eventfd fires. The depth limit keeps both rings from
+// overflowing.
+class FileIo::Ring : public util::Noncopyable {
+	util::AutoFd fd_;
+	util::AutoFd event_;
+	void *sq_;
+	size_t sqSize_;
+	void *cq_;
+	size_t cqSize_;
+	struct io_uring_sqe *sqes_;
+	size_t sqesSize_;
+	unsigned *sqTail_;
+	unsigned *sqMask_;
+	unsigned *sqArray_;
+	unsigned *cqHead_;
+	unsigned *cqTail_;
+	unsigned *cqMask_;
+	struct io_uring_cqe *cqes_;
+
+	void *map(size_t size, off_t offset);
+	void unmap();
+	void probe();
+
+public:
+	explicit Ring(unsigned entries);
+	~Ring();
+
+	void submit(Request *request);
+	// the next completion, or null
+	Request *reap(util::IoResult &result);
+	void wait();
+
+	const util::Fd &event() const { return event_; }
+};
+
+FileIo::Ring::Ring(unsigned entries)
+: sq_(MAP_FAILED)
+, cq_(MAP_FAILED)
+, sqes_(static_cast<struct io_uring_sqe *>(MAP_FAILED))
+{
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+	fd_.reset(syscall(__NR_io_uring_setup, entries, &params));
+	if (!fd_.valid()) {
+		throw util::ErrnoException("io_uring_setup");
+	}
+
+	sqSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		sqSize_ = cqSize_ = std::max(sqSize_, cqSize_);
+	}
+
+	try {
+		sq_ = map(sqSize_, IORING_OFF_SQ_RING);
+		cq_ = params.features & IORING_FEAT_SINGLE_MMAP ? sq_ : map(cqSize_, IORING_OFF_CQ_RING);
+		sqes_ = static_cast<struct io_uring_sqe *>(map(sqesSize_, IORING_OFF_SQES));
+
+		event_.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+		if (!event_.valid()) {
+			throw util::ErrnoException("eventfd");
+		}
+
+		int event = event_.get();
+
+		if (syscall(__NR_io_uring_register, fd_.get(), IORING_REGISTER_EVENTFD, &event, 1) < 0) {
+			throw util::ErrnoException("io_uring_register");
+		}
+		probe();
+	} catch (...) {
+		unmap();
+		throw;
+	}
+
+	char *sq = static_cast<char *>(sq_);
+	char *cq = static_cast<char *>(cq_);
+
+	sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+	sqMask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+	sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+	cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+	cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+	cqMask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+	cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+FileIo::Ring::~Ring()
+{
+	unmap();
+}
+
+void
+FileIo::Ring::unmap()
+{
+	if (sqes_ != MAP_FAILED) {
+		munmap(sqes_, sqesSize_);
+		sqes_ = static_cast<struct io_uring_sqe *>(MAP_FAILED);
+	}
+	if (cq_ != MAP_FAILED && cq_ != sq_) {
+		munmap(cq_, cqSize_);
+	}
+	cq_ = MAP_FAILED;
+	if (sq_ != MAP_FAILED) {
+		munmap(sq_, sqSize_);
+		sq_ = MAP_FAILED;
+	}
+}
+
+// IORING_OP_READ and IORING_OP_WRITE came with 5.6 as did the probe, older
+// kernels refuse it with EINVAL
+void
+FileIo::Ring::probe()
+{
+	const unsigned OPS = 256;
+	std::vector<char> buffer(sizeof(struct io_uring_probe) + OPS * sizeof(struct io_uring_probe_op));
+	struct io_uring_probe *probe = reinterpret_cast<struct io_uring_probe *>(buffer.data());
+
+	if (syscall(__NR_io_uring_register, fd_.get(), IORING_REGISTER_PROBE, probe, OPS) < 0) {
+		throw util::ErrnoException("io_uring_register");
+	}
+
+	const unsigned ops[] = {IORING_OP_READ, IORING_OP_WRITE};
+
+	for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+		if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+			throw util::ErrnoException("io_uring_register", EOPNOTSUPP);
+		}
+	}
+}
+
+void *
+FileIo::Ring::map(size_t size, off_t offset)
+{
+	void *result = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_.get(), offset);
+
+	if (result == MAP_FAILED) {
+		throw util::ErrnoException("mmap");
+	}
+	return result;
+}
+
+void
+FileIo::Ring::submit(Request *request)
+{
+	unsigned tail = *sqTail_;
+	unsigned index = tail & *sqMask_;
+	struct io_uring_sqe *sqe = &sqes_[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe->fd = request->fd.get();
+	sqe->addr = reinterpret_cast<uintptr_t>(request->buffer);
+	// the length is 32 bits, longer transfers come back short as with pread()
+	sqe->len = (unsigned)std::min(request->length, (size_t)UINT32_MAX);
+	sqe->off = request->offset;
+	sqe->user_data = reinterpret_cast<uintptr_t>(request);
+	sqArray_[index] = index;
+	__atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+
+	if (syscall(__NR_io_uring_enter, fd_.get(), 1, 0, 0, 0, 0) < 0) {
+		// nothing was consumed on failure
+		__atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+		throw util::ErrnoException("io_uring_enter");
+	}
+}
+
+FileIo::Request *
+FileIo::Ring::reap(util::IoResult &result)
+{
+	unsigned head = *cqHead_;
+
+	if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+		return 0;
+	}
+
+	struct io_uring_cqe *cqe = &cqes_[head & *cqMask_];
+	Request *request = reinterpret_cast<Request *>(cqe->user_data);
+
+	result = cqe->res < 0 ? util::IoResult::failure(-cqe->res) : util::IoResult::success(cqe->res);
+	__atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+	return request;
+}
+
+void
+FileIo::Ring::wait()
+{
+	if (syscall(__NR_io_uring_enter, fd_.get(), 0, 1, IORING_ENTER_GETEVENTS, 0, 0) < 0 && errno != EINTR) {
+		throw util::ErrnoException("io_uring_enter");
+	}
+}
+
+// runs on a pool thread, touching only the request
+class FileIo::PoolWork : public util::Command0<void> {
+	std::shared_ptr<Shared> shared_;
+	Request *request_;
+
+public:
+	PoolWork(const std::shared_ptr<Shared> &shared, Request *request)
+	: shared_(shared)
+	, request_(request)
+	{}
+
+	virtual PoolWork *clone() const { return new PoolWork(*this); }
+
+	virtual void
+	execute()
+	const
+	{
+		Request &r = *request_;
+
+		r.result = r.write ? r.fd.tryWriteAt(r.buffer, r.length, r.offset) : r.fd.tryReadAt(r.buffer, r.length, r.offset);
+		--shared_->working;
+	}
+};
+
+class FileIo::PoolDone : public OffloadPool::Completion {
+	std::shared_ptr<Shared> shared_;
+	Request *request_;
+
+public:
+	PoolDone(const std::shared_ptr<Shared> &shared, Request *request)
+	: shared_(shared)
+	, request_(request)
+	{}
+
+	virtual PoolDone *clone() const { return new PoolDone(*this); }
+
+	// the work keeps its outcome in the request and does not throw
+	virtual void
+	execute(const std::exception_ptr &)
+	const
+	{
+		// a destroyed FileIo has already freed the request
+		if (shared_->io) {
+			shared_->io->complete(request_, request_->result);
+		}
+	}
+};
+
+FileIo::FileIo(Dispatcher &dispatcher, OffloadPool *pool, size_t depth, Backend backend)
+: dispatcher_(dispatcher)
+, pool_(pool)
+, shared_(std::make_shared<Shared>(this))
+, depth_(depth)
+{
+	if (backend == RING) {
+		try {
+			ring_.reset(new Ring(depth));
+		} catch (const util::ErrnoException &) {
+			// ENOSYS on old kernels, EPERM where seccomp or a sysctl forbids it,
+			// EINVAL or EOPNOTSUPP where plain reads and writes are missing
+		}
+	}
+
+	if (ring_) {
+		dispatcher_.add(FdEvent(ring_->event(), FdEvent::READ), util::commandForMethod(*this, &FileIo::onRingReady));
+	} else if (!pool_) {
+		ownPool_.reset(new OffloadPool(1, depth));
+		pool_ = ownPool_.get();
+	}
+	running_.reserve(depth);
+}
+
+FileIo::~FileIo()
+{
+	for (Waiters::const_iterator i(waiters_.begin()); i != waiters_.end(); ++i) {
+		delete i->second;
+	}
+	waiters_.clear();
+	for (Requests::const_iterator i(running_.begin()); i != running_.end(); ++i) {
+		delete (*i)->command;
+		(*i)->command = 0;
+	}
+
+	if (ring_) {
+		util::IoResult result(util::IoResult::success(0));
+
+		while (!running_.empty()) {
+			Request *request = ring_->reap(result);
+
+			if (request) {
+				complete(request, result);
+			} else {
+				ring_->wait();
+			}
+		}
+		dispatcher_.remove(FdEvent(ring_->event(), FdEvent::READ));
+	} else {
+		// queued work still runs, the pool only drops it when destroyed
+		while (shared_->working) {
+			std::this_thread::yield();
+		}
+		shared_->io = 0;
+		while (!running_.empty()) {
+			complete(running_.back(), running_.back()->result);
+		}
+	}
+
+	for (Requests::const_iterator i(spare_.begin()); i != spare_.end(); ++i) {
+		delete *i;
+	}
+}
+
+bool
+FileIo::readAt(const util::Fd &fd, void *buffer, size_t length, off_t offset, const Command &command, const void *owner)
+{
+	return start(fd, buffer, length, offset, false, command, owner);
+}
+
+bool
+FileIo::writeAt(const util::Fd &fd, const void *buffer, size_t length, off_t offset, const Command &command, const void *owner)
+{
+	return start(fd, const_cast<void *>(buffer), length, offset, true, command, owner);
+}
+
+bool
+FileIo::start(const util::Fd &fd, void *buffer, size_t length, off_t offset, bool write, const Command &command, const void *owner)
+{
+	if (running_.size() >= depth_) {
+		return false;
+	}
+
+	Request *request;
+
+	if (spare_.empty()) {
+		request = new Request();
+	} else {
+		request = spare_.back();
+		spare_.pop_back();
+	}
+	request->fd = fd;
+	request->buffer = buffer;
+	request->length = length;
+	request->offset = offset;
+	request->write = write;
+	request->owner = owner;
+	request->releaseBuffer = false;
+
+	try {
+		request->command = command.clone();
+		if (ring_) {
+			ring_->submit(request);
+		} else {
+			++shared_->working;
+			if (!pool_->submit(dispatcher_, PoolWork(shared_, request), PoolDone(shared_, request))) {
+				--shared_->working;
+				recycle(request);
+				return false;
+			}
+		}
+	} catch (...) {
+		recycle(request);
+		throw;
+	}
+	running_.push_back(request);
+	return true;
+}
+
+void
+FileIo::recycle(Request *request)
+{
+	delete request->command;
+	request->command = 0;
+	spare_.push_back(request);
+}
+
+void
+FileIo::complete(Request *request, const util::IoResult &result)
+{
+	Requests::iterator i(std::find(running_.begin(), running_.end(), request));
+
+	if (i != running_.end()) {
+		*i = running_.back();
+		running_.pop_back();
+	}
+
+	std::unique_ptr<Command> command(request->command);
+	Completion completion(request->buffer, request->length, request->offset, result);
+
+	if (!command && request->releaseBuffer) {
+		util::BufferPool::instance().release(request->buffer, request->length);
+	}
+	// free for whatever the command starts next
+	request->command = 0;
+	spare_.push_back(request);
+	if (command) {
+		command->execute(completion);
+	}
+	wake();
+}
+
+void
+FileIo::notifyReady(const ReadyCommand &command, const void *owner)
+{
+	if (running_.empty()) {
+		return;
+	}
+
+	std::unique_ptr<ReadyCommand> copy(command.clone());
+
+	waiters_.push_back(std::make_pair(owner, copy.get()));
+	copy.release();
+}
+
+void
+FileIo::wake()
+{
+	if (waiters_.empty()) {
+		return;
+	}
+
+	// commands registering again wait for the next completion
+	Waiters waiters;
+
+	waiters.swap(waiters_);
+	for (Waiters::iterator i(waiters.begin()); i != waiters.end(); ++i) {
+		std::unique_ptr<ReadyCommand> command(i->second);
+
+		i->second = 0;
+		try {
+			command->execute();
+		} catch (...) {
+			// the rest keep waiting
+			waiters_.insert(waiters_.end(), i + 1, waiters.end());
+			throw;
+		}
+	}
+}
+
+void
+FileIo::cancel(const void *owner, bool releaseBuffers)
+{
+	for (Requests::const_iterator i(running_.begin()); i != running_.end(); ++i) {
+		if ((*i)->owner == owner && (*i)->command) {
+			delete (*i)->command;
+			(*i)->command = 0;
+			(*i)->releaseBuffer = releaseBuffers;
+		}
+	}
+
+	Waiters::iterator last(waiters_.begin());
+
+	for (Waiters::iterator i(waiters_.begin()); i != waiters_.end(); ++i) {
+		if (i->first == owner) {
+			delete i->second;
+		} else {
+			*last++ = *i;
+		}
+	}
+	waiters_.erase(last, waiters_.end());
+}
+
+void
+FileIo::onRingReady(const FdEvent &event)
+{
+	uint64_t count;
+	util::IoResult result(util::IoResult::success(0));
+
+	event.fd.tryRead(&count, sizeof(count));
+	while (Request *request = ring_->reap(result)) {
+		complete(request, result);
+	}
+}
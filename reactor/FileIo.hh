@@ -0,0 +1,100 @@
+#ifndef REACTOR_REACTOR_FILEIO_HEADER
+#define REACTOR_REACTOR_FILEIO_HEADER
+
+#include <reactor/Dispatcher.hh>
+#include <reactor/OffloadPool.hh>
+
+#include <util/Noncopyable.hh>
+
+#include <memory> // unique_ptr, shared_ptr
+#include <utility> // pair
+#include <vector>
+#include <sys/types.h> // off_t
+
+namespace reactor {
+
+// Positioned reads and writes on regular files without blocking the loop.
+// Regular files always poll ready, so the I/O goes through io_uring with
+// completions signalled on an eventfd, or through an offload pool where
+// io_uring cannot be set up. Buffers must stay valid until the command
+// has run or, after cancel(), until the dispatcher has seen the
+// completion.
+class FileIo : public util::Noncopyable {
+public:
+	struct Completion {
+		void *buffer;
+		size_t length; // as requested
+		off_t offset;
+		util::IoResult result;
+
+		Completion(void *buffer0, size_t length0, off_t offset0, const util::IoResult &result0)
+		: buffer(buffer0)
+		, length(length0)
+		, offset(offset0)
+		, result(result0)
+		{}
+	};
+	typedef util::Command1<void, const Completion &> Command;
+	typedef util::Command0<void> ReadyCommand;
+
+	enum Backend {
+		RING, // falls back to OFFLOAD when io_uring is not available
+		OFFLOAD
+	};
+
+	static const size_t DEFAULT_DEPTH;
+
+private:
+	struct Request;
+	// outlives the FileIo for pool completions still queued in the dispatcher
+	struct Shared;
+	class Ring;
+	class PoolWork;
+	class PoolDone;
+	typedef std::vector<Request *> Requests;
+	typedef std::vector<std::pair<const void *, ReadyCommand *> > Waiters;
+
+	Dispatcher &dispatcher_;
+	std::unique_ptr<Ring> ring_;
+	std::unique_ptr<OffloadPool> ownPool_;
+	OffloadPool *pool_;
+	std::shared_ptr<Shared> shared_;
+	size_t depth_;
+	Requests running_;
+	Requests spare_;
+	Waiters waiters_;
+
+	bool start(const util::Fd &fd, void *buffer, size_t length, off_t offset, bool write, const Command &command, const void *owner);
+	void startPool(Request *request);
+	void complete(Request *request, const util::IoResult &result);
+	void recycle(Request *request);
+	void wake();
+
+	void onRingReady(const FdEvent &event);
+
+public:
+	// without a pool a private one is started when the fallback is needed
+	FileIo(Dispatcher &dispatcher, OffloadPool *pool = 0, size_t depth = DEFAULT_DEPTH, Backend backend = RING);
+	// waits for the I/O in flight, whose commands are dropped
+	~FileIo();
+
+	// false when depth operations are already in flight or the pool refuses
+	bool readAt(const util::Fd &fd, void *buffer, size_t length, off_t offset, const Command &command, const void *owner = 0);
+	bool writeAt(const util::Fd &fd, const void *buffer, size_t length, off_t offset, const Command &command, const void *owner = 0);
+	// Runs the command once after the next operation completes, for callers
+	// refused while others filled the depth. Nothing runs when nothing is in
+	// flight.
+	void notifyReady(const ReadyCommand &command, const void *owner = 0);
+	// Drops the commands of the owner's operations and waits for readiness.
+	// With releaseBuffers the buffers came from util::BufferPool in the
+	// requested length and are given back once the kernel is done with them.
+	void cancel(const void *owner, bool releaseBuffers = false);
+
+	Backend backend() const { return ring_ ? RING : OFFLOAD; }
+	size_t depth() const { return depth_; }
+	size_t inflight() const { return running_.size(); }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_FILEIO_HEADER
@@ -0,0 +1,233 @@
+#include "FileReader.hh"
+
+#include <util/BufferPool.hh>
+
+#include <algorithm> // std::min()
+#include <stdexcept>
+#include <cerrno>
+
+using namespace reactor;
+
+const size_t FileReader::DEFAULT_CHUNK_SIZE = 64 * 1024;
+const size_t FileReader::DEFAULT_READ_AHEAD = 4;
+const size_t FileReader::UNLIMITED = (size_t)-1;
+
+FileReader::FileReader(FileIo &io, const DataCommand &dataCommand, const EndCommand &endCommand)
+: io_(io)
+, dataCommand_(dataCommand.clone())
+, endCommand_(endCommand.clone())
+, chunkSize_(DEFAULT_CHUNK_SIZE)
+, readAhead_(DEFAULT_READ_AHEAD)
+, next_(0)
+, end_(-1)
+, delivered_(0)
+, reading_(false)
+, paused_(false)
+, delivering_(false)
+, exhausted_(false)
+, waiting_(false)
+{}
+
+FileReader::~FileReader()
+{
+	stop();
+	releaseSpare();
+}
+
+void
+FileReader::setChunkSize(size_t chunkSize)
+{
+	// spare buffers are only reused at the chunk size they were made for
+	releaseSpare();
+	chunkSize_ = chunkSize;
+}
+
+void
+FileReader::releaseSpare()
+{
+	for (std::vector<char *>::const_iterator i(spare_.begin()); i != spare_.end(); ++i) {
+		util::BufferPool::instance().release(*i, chunkSize_);
+	}
+	spare_.clear();
+}
+
+char *
+FileReader::allocate(size_t length)
+{
+	if (length == chunkSize_ && !spare_.empty()) {
+		char *buffer = spare_.back();
+
+		spare_.pop_back();
+		return buffer;
+	}
+	return static_cast<char *>(util::BufferPool::instance().allocate(length));
+}
+
+void
+FileReader::release(char *buffer, size_t length)
+{
+	if (length == chunkSize_ && spare_.size() < readAhead_) {
+		spare_.push_back(buffer);
+	} else {
+		util::BufferPool::instance().release(buffer, length);
+	}
+}
+
+void
+FileReader::start(const util::Fd &file, off_t offset, size_t length)
+{
+	if (reading_) {
+		throw std::runtime_error("file is already being read");
+	} else if (!chunkSize_ || !readAhead_) {
+		throw std::invalid_argument("chunk size and read-ahead must be positive");
+	}
+
+	file_ = file;
+	next_ = offset;
+	end_ = length == UNLIMITED ? -1 : offset + (off_t)length;
+	delivered_ = 0;
+	reading_ = true;
+	paused_ = false;
+	exhausted_ = false;
+	fill();
+	deliver();
+}
+
+void
+FileReader::fill()
+{
+	while (reading_ && !exhausted_ && window_.size() < readAhead_) {
+		size_t length = chunkSize_;
+
+		if (end_ >= 0) {
+			if (next_ >= end_) {
+				exhausted_ = true;
+				break;
+			}
+			length = std::min(length, (size_t)(end_ - next_));
+		}
+
+		char *buffer = allocate(length);
+
+		if (!io_.readAt(file_, buffer, length, next_, util::commandForMethod(*this, &FileReader::onRead), this)) {
+			release(buffer, length);
+			break;
+		}
+		window_.push_back(Slot(buffer, length, next_));
+		next_ += length;
+	}
+
+	if (reading_ && window_.empty() && !exhausted_ && !waiting_) {
+		// a shared FileIo at depth frees up with the next completion of another user
+		if (io_.inflight()) {
+			io_.notifyReady(util::commandForMethod(*this, &FileReader::onReady), this);
+			waiting_ = true;
+		} else {
+			// nothing in flight would ever bring the stream forward again
+			finish(util::IoResult::failure(EBUSY));
+		}
+	}
+}
+
+void
+FileReader::deliver()
+{
+	// a command resuming the reader lands here again
+	if (delivering_) {
+		return;
+	}
+
+	delivering_ = true;
+	while (reading_ && !paused_ && !window_.empty() && window_.front().done) {
+		Slot slot(window_.front());
+
+		window_.pop_front();
+		if (!slot.result.ok()) {
+			release(slot.buffer, slot.length);
+			delivering_ = false;
+			finish(slot.result);
+			return;
+		}
+
+		size_t bytes = slot.result.bytes();
+
+		if (bytes) {
+			delivered_ += bytes;
+			dataCommand_->execute(Chunk(slot.buffer, bytes, slot.offset));
+		}
+		release(slot.buffer, slot.length);
+
+		// a short read is the end of the file, whatever was read ahead behind it is empty
+		if (bytes < slot.length) {
+			delivering_ = false;
+			finish(util::IoResult::success(delivered_));
+			return;
+		}
+	}
+	delivering_ = false;
+
+	if (reading_ && window_.empty() && exhausted_) {
+		finish(util::IoResult::success(delivered_));
+	}
+}
+
+void
+FileReader::finish(const util::IoResult &result)
+{
+	if (!reading_) {
+		return;
+	}
+	stop();
+	endCommand_->execute(result);
+}
+
+void
+FileReader::resume()
+{
+	paused_ = false;
+	deliver();
+	fill();
+}
+
+void
+FileReader::stop()
+{
+	if (!reading_) {
+		return;
+	}
+
+	reading_ = false;
+	waiting_ = false;
+	// reads still in flight give their buffers back to the pool when done
+	io_.cancel(this, true);
+	for (Window::const_iterator i(window_.begin()); i != window_.end(); ++i) {
+		if (i->done) {
+			release(i->buffer, i->length);
+		}
+	}
+	window_.clear();
+}
+
+void
+FileReader::onRead(const FileIo::Completion &completion)
+{
+	for (Window::iterator i(window_.begin()); i != window_.end(); ++i) {
+		if (i->buffer == completion.buffer) {
+			i->done = true;
+			i->result = completion.result;
+			if (!completion.result.ok() || completion.result.bytes() < i->length) {
+				exhausted_ = true;
+			}
+			break;
+		}
+	}
+	deliver();
+	fill();
+}
+
+void
+FileReader::onReady()
+{
+	waiting_ = false;
+	fill();
+}
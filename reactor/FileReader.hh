@@ -0,0 +1,109 @@
+#ifndef REACTOR_REACTOR_FILEREADER_HEADER
+#define REACTOR_REACTOR_FILEREADER_HEADER
+
+#include <reactor/FileIo.hh>
+
+#include <util/Noncopyable.hh>
+
+#include <deque>
+#include <memory> // unique_ptr
+#include <vector>
+
+namespace reactor {
+
+// Streams a file front to back through FileIo, keeping up to the read-ahead
+// depth of chunks in flight and handing them over in file order. Chunk
+// buffers come from util::BufferPool and are reused once the data command
+// returns, so the command has to copy what it keeps, for instance into a
+// connection's output. Pausing stops delivery, the read-ahead window still
+// fills.
+class FileReader : public util::Noncopyable {
+public:
+	struct Chunk {
+		const char *data;
+		size_t length;
+		off_t offset;
+
+		Chunk(const char *data0, size_t length0, off_t offset0)
+		: data(data0)
+		, length(length0)
+		, offset(offset0)
+		{}
+	};
+	typedef util::Command1<void, const Chunk &> DataCommand;
+	// the result holds the bytes delivered, or the error that stopped the stream
+	typedef util::Command1<void, const util::IoResult &> EndCommand;
+
+	static const size_t DEFAULT_CHUNK_SIZE;
+	static const size_t DEFAULT_READ_AHEAD;
+	static const size_t UNLIMITED;
+
+private:
+	struct Slot {
+		char *buffer;
+		size_t length;
+		off_t offset;
+		bool done;
+		util::IoResult result;
+
+		Slot(char *buffer0, size_t length0, off_t offset0)
+		: buffer(buffer0)
+		, length(length0)
+		, offset(offset0)
+		, done(false)
+		, result(util::IoResult::success(0))
+		{}
+	};
+	typedef std::deque<Slot> Window;
+
+	FileIo &io_;
+	std::unique_ptr<DataCommand> dataCommand_;
+	std::unique_ptr<EndCommand> endCommand_;
+	size_t chunkSize_;
+	size_t readAhead_;
+	util::Fd file_;
+	off_t next_;
+	off_t end_;
+	Window window_;
+	std::vector<char *> spare_;
+	size_t delivered_;
+	bool reading_;
+	bool paused_;
+	bool delivering_;
+	bool exhausted_;
+	bool waiting_;
+
+	char *allocate(size_t length);
+	void release(char *buffer, size_t length);
+	void releaseSpare();
+	void fill();
+	void deliver();
+	void finish(const util::IoResult &result);
+
+	void onRead(const FileIo::Completion &completion);
+	void onReady();
+
+public:
+	FileReader(FileIo &io, const DataCommand &dataCommand, const EndCommand &endCommand);
+	~FileReader();
+
+	// apply to the reads issued from now on, the read-ahead should stay below the FileIo depth
+	void setChunkSize(size_t chunkSize);
+	void setReadAhead(size_t readAhead) { readAhead_ = readAhead; }
+
+	void start(const util::Fd &file, off_t offset = 0, size_t length = UNLIMITED);
+	void pause() { paused_ = true; }
+	void resume();
+	// drops the chunks in flight, no end command runs
+	void stop();
+
+	bool reading() const { return reading_; }
+	bool paused() const { return paused_; }
+	size_t delivered() const { return delivered_; }
+	// chunks read ahead or in flight
+	size_t buffered() const { return window_.size(); }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_FILEREADER_HEADER
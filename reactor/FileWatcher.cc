@@ -0,0 +1,159 @@
+#include "FileWatcher.hh"
+
+#include <util/ErrnoException.hh>
+
+#include <stdexcept>
+
+using namespace reactor;
+
+const size_t FileWatcher::BUFFER_SIZE = 64 * 1024;
+
+namespace {
+
+const size_t MAX_READS_PER_WAKEUP = 16;
+
+} // namespace
+
+FileWatcher::FileWatcher(Dispatcher &dispatcher)
+: dispatcher_(dispatcher)
+, buffer_(BUFFER_SIZE)
+, coalesced_(0)
+{
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (fd < 0) {
+		throw util::ErrnoException("inotify_init1");
+	}
+	fd_.reset(fd);
+	dispatcher_.add(FdEvent(fd_, FdEvent::READ), util::commandForMethod(*this, &FileWatcher::onReadable));
+}
+
+FileWatcher::~FileWatcher()
+{
+	dispatcher_.remove(FdEvent(fd_, FdEvent::READ));
+	for (Watches::const_iterator i(watches_.begin()); i != watches_.end(); ++i) {
+		delete i->second.command;
+	}
+	for (std::vector<Command *>::const_iterator i(retired_.begin()); i != retired_.end(); ++i) {
+		delete *i;
+	}
+}
+
+int
+FileWatcher::add(const std::string &path, uint32_t mask, const Command &command)
+{
+	int watch = inotify_add_watch(fd_.get(), path.c_str(), mask);
+
+	if (watch < 0) {
+		throw util::ErrnoException("inotify_add_watch");
+	}
+
+	Watches::iterator i(watches_.find(watch));
+
+	if (i != watches_.end()) {
+		retire(i);
+	}
+	watches_.insert(Watches::value_type(watch, Watch(path, command.clone())));
+	return watch;
+}
+
+void
+FileWatcher::remove(int watch)
+{
+	Watches::iterator i(watches_.find(watch));
+
+	if (i == watches_.end()) {
+		throw std::runtime_error("path is not watched");
+	}
+	// the kernel answers with IN_IGNORED, which is dropped as the watch is unknown by then
+	inotify_rm_watch(fd_.get(), watch);
+	retire(i);
+}
+
+void
+FileWatcher::retire(Watches::iterator i)
+{
+	// the command may be the one running
+	retired_.push_back(i->second.command);
+	watches_.erase(i);
+}
+
+void
+FileWatcher::collect(int watch, const std::string &name, uint32_t mask, uint32_t cookie)
+{
+	std::pair<BatchIndex::iterator, bool> ret(batchIndex_.insert(BatchIndex::value_type(std::make_pair(watch, name), batch_.size())));
+
+	if (!ret.second) {
+		const Pending &last = batch_[ret.first->second];
+
+		if (last.mask == mask && last.cookie == cookie) {
+			++coalesced_;
+			return;
+		}
+		ret.first->second = batch_.size();
+	}
+	batch_.push_back(Pending(watch, name, mask, cookie));
+}
+
+void
+FileWatcher::collectOverflow()
+{
+	// events were lost, every watch has to look for itself
+	for (Watches::const_iterator i(watches_.begin()); i != watches_.end(); ++i) {
+		collect(i->first, std::string(), IN_Q_OVERFLOW);
+	}
+}
+
+void
+FileWatcher::dispatch()
+{
+	for (Batch::const_iterator i(batch_.begin()); i != batch_.end(); ++i) {
+		Watches::iterator watch(watches_.find(i->watch));
+
+		// removed by the kernel or by an earlier command
+		if (watch == watches_.end()) {
+			continue;
+		}
+
+		Command *command = watch->second.command;
+
+		command->execute(Event(i->watch, watch->second.path, i->name, i->mask, i->cookie));
+		watch = watches_.find(i->watch);
+		if (i->mask & IN_IGNORED && watch != watches_.end() && watch->second.command == command) {
+			retire(watch);
+		}
+	}
+}
+
+void
+FileWatcher::onReadable(const FdEvent &event)
+{
+	batch_.clear();
+	batchIndex_.clear();
+	for (size_t n = 0; n < MAX_READS_PER_WAKEUP; ++n) {
+		util::IoResult result(event.fd.tryRead(&buffer_[0], buffer_.size()));
+
+		if (result.transient()) {
+			break;
+		}
+		result.check("read");
+
+		for (size_t offset = 0; offset < result.bytes(); ) {
+			const struct inotify_event *e = reinterpret_cast<const struct inotify_event *>(&buffer_[offset]);
+
+			if (e->mask & IN_Q_OVERFLOW) {
+				collectOverflow();
+			} else {
+				// the name is NUL padded to the record length
+				collect(e->wd, e->len ? std::string(e->name) : std::string(), e->mask, e->cookie);
+			}
+			offset += sizeof(struct inotify_event) + e->len;
+		}
+	}
+
+	dispatch();
+	for (std::vector<Command *>::const_iterator i(retired_.begin()); i != retired_.end(); ++i) {
+		delete *i;
+	}
+	retired_.clear();
+}
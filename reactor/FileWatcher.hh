@@ -0,0 +1,106 @@
+#ifndef REACTOR_REACTOR_FILEWATCHER_HEADER
+#define REACTOR_REACTOR_FILEWATCHER_HEADER
+
+#include <reactor/Dispatcher.hh>
+
+#include <util/AutoFd.hh>
+#include <util/Noncopyable.hh>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility> // std::pair
+#include <vector>
+#include <sys/inotify.h>
+
+namespace reactor {
+
+// Reports file system changes through inotify. All queued events are read
+// in one go, and an event repeating the previous one for the same path
+// within that batch is merged into it, so a burst of writes to a file
+// costs its command a single call. Different events for a path keep their
+// order.
+class FileWatcher : public util::Noncopyable {
+public:
+	struct Event {
+		int watch;
+		const std::string &path; // as passed to add()
+		const std::string &name; // entry of a watched directory, empty for the path itself
+		uint32_t mask;
+		uint32_t cookie; // pairs IN_MOVED_FROM with IN_MOVED_TO
+
+		Event(int watch0, const std::string &path0, const std::string &name0, uint32_t mask0, uint32_t cookie0)
+		: watch(watch0)
+		, path(path0)
+		, name(name0)
+		, mask(mask0)
+		, cookie(cookie0)
+		{}
+	};
+	typedef util::Command1<void, const Event &> Command;
+
+	static const size_t BUFFER_SIZE;
+
+private:
+	struct Watch {
+		std::string path;
+		Command *command;
+
+		Watch(const std::string &path0, Command *command0)
+		: path(path0)
+		, command(command0)
+		{}
+	};
+	typedef std::map<int, Watch> Watches;
+
+	struct Pending {
+		int watch;
+		std::string name;
+		uint32_t mask;
+		uint32_t cookie;
+
+		Pending(int watch0, const std::string &name0, uint32_t mask0, uint32_t cookie0)
+		: watch(watch0)
+		, name(name0)
+		, mask(mask0)
+		, cookie(cookie0)
+		{}
+	};
+	typedef std::vector<Pending> Batch;
+	// the latest pending event of each path
+	typedef std::map<std::pair<int, std::string>, size_t> BatchIndex;
+
+	Dispatcher &dispatcher_;
+	util::AutoFd fd_;
+	Watches watches_;
+	std::vector<char> buffer_;
+	Batch batch_;
+	BatchIndex batchIndex_;
+	// commands of removed watches, deleted once no command is running
+	std::vector<Command *> retired_;
+	size_t coalesced_;
+
+	void collect(int watch, const std::string &name, uint32_t mask, uint32_t cookie = 0);
+	void collectOverflow();
+	void dispatch();
+	void retire(Watches::iterator i);
+
+	void onReadable(const FdEvent &event);
+
+public:
+	explicit FileWatcher(Dispatcher &dispatcher);
+	~FileWatcher();
+
+	// mask takes IN_* flags, adding a path that is already watched replaces its mask and command
+	int add(const std::string &path, uint32_t mask, const Command &command);
+	void remove(int watch);
+
+	size_t size() const { return watches_.size(); }
+	// events merged into the identical one before them
+	size_t coalesced() const { return coalesced_; }
+	const util::Fd &fd() const { return fd_; }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_FILEWATCHER_HEADER
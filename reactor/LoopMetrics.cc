@@ -0,0 +1,199 @@
+#include "LoopMetrics.hh"
+
+#include <new> // std::bad_alloc
+#include <stdlib.h> // posix_memalign()
+#include <time.h>
+
+using namespace reactor;
+
+namespace {
+
+const std::memory_order RELAXED = std::memory_order_relaxed;
+
+// single writer, a load and a store need no locked read-modify-write
+void
+bump(std::atomic<uint64_t> &counter, uint64_t n)
+{
+	counter.store(counter.load(RELAXED) + n, RELAXED);
+}
+
+uint64_t
+micros(const util::DiffTime &diff)
+{
+	int64_t raw = diff.raw();
+
+	if (raw <= 0) {
+		return 0;
+	}
+	return (raw >> 32) * 1000000 + (((raw & 0xffffffff) * 1000000) >> 32);
+}
+
+} // namespace
+
+uint64_t
+LoopMetrics::HistogramSnapshot::total()
+const
+{
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		sum += counts[i];
+	}
+	return sum;
+}
+
+uint64_t
+LoopMetrics::HistogramSnapshot::percentile(double p)
+const
+{
+	uint64_t all = total();
+	uint64_t wanted = (uint64_t)(p * all + 0.5);
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		sum += counts[i];
+		if (sum && sum >= wanted) {
+			return upperBound(i);
+		}
+	}
+	return 0;
+}
+
+uint64_t
+LoopMetrics::HistogramSnapshot::upperBound(size_t bucket)
+{
+	// the last bucket takes everything above the one before
+	return bucket + 1 >= BUCKETS ? UINT64_MAX : ((uint64_t)1 << bucket) - 1;
+}
+
+size_t
+LoopMetrics::Histogram::bucket(uint64_t value)
+{
+	size_t i = value ? 64 - __builtin_clzll(value) : 0;
+
+	return i < BUCKETS ? i : BUCKETS - 1;
+}
+
+void
+LoopMetrics::Histogram::record(uint64_t value)
+{
+	bump(counts_[bucket(value)], 1);
+}
+
+void
+LoopMetrics::Histogram::snapshot(HistogramSnapshot &snapshot)
+const
+{
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		snapshot.counts[i] = counts_[i].load(RELAXED);
+	}
+}
+
+void
+LoopMetrics::Histogram::reset()
+{
+	for (size_t i = 0; i < BUCKETS; ++i) {
+		counts_[i].store(0, RELAXED);
+	}
+}
+
+void *
+LoopMetrics::operator new(size_t size)
+{
+	void *p;
+
+	if (posix_memalign(&p, alignof(LoopMetrics), size)) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void
+LoopMetrics::operator delete(void *p)
+{
+	free(p);
+}
+
+uint64_t
+LoopMetrics::clock()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void
+LoopMetrics::recordWait(uint64_t blocked, size_t events)
+{
+	bump(counters_.iterations, 1);
+	bump(counters_.blockedTime, blocked);
+	bump(counters_.events, events);
+	blocked_.record(blocked);
+	events_.record(events);
+}
+
+void
+LoopMetrics::recordBacklog(size_t depth)
+{
+	if (depth > counters_.maxBacklog.load(RELAXED)) {
+		counters_.maxBacklog.store(depth, RELAXED);
+	}
+	backlog_.record(depth);
+}
+
+void
+LoopMetrics::recordRun(uint64_t running, size_t jobs)
+{
+	bump(counters_.runningTime, running);
+	bump(counters_.jobs, jobs);
+	running_.record(running);
+	jobs_.record(jobs);
+}
+
+void
+LoopMetrics::recordTimer(const util::DiffTime &lateness)
+{
+	bump(counters_.timersFired, 1);
+	lateness_.record(micros(lateness));
+}
+
+LoopMetrics::Snapshot
+LoopMetrics::snapshot()
+const
+{
+	Snapshot snapshot;
+
+	snapshot.iterations = counters_.iterations.load(RELAXED);
+	snapshot.events = counters_.events.load(RELAXED);
+	snapshot.jobs = counters_.jobs.load(RELAXED);
+	snapshot.timersFired = counters_.timersFired.load(RELAXED);
+	snapshot.blockedTime = counters_.blockedTime.load(RELAXED);
+	snapshot.runningTime = counters_.runningTime.load(RELAXED);
+	snapshot.maxBacklog = counters_.maxBacklog.load(RELAXED);
+	blocked_.snapshot(snapshot.blocked);
+	running_.snapshot(snapshot.running);
+	events_.snapshot(snapshot.eventsPerIteration);
+	jobs_.snapshot(snapshot.jobsPerIteration);
+	backlog_.snapshot(snapshot.backlog);
+	lateness_.snapshot(snapshot.lateness);
+	return snapshot;
+}
+
+void
+LoopMetrics::reset()
+{
+	counters_.iterations.store(0, RELAXED);
+	counters_.events.store(0, RELAXED);
+	counters_.jobs.store(0, RELAXED);
+	counters_.timersFired.store(0, RELAXED);
+	counters_.blockedTime.store(0, RELAXED);
+	counters_.runningTime.store(0, RELAXED);
+	counters_.maxBacklog.store(0, RELAXED);
+	blocked_.reset();
+	running_.reset();
+	events_.reset();
+	jobs_.reset();
+	backlog_.reset();
+	lateness_.reset();
+}
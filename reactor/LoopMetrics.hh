@@ -0,0 +1,104 @@
+#ifndef REACTOR_REACTOR_LOOPMETRICS_HEADER
+#define REACTOR_REACTOR_LOOPMETRICS_HEADER
+
+#include <util/DiffTime.hh>
+#include <util/Noncopyable.hh>
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace reactor {
+
+// Per-iteration counters and histograms of one dispatcher. Only the
+// dispatcher's thread records, with plain relaxed stores, so recording
+// costs no locked instructions. Any thread may take a snapshot; a snapshot
+// taken while the loop records can be off by the iteration in progress.
+// Each group of counters sits on its own cache lines, so neither the
+// dispatcher's other members nor another thread's metrics share them.
+class alignas(64) LoopMetrics : public util::Noncopyable {
+public:
+	// bucket 0 counts zeros, bucket i counts values below 2^i not counted by bucket i - 1
+	enum { BUCKETS = 32 };
+
+	struct HistogramSnapshot {
+		uint64_t counts[BUCKETS];
+
+		uint64_t total() const;
+		// the bucket limit the given share of values does not exceed, p in [0, 1]
+		uint64_t percentile(double p) const;
+		static uint64_t upperBound(size_t bucket);
+	};
+
+	// times are in microseconds of the monotonic clock
+	struct Snapshot {
+		uint64_t iterations;
+		uint64_t events;
+		uint64_t jobs;
+		uint64_t timersFired;
+		uint64_t blockedTime;
+		uint64_t runningTime;
+		uint64_t maxBacklog;
+		HistogramSnapshot blocked;
+		HistogramSnapshot running;
+		HistogramSnapshot eventsPerIteration;
+		HistogramSnapshot jobsPerIteration;
+		HistogramSnapshot backlog;
+		HistogramSnapshot lateness;
+	};
+
+private:
+	class alignas(64) Histogram {
+		std::atomic<uint64_t> counts_[BUCKETS];
+
+	public:
+		Histogram() { reset(); }
+
+		void record(uint64_t value);
+		void snapshot(HistogramSnapshot &snapshot) const;
+		void reset();
+
+		static size_t bucket(uint64_t value);
+	};
+
+	struct alignas(64) Counters {
+		std::atomic<uint64_t> iterations;
+		std::atomic<uint64_t> events;
+		std::atomic<uint64_t> jobs;
+		std::atomic<uint64_t> timersFired;
+		std::atomic<uint64_t> blockedTime;
+		std::atomic<uint64_t> runningTime;
+		std::atomic<uint64_t> maxBacklog;
+	};
+
+	Counters counters_;
+	Histogram blocked_;
+	Histogram running_;
+	Histogram events_;
+	Histogram jobs_;
+	Histogram backlog_;
+	Histogram lateness_;
+
+public:
+	LoopMetrics() { reset(); }
+
+	// C++11 new does not honour the alignment by itself
+	static void *operator new(size_t size);
+	static void operator delete(void *p);
+
+	// monotonic microseconds, cheap enough to read twice per iteration
+	static uint64_t clock();
+
+	void recordWait(uint64_t blocked, size_t events);
+	void recordBacklog(size_t depth);
+	void recordRun(uint64_t running, size_t jobs);
+	void recordTimer(const util::DiffTime &lateness);
+
+	Snapshot snapshot() const;
+	// from the dispatcher's thread only, other threads subtract snapshots instead
+	void reset();
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_LOOPMETRICS_HEADER
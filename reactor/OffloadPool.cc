@@ -0,0 +1,218 @@
+#include "OffloadPool.hh"
+
+#include <memory> // unique_ptr
+#include <stdexcept>
+
+using namespace reactor;
+
+const size_t OffloadPool::DEFAULT_QUEUE_LIMIT = 1024;
+
+struct OffloadPool::Task : public util::Noncopyable {
+	Dispatcher &dispatcher;
+	std::unique_ptr<Work> work;
+	std::unique_ptr<Completion> completion;
+	FdEvent parked;
+	bool parking;
+	std::exception_ptr error;
+
+	Task(Dispatcher &dispatcher0, const Work &work0, const Completion &completion0, const FdEvent &parked0, bool parking0)
+	: dispatcher(dispatcher0)
+	, work(work0.clone())
+	, completion(completion0.clone())
+	, parked(parked0)
+	, parking(parking0)
+	{}
+};
+
+namespace {
+
+// carries a finished task back to its dispatcher, owning it until run or dropped;
+// a cancelled task only gives its parked fd back
+class Delivery : public Backlog::Job {
+	mutable OffloadPool::Task *task_;
+	bool cancelled_;
+
+	Delivery &operator=(const Delivery &);
+
+public:
+	explicit Delivery(OffloadPool::Task *task, bool cancelled = false) : task_(task), cancelled_(cancelled) {}
+
+	Delivery(const Delivery &orig)
+	: task_(orig.task_)
+	, cancelled_(orig.cancelled_)
+	{
+		orig.task_ = 0;
+	}
+
+	~Delivery() { delete task_; }
+
+	virtual Delivery *clone() const { return new Delivery(*this); }
+
+	virtual void
+	execute()
+	const
+	{
+		OffloadPool::Task &task = *task_;
+
+		if (task.parking) {
+			task.dispatcher.unpark(task.parked);
+		}
+		if (!cancelled_) {
+			task.completion->execute(task.error);
+		}
+	}
+};
+
+} // namespace
+
+OffloadPool::OffloadPool(size_t threadCount, size_t queueLimit)
+: threadCount_(threadCount ? threadCount : std::thread::hardware_concurrency())
+, queueLimit_(queueLimit)
+, maxQueued_(0)
+, stopping_(false)
+, started_(LoopMetrics::clock())
+, submitted_(0)
+, refused_(0)
+, completed_(0)
+, failed_(0)
+, active_(0)
+, busyTime_(0)
+{
+	if (!threadCount_) {
+		threadCount_ = 1;
+	}
+	for (size_t i = 0; i < threadCount_; ++i) {
+		threads_.push_back(std::thread(&OffloadPool::run, this));
+	}
+}
+
+OffloadPool::~OffloadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		stopping_ = true;
+	}
+	available_.notify_all();
+	for (std::vector<std::thread>::iterator i(threads_.begin()); i != threads_.end(); ++i) {
+		i->join();
+	}
+	while (!queue_.empty()) {
+		Task *task = queue_.front();
+
+		queue_.pop_front();
+		if (task->parking) {
+			task->dispatcher.post(Delivery(task, true));
+		} else {
+			delete task;
+		}
+	}
+}
+
+bool
+OffloadPool::enqueue(Task *task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (queue_.size() >= queueLimit_) {
+			++refused_;
+			return false;
+		}
+		queue_.push_back(task);
+		if (queue_.size() > maxQueued_) {
+			maxQueued_ = queue_.size();
+		}
+	}
+	++submitted_;
+	available_.notify_one();
+	return true;
+}
+
+bool
+OffloadPool::submit(Dispatcher &dispatcher, const Work &work, const Completion &completion)
+{
+	std::unique_ptr<Task> task(new Task(dispatcher, work, completion, FdEvent(util::Fd(), FdEvent::READ), false));
+
+	if (!enqueue(task.get())) {
+		return false;
+	}
+	task.release();
+	return true;
+}
+
+bool
+OffloadPool::submit(Dispatcher &dispatcher, const FdEvent &parked, const Work &work, const Completion &completion)
+{
+	std::unique_ptr<Task> task(new Task(dispatcher, work, completion, parked, true));
+
+	if (!enqueue(task.get())) {
+		return false;
+	}
+	task.release();
+	// parking only after acceptance leaves a refused fd to the caller
+	dispatcher.park(parked);
+	return true;
+}
+
+void
+OffloadPool::run()
+{
+	for (;;) {
+		Task *task;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+
+			while (queue_.empty() && !stopping_) {
+				available_.wait(lock);
+			}
+			if (stopping_) {
+				return;
+			}
+			task = queue_.front();
+			queue_.pop_front();
+		}
+
+		uint64_t start = LoopMetrics::clock();
+
+		++active_;
+		try {
+			task->work->execute();
+		} catch (...) {
+			task->error = std::current_exception();
+			++failed_;
+		}
+		--active_;
+		busyTime_ += LoopMetrics::clock() - start;
+		++completed_;
+		task->dispatcher.post(Delivery(task));
+	}
+}
+
+size_t
+OffloadPool::queued()
+const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return queue_.size();
+}
+
+size_t
+OffloadPool::maxQueued()
+const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return maxQueued_;
+}
+
+double
+OffloadPool::utilization()
+const
+{
+	uint64_t elapsed = LoopMetrics::clock() - started_;
+
+	return elapsed ? (double)busyTime_ / ((double)elapsed * threadCount_) : 0;
+}
@@ -0,0 +1,83 @@
+#ifndef REACTOR_REACTOR_OFFLOADPOOL_HEADER
+#define REACTOR_REACTOR_OFFLOADPOOL_HEADER
+
+#include <reactor/Dispatcher.hh>
+
+#include <util/Noncopyable.hh>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception> // exception_ptr
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace reactor {
+
+// Runs blocking work on a fixed set of threads. The completion of each job
+// is posted back to the dispatcher it was submitted from and runs there as
+// a backlog job. The queue is bounded: submit() refuses work beyond the
+// limit so the caller can push back on its own input, for instance by
+// pausing reads. The pool must go before the dispatchers it delivers to.
+class OffloadPool : public util::Noncopyable {
+public:
+	// work runs on a pool thread, the completion on the submitting dispatcher's
+	// thread with what the work threw, or null when it returned
+	typedef util::Command0<void> Work;
+	typedef util::Command1<void, const std::exception_ptr &> Completion;
+
+	static const size_t DEFAULT_QUEUE_LIMIT;
+
+	struct Task;
+
+private:
+	typedef std::deque<Task *> Queue;
+
+	size_t threadCount_;
+	size_t queueLimit_;
+	std::vector<std::thread> threads_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable available_;
+	Queue queue_;
+	size_t maxQueued_;
+	bool stopping_;
+
+	uint64_t started_; // LoopMetrics::clock()
+	std::atomic<size_t> submitted_;
+	std::atomic<size_t> refused_;
+	std::atomic<size_t> completed_;
+	std::atomic<size_t> failed_;
+	std::atomic<size_t> active_;
+	std::atomic<uint64_t> busyTime_; // microseconds
+
+	bool enqueue(Task *task);
+	void run();
+
+public:
+	explicit OffloadPool(size_t threadCount = 0, size_t queueLimit = DEFAULT_QUEUE_LIMIT);
+	// waits for running work, queued work is dropped without completion and its parked fds are unparked
+	~OffloadPool();
+
+	// false when the queue is full, nothing is run then
+	bool submit(Dispatcher &dispatcher, const Work &work, const Completion &completion);
+	// also parks the fd until the completion has run, a throwing work still completes and unparks
+	bool submit(Dispatcher &dispatcher, const FdEvent &parked, const Work &work, const Completion &completion);
+
+	size_t threadCount() const { return threadCount_; }
+	size_t queueLimit() const { return queueLimit_; }
+	size_t queued() const;
+	size_t maxQueued() const;
+	size_t submitted() const { return submitted_; }
+	size_t refused() const { return refused_; }
+	size_t completed() const { return completed_; }
+	size_t failed() const { return failed_; }
+	size_t active() const { return active_; }
+	// share of the pool's thread time spent running work since it started
+	double utilization() const;
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_OFFLOADPOOL_HEADER
@@ -38,12 +38,16 @@ PollDemuxer::remove(const FdEvent &fdEvent)
 				fds_.erase(i);
 				break;
 			}
+			if (!i->events && (fdEvent.what == FdEvent::ERROR)) {
+				fds_.erase(i);
+				break;
+			}
 		}
 	}
 }
 
-PollDemuxer::FdEvents *
-PollDemuxer::demux(const util::DiffTime *interval)
+void
+PollDemuxer::demux(const util::DiffTime *interval, FdEvents &fdEvents)
 {
 	int ms = interval ? interval->ms() : -1;
 	int ret = poll(&fds_[0], fds_.size(), ms);
@@ -51,17 +55,17 @@ PollDemuxer::demux(const util::DiffTime *interval)
 	if (ret < 0) {
 		throw util::ErrnoException("poll");
 	} else {
-		FdEvents *result = new FdEvents();
-
 		for (size_t i = 0; i < fds_.size(); ++i) {
-			if (fds_[i].revents & (POLLIN | POLLHUP)) {
-				result->push_back(FdEvent(util::Fd(fds_[i].fd), FdEvent::READ));
+			// hangups and errors are reported on every entry, hand them to whoever watches it
+			if ((fds_[i].events & POLLIN) && (fds_[i].revents & (POLLIN | POLLHUP))) {
+				fdEvents.push_back(FdEvent(util::Fd(fds_[i].fd), FdEvent::READ));
+			}
+			if ((fds_[i].events & POLLOUT) && (fds_[i].revents & (POLLOUT | POLLHUP | POLLERR))) {
+				fdEvents.push_back(FdEvent(util::Fd(fds_[i].fd), FdEvent::WRITE));
 			}
-			if (fds_[i].revents & POLLOUT) {
-				result->push_back(FdEvent(util::Fd(fds_[i].fd), FdEvent::WRITE));
+			if (!fds_[i].events && (fds_[i].revents & POLLERR)) {
+				fdEvents.push_back(FdEvent(util::Fd(fds_[i].fd), FdEvent::ERROR));
 			}
 		}
-
-		return result;
 	}
 }
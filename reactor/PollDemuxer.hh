@@ -14,9 +14,10 @@ class PollDemuxer : public Demuxer {
 	Fds fds_;
 
 public:
+	virtual void reserve(size_t fds) { fds_.reserve(fds); }
 	virtual void add(const FdEvent &fdEvent);
 	virtual void remove(const FdEvent &fdEvent);
-	virtual FdEvents *demux(const util::DiffTime *interval);
+	virtual void demux(const util::DiffTime *interval, FdEvents &fdEvents);
 };
 
 } // namespace reactor
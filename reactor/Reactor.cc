@@ -1,16 +1,21 @@
 #include "Reactor.hh"
 
-#include "Dispatcher.hh"
-
 #include <cstdlib>
 
 using namespace reactor;
 
+void
+Reactor::quit()
+{
+	quit_ = true;
+	dispatcher_.notify();
+}
+
 int
 Reactor::loop()
 {
 	while (!quit_) {
-		Dispatcher::instance().stepSingleThread();
+		dispatcher_.stepSingleThread();
 	}
 
 	return EXIT_SUCCESS;
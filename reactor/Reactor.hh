@@ -1,18 +1,25 @@
 #ifndef REACTOR_REACTOR_REACTOR_REACTOR_HEADER
 #define REACTOR_REACTOR_REACTOR_REACTOR_HEADER
 
+#include <reactor/Dispatcher.hh>
+
+#include <atomic>
+
 namespace reactor {
 
 class Reactor {
 protected:
-	volatile bool quit_;
+	Dispatcher &dispatcher_;
+	std::atomic<bool> quit_;
 
 public:
-	Reactor()
-	: quit_(false)
+	explicit Reactor(Dispatcher &dispatcher = Dispatcher::instance())
+	: dispatcher_(dispatcher)
+	, quit_(false)
 	{}
 
-	void quit() { quit_ = true; }
+	// may be called from any thread, wakes the loop to see it
+	void quit();
 	int loop();
 };
 
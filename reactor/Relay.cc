@@ -0,0 +1,263 @@
+#include "Relay.hh"
+
+#include <util/SigPipeGuard.hh>
+
+#include <cerrno>
+#include <algorithm> // min
+#include <fcntl.h> // splice
+#include <unistd.h> // read
+#include <sys/socket.h> // shutdown
+
+using namespace reactor;
+
+const size_t Relay::DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+namespace {
+
+bool
+transient()
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+} // namespace
+
+Relay::Direction::Direction(Relay &relay, const util::Fd &from, const util::Fd &to)
+: relay_(relay)
+, from_(from)
+, to_(to)
+, pipe_(O_NONBLOCK | O_CLOEXEC)
+, buffered_(0)
+, transferred_(0)
+, reading_(false)
+, writing_(false)
+, eof_(false)
+, finished_(false)
+{}
+
+void
+Relay::Direction::start()
+{
+	buffered_ = 0;
+	transferred_ = 0;
+	eof_ = false;
+	finished_ = false;
+	watchReadable(true);
+}
+
+void
+Relay::Direction::stop()
+{
+	watchReadable(false);
+	watchWritable(false);
+}
+
+void
+Relay::Direction::watchReadable(bool on)
+{
+	if (on == reading_) {
+		return;
+	}
+
+	FdEvent event(from_, FdEvent::READ);
+
+	if (on) {
+		relay_.dispatcher_.add(event, util::commandForMethod(*this, &Direction::onReadable));
+	} else {
+		relay_.dispatcher_.remove(event);
+	}
+	reading_ = on;
+}
+
+void
+Relay::Direction::watchWritable(bool on)
+{
+	if (on == writing_) {
+		return;
+	}
+
+	FdEvent event(to_, FdEvent::WRITE);
+
+	if (on) {
+		relay_.dispatcher_.add(event, util::commandForMethod(*this, &Direction::onWritable));
+	} else {
+		relay_.dispatcher_.remove(event);
+	}
+	writing_ = on;
+}
+
+bool
+Relay::Direction::drain()
+{
+	while (buffered_) {
+		ssize_t ret = splice(pipe_.readFd().get(), 0, to_.get(), 0, buffered_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+		if (ret < 0) {
+			if (transient()) {
+				break;
+			} else if (errno == EPIPE) {
+				reset();
+			} else {
+				relay_.fail();
+			}
+			return false;
+		}
+		buffered_ -= ret;
+		transferred_ += ret;
+	}
+	return true;
+}
+
+void
+Relay::Direction::discard()
+{
+	char buf[4096];
+
+	while (buffered_) {
+		ssize_t ret = read(pipe_.readFd().get(), buf, std::min(buffered_, sizeof(buf)));
+
+		if (ret <= 0) {
+			break;
+		}
+		buffered_ -= ret;
+	}
+	buffered_ = 0;
+}
+
+void
+Relay::Direction::finish()
+{
+	if (finished_) {
+		return;
+	}
+	finished_ = true;
+	stop();
+	::shutdown(to_.get(), SHUT_WR);
+	relay_.halfClosed();
+}
+
+// the receiving side is gone, what it did not take is dropped and the
+// sending side sees its reads shut down
+void
+Relay::Direction::reset()
+{
+	discard();
+	eof_ = true;
+	::shutdown(from_.get(), SHUT_RD);
+	finish();
+}
+
+void
+Relay::Direction::onReadable(const FdEvent &)
+{
+	util::SigPipeGuard guard;
+	ssize_t ret = splice(from_.get(), 0, pipe_.writeFd().get(), 0, relay_.chunkSize_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+	if (ret < 0) {
+		if (!transient()) {
+			relay_.fail();
+		}
+		return;
+	} else if (!ret) {
+		eof_ = true;
+	}
+
+	buffered_ += ret;
+	if (!drain()) {
+		return;
+	}
+
+	if (buffered_) {
+		// the peer is not keeping up, stop reading until the pipe drains
+		watchReadable(false);
+		watchWritable(true);
+	} else if (eof_) {
+		finish();
+	}
+}
+
+void
+Relay::Direction::onWritable(const FdEvent &)
+{
+	util::SigPipeGuard guard;
+
+	if (!drain() || buffered_) {
+		return;
+	}
+
+	watchWritable(false);
+	if (eof_) {
+		finish();
+	} else {
+		watchReadable(true);
+	}
+}
+
+Relay::Relay(Dispatcher &dispatcher, const util::Fd &first, const util::Fd &second)
+: dispatcher_(dispatcher)
+, first_(first.get())
+, second_(second.get())
+, forward_(new Direction(*this, first_, second_))
+, backward_(new Direction(*this, second_, first_))
+, chunkSize_(DEFAULT_CHUNK_SIZE)
+{}
+
+Relay::~Relay()
+{
+	shutdown();
+}
+
+void
+Relay::start()
+{
+	first_.blocking(false);
+	second_.blocking(false);
+	forward_->start();
+	backward_->start();
+}
+
+void
+Relay::close()
+{
+	shutdown();
+}
+
+void
+Relay::shutdown()
+{
+	if (!open()) {
+		return;
+	}
+
+	forward_->stop();
+	backward_->stop();
+	first_.reset();
+	second_.reset();
+}
+
+void
+Relay::halfClosed()
+{
+	// a failure may have closed the relay earlier in the same iteration
+	if (!open() || !forward_->done() || !backward_->done()) {
+		return;
+	}
+
+	shutdown();
+	if (closeCommand_) {
+		closeCommand_->execute(*this);
+	}
+}
+
+void
+Relay::fail()
+{
+	// both sides may fail in one iteration, the close command runs once
+	if (!open()) {
+		return;
+	}
+	shutdown();
+	if (closeCommand_) {
+		closeCommand_->execute(*this);
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef REACTOR_REACTOR_RELAY_HEADER
+#define REACTOR_REACTOR_RELAY_HEADER
+
+#include <reactor/Dispatcher.hh>
+
+#include <util/AutoFd.hh>
+#include <util/Noncopyable.hh>
+#include <util/Pipe.hh>
+
+#include <memory> // unique_ptr
+
+namespace reactor {
+
+class Relay : public util::Noncopyable {
+public:
+	typedef util::Command1<void, Relay &> Command;
+
+	static const size_t DEFAULT_CHUNK_SIZE;
+
+private:
+	class Direction : public util::Noncopyable {
+		Relay &relay_;
+		const util::Fd &from_;
+		const util::Fd &to_;
+		util::Pipe pipe_;
+		size_t buffered_;
+		size_t transferred_;
+		bool reading_;
+		bool writing_;
+		bool eof_;
+		bool finished_;
+
+		void watchReadable(bool on);
+		void watchWritable(bool on);
+		bool drain();
+		void discard();
+		void finish();
+		void reset();
+
+		void onReadable(const FdEvent &event);
+		void onWritable(const FdEvent &event);
+
+	public:
+		Direction(Relay &relay, const util::Fd &from, const util::Fd &to);
+
+		void start();
+		void stop();
+
+		size_t transferred() const { return transferred_; }
+		bool done() const { return eof_ && !buffered_; }
+	};
+
+	Dispatcher &dispatcher_;
+	util::AutoFd first_;
+	util::AutoFd second_;
+	std::unique_ptr<Direction> forward_;
+	std::unique_ptr<Direction> backward_;
+	std::unique_ptr<Command> closeCommand_;
+	size_t chunkSize_;
+
+	void halfClosed();
+	void fail();
+	void shutdown();
+
+public:
+	// takes ownership of both descriptors
+	Relay(Dispatcher &dispatcher, const util::Fd &first, const util::Fd &second);
+	~Relay();
+
+	void setCloseCommand(const Command &command) { closeCommand_.reset(command.clone()); }
+	void setChunkSize(size_t chunkSize) { chunkSize_ = chunkSize; }
+
+	void start();
+	void close();
+
+	bool open() const { return first_.valid(); }
+	size_t forwarded() const { return forward_->transferred(); }
+	size_t returned() const { return backward_->transferred(); }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_RELAY_HEADER
@@ -0,0 +1,249 @@
+#include "ShardedAcceptor.hh"
+
+#include "Acceptor.hh"
+#include "Dispatcher.hh"
+#include "Reactor.hh"
+
+#include <util/ErrnoException.hh>
+
+#include <stdexcept>
+#include <thread>
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace reactor;
+
+namespace reactor {
+
+class ShardedAcceptor::Shard : public util::Noncopyable {
+	class ShardDispatcher : public Dispatcher {};
+
+	ShardedAcceptor &owner_;
+	size_t index_;
+	int cpu_;
+	net::Host host_;
+	net::Service serv_;
+	ShardDispatcher dispatcher_;
+	Reactor reactor_;
+	int fd_;
+	std::thread thread_;
+
+	void pin();
+	void run();
+
+public:
+	Shard(ShardedAcceptor &owner, size_t index, const net::Host &host, const net::Service &serv)
+	: owner_(owner)
+	, index_(index)
+	, cpu_(owner.cpu(index))
+	, host_(host)
+	, serv_(serv)
+	, reactor_(dispatcher_)
+	, fd_(util::Fd::INVALID)
+	{}
+
+	void start() { thread_ = std::thread(&Shard::run, this); }
+	void stop();
+
+	int fd() const { return fd_; }
+};
+
+} // namespace reactor
+
+void
+ShardedAcceptor::Shard::pin()
+{
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu_, &cpus);
+	int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (ret) {
+		throw util::ErrnoException("pthread_setaffinity_np", ret);
+	}
+}
+
+void
+ShardedAcceptor::Shard::run()
+{
+	std::unique_lock<std::mutex> lock(owner_.mutex_);
+
+	try {
+		if (owner_.cpuAffinity_) {
+			pin();
+		}
+
+		Acceptor acceptor(dispatcher_, *owner_.command_);
+
+		acceptor.setReusePort(true);
+		acceptor.setBacklog(owner_.backlog_);
+		acceptor.setBatchSize(owner_.batchSize_);
+		if (owner_.deferAccept_) {
+			acceptor.setDeferAccept(owner_.deferAccept_);
+		}
+		if (owner_.cpuAffinity_) {
+			acceptor.setIncomingCpu(cpu_);
+		}
+
+		// the reuseport group indexes sockets in the order they start listening
+		while (owner_.listeningCount_ != index_ && !owner_.error_) {
+			owner_.listening_.wait(lock);
+		}
+		if (owner_.error_) {
+			return;
+		}
+		acceptor.listen(host_, serv_);
+		fd_ = acceptor.fd().get();
+		++owner_.listeningCount_;
+		owner_.listening_.notify_all();
+		lock.unlock();
+
+		reactor_.loop();
+	} catch (...) {
+		if (!lock.owns_lock()) {
+			lock.lock();
+		}
+		// the listening socket closes with the acceptor, the group goes on without it
+		if (!owner_.error_) {
+			owner_.error_ = std::current_exception();
+		}
+		++owner_.failedCount_;
+		owner_.listening_.notify_all();
+	}
+}
+
+void
+ShardedAcceptor::Shard::stop()
+{
+	if (thread_.joinable()) {
+		reactor_.quit();
+		thread_.join();
+	}
+}
+
+ShardedAcceptor::ShardedAcceptor(const AcceptCommand &command, size_t shardCount)
+: command_(command.clone())
+, cpus_(allowedCpus())
+, shardCount_(shardCount ? shardCount : cpus_.size())
+, cpuAffinity_(false)
+, steering_(false)
+, backlog_(Acceptor::DEFAULT_BACKLOG)
+, batchSize_(Acceptor::DEFAULT_BATCH_SIZE)
+, deferAccept_(0)
+, listeningCount_(0)
+, failedCount_(0)
+{}
+
+ShardedAcceptor::~ShardedAcceptor()
+{
+	stop();
+}
+
+std::vector<int>
+ShardedAcceptor::allowedCpus()
+{
+	cpu_set_t set;
+	std::vector<int> result;
+
+	if (sched_getaffinity(0, sizeof(set), &set)) {
+		throw util::ErrnoException("sched_getaffinity");
+	}
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (CPU_ISSET(cpu, &set)) {
+			result.push_back(cpu);
+		}
+	}
+	return result;
+}
+
+void
+ShardedAcceptor::attachSteeringProgram(int fd)
+const
+{
+	std::vector<struct sock_filter> code;
+	struct sock_fprog prog;
+
+	// the receiving CPU picks the first shard pinned to it, any other CPU falls back to cpu % shards
+	code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU)));
+	for (size_t i = 0; i < shardCount_ && i < cpus_.size(); ++i) {
+		code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)cpus_[i], 0, 1));
+		code.push_back(BPF_STMT(BPF_RET | BPF_K, (uint32_t)i));
+	}
+	code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t)shardCount_));
+	code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+
+	prog.len = code.size();
+	prog.filter = &code[0];
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog))) {
+		throw util::ErrnoException("setsockopt");
+	}
+}
+
+void
+ShardedAcceptor::start(const net::Host &host, const net::Service &serv)
+{
+	if (!shards_.empty()) {
+		throw std::runtime_error("sharded acceptor is already started");
+	} else if (steering_ && !cpuAffinity_) {
+		throw std::invalid_argument("steering needs CPU affinity");
+	}
+
+	listeningCount_ = 0;
+	failedCount_ = 0;
+	error_ = std::exception_ptr();
+	for (size_t i = 0; i < shardCount_; ++i) {
+		shards_.push_back(new Shard(*this, i, host, serv));
+		shards_.back()->start();
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+
+		while (listeningCount_ != shardCount_ && !error_) {
+			listening_.wait(lock);
+		}
+	}
+
+	try {
+		if (error_) {
+			std::rethrow_exception(error_);
+		}
+		if (steering_) {
+			attachSteeringProgram(shards_.front()->fd());
+		}
+	} catch (...) {
+		stop();
+		throw;
+	}
+}
+
+std::exception_ptr
+ShardedAcceptor::error()
+const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return error_;
+}
+
+size_t
+ShardedAcceptor::failed()
+const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	return failedCount_;
+}
+
+void
+ShardedAcceptor::stop()
+{
+	for (Shards::iterator i(shards_.begin()); i != shards_.end(); ++i) {
+		(*i)->stop();
+		delete *i;
+	}
+	shards_.clear();
+}
@@ -0,0 +1,76 @@
+#ifndef REACTOR_REACTOR_SHARDEDACCEPTOR_HEADER
+#define REACTOR_REACTOR_SHARDEDACCEPTOR_HEADER
+
+#include <reactor/AcceptCommand.hh>
+
+#include <net/Host.hh>
+#include <net/Service.hh>
+#include <util/Noncopyable.hh>
+
+#include <condition_variable>
+#include <exception>
+#include <memory> // unique_ptr
+#include <mutex>
+#include <vector>
+
+namespace reactor {
+
+// Each shard runs its own Dispatcher on its own thread, the accept command
+// runs there and reaches that dispatcher through Dispatcher::current().
+// With affinity on, shard i is pinned to the i-th CPU the process may run
+// on, wrapping around when there are more shards than CPUs. Steering hands
+// a connection to the shard pinned to the CPU that received it, so it
+// needs affinity. A shard whose loop throws after start() stops on its
+// own and leaves the others running; error() reports it.
+class ShardedAcceptor : public util::Noncopyable {
+	class Shard;
+	typedef std::vector<Shard *> Shards;
+
+	std::unique_ptr<AcceptCommand> command_;
+	std::vector<int> cpus_;
+	size_t shardCount_;
+	bool cpuAffinity_;
+	bool steering_;
+	int backlog_;
+	size_t batchSize_;
+	int deferAccept_;
+	Shards shards_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable listening_;
+	size_t listeningCount_;
+	size_t failedCount_;
+	std::exception_ptr error_;
+
+	void attachSteeringProgram(int fd) const;
+
+	friend class Shard;
+
+public:
+	ShardedAcceptor(const AcceptCommand &command, size_t shardCount = 0);
+	~ShardedAcceptor();
+
+	void setCpuAffinity(bool on) { cpuAffinity_ = on; }
+	void setSteering(bool on) { steering_ = on; }
+	void setBacklog(int backlog) { backlog_ = backlog; }
+	void setBatchSize(size_t batchSize) { batchSize_ = batchSize; }
+	void setDeferAccept(int seconds) { deferAccept_ = seconds; }
+
+	void start(const net::Host &host, const net::Service &serv);
+	void stop();
+
+	// the first failure of a shard since start(), null while all shards run
+	std::exception_ptr error() const;
+	size_t failed() const;
+
+	size_t shardCount() const { return shardCount_; }
+	// the CPU shard index is pinned to with affinity on
+	int cpu(size_t index) const { return cpus_[index % cpus_.size()]; }
+
+	// the CPUs in the calling thread's affinity mask
+	static std::vector<int> allowedCpus();
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_SHARDEDACCEPTOR_HEADER
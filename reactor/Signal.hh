@@ -0,0 +1,19 @@
+#ifndef REACTOR_REACTOR_SIGNAL_HEADER
+#define REACTOR_REACTOR_SIGNAL_HEADER
+
+namespace reactor {
+
+class Signal {
+	int number_;
+
+public:
+	explicit Signal(int number) : number_(number) {}
+
+	bool operator<(const Signal &rhs) const { return number_ < rhs.number_; }
+
+	int number() const { return number_; }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_SIGNAL_HEADER
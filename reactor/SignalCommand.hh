@@ -0,0 +1,14 @@
+#ifndef REACTOR_REACTOR_SIGNALCOMMAND_HEADER
+#define REACTOR_REACTOR_SIGNALCOMMAND_HEADER
+
+#include <reactor/SignalEvent.hh>
+
+#include <util/Command.hh>
+
+namespace reactor {
+
+typedef util::Command1<void, const SignalEvent &> SignalCommand;
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_SIGNALCOMMAND_HEADER
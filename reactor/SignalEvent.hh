@@ -0,0 +1,29 @@
+#ifndef REACTOR_REACTOR_SIGNALEVENT_HEADER
+#define REACTOR_REACTOR_SIGNALEVENT_HEADER
+
+#include <reactor/Signal.hh>
+
+#include <sys/signalfd.h>
+#include <sys/types.h>
+
+namespace reactor {
+
+struct SignalEvent {
+	Signal signal;
+	int code;
+	pid_t pid; // the sender, or the child for SIGCHLD
+	uid_t uid;
+	int status; // exit status or signal of the child for SIGCHLD
+
+	explicit SignalEvent(const struct signalfd_siginfo &info)
+	: signal(info.ssi_signo)
+	, code(info.ssi_code)
+	, pid(info.ssi_pid)
+	, uid(info.ssi_uid)
+	, status(info.ssi_status)
+	{}
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_SIGNALEVENT_HEADER
@@ -0,0 +1,175 @@
+#include "Signals.hh"
+
+#include <util/ErrnoException.hh>
+
+#include <stdexcept>
+#include <pthread.h> // pthread_sigmask()
+
+using namespace reactor;
+
+namespace {
+
+// records read per system call, standard signals coalesce so this is rarely exceeded
+const size_t BATCH_SIZE = 16;
+
+// refers to the signal's command, which the arena keeps alive until the job is gone
+class SignalJob : public Backlog::Job {
+	const Signals &signals_;
+	const SignalCommand &command_;
+	SignalEvent event_;
+
+public:
+	SignalJob(const Signals &signals, const SignalCommand &command, const SignalEvent &event)
+	: signals_(signals)
+	, command_(command)
+	, event_(event)
+	{}
+
+	virtual SignalJob *clone() const { return new SignalJob(*this); }
+	virtual SignalJob *clone(util::Arena &arena) const { return arena.make<SignalJob>(*this); }
+
+	virtual void
+	execute()
+	const
+	{
+		// an earlier job of the iteration may have removed the signal
+		if (signals_.live(event_.signal.number(), &command_)) {
+			command_.execute(event_);
+		}
+	}
+};
+
+void
+setMask(int how, int number)
+{
+	sigset_t set;
+	int ret;
+
+	sigemptyset(&set);
+	sigaddset(&set, number);
+	if ((ret = pthread_sigmask(how, &set, 0))) {
+		throw util::ErrnoException("pthread_sigmask", ret);
+	}
+}
+
+} // namespace
+
+Signals::Signals(Backlog &backlog)
+: backlog_(backlog)
+, commands_(NSIG)
+, records_(BATCH_SIZE)
+{
+	sigemptyset(&mask_);
+	sigemptyset(&blocked_);
+}
+
+Signals::~Signals()
+{
+	for (Commands::const_iterator i(commands_.begin()); i != commands_.end(); ++i) {
+		delete *i;
+	}
+	pthread_sigmask(SIG_UNBLOCK, &blocked_, 0);
+}
+
+void
+Signals::update()
+{
+	int fd = signalfd(fd_.valid() ? fd_.get() : -1, &mask_, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	if (fd < 0) {
+		throw util::ErrnoException("signalfd");
+	}
+	if (!fd_.valid()) {
+		fd_.reset(fd);
+	}
+}
+
+void
+Signals::add(const Signal &signal, const SignalCommand &command)
+{
+	int number = signal.number();
+
+	if (number <= 0 || number >= NSIG || number == SIGKILL || number == SIGSTOP) {
+		throw std::invalid_argument("signal cannot be handled");
+	} else if (commands_[number]) {
+		throw std::runtime_error("signal is already registered");
+	}
+
+	sigset_t current;
+
+	pthread_sigmask(SIG_BLOCK, 0, &current);
+	if (!sigismember(&current, number)) {
+		setMask(SIG_BLOCK, number);
+		sigaddset(&blocked_, number);
+	}
+	sigaddset(&mask_, number);
+	try {
+		update();
+	} catch (...) {
+		sigdelset(&mask_, number);
+		if (sigismember(&blocked_, number)) {
+			setMask(SIG_UNBLOCK, number);
+			sigdelset(&blocked_, number);
+		}
+		throw;
+	}
+	commands_[number] = command.clone();
+}
+
+void
+Signals::remove(const Signal &signal)
+{
+	int number = signal.number();
+
+	if (number <= 0 || number >= NSIG || !commands_[number]) {
+		throw std::runtime_error("signal is not registered");
+	}
+
+	// a harvested job may still refer to it
+	backlog_.arena().adopt(commands_[number]);
+	commands_[number] = 0;
+	sigdelset(&mask_, number);
+	update();
+	if (sigismember(&blocked_, number)) {
+		setMask(SIG_UNBLOCK, number);
+		sigdelset(&blocked_, number);
+	}
+}
+
+void
+Signals::harvest()
+{
+	size_t size = records_.size() * sizeof(records_[0]);
+
+	for (;;) {
+		util::IoResult result(fd_.tryRead(&records_[0], size));
+
+		if (result.interrupted()) {
+			continue;
+		} else if (result.wouldBlock()) {
+			return;
+		}
+		result.check("read");
+
+		size_t count = result.bytes() / sizeof(records_[0]);
+
+		for (size_t i = 0; i < count; ++i) {
+			SignalCommand *command = commands_[records_[i].ssi_signo];
+
+			// signals are not refused or shed, a lost SIGCHLD would never come back
+			if (command) {
+				backlog_.enqueueClone(SignalJob(*this, *command, SignalEvent(records_[i])), Backlog::HIGH);
+			}
+		}
+		if (result.bytes() < size) {
+			return;
+		}
+	}
+}
+
+bool
+Signals::empty()
+const
+{
+	return sigisemptyset(&mask_);
+}
@@ -0,0 +1,48 @@
+#ifndef REACTOR_REACTOR_SIGNALS_HEADER
+#define REACTOR_REACTOR_SIGNALS_HEADER
+
+#include <reactor/SignalCommand.hh>
+#include <reactor/Backlog.hh>
+
+#include <util/AutoFd.hh>
+#include <util/Noncopyable.hh>
+
+#include <vector>
+#include <signal.h>
+
+namespace reactor {
+
+// Delivers signals through a signalfd. Registered signals are blocked in
+// the calling thread, so block them before other threads are started or
+// those threads may still take them the old way.
+class Signals : public util::Noncopyable {
+	typedef std::vector<SignalCommand *> Commands;
+
+	Backlog &backlog_;
+	util::AutoFd fd_;
+	sigset_t mask_;
+	// registered signals that were not blocked before, unblocked again on removal
+	sigset_t blocked_;
+	Commands commands_;
+	std::vector<struct signalfd_siginfo> records_;
+
+	void update();
+
+public:
+	explicit Signals(Backlog &backlog);
+	~Signals();
+
+	void add(const Signal &signal, const SignalCommand &command);
+	void remove(const Signal &signal);
+	// reads every pending record and queues a job for each
+	void harvest();
+	// false once the signal's command was removed, for jobs harvested before that
+	bool live(int number, const SignalCommand *command) const { return commands_[number] == command; }
+
+	bool empty() const;
+	const util::Fd &fd() const { return fd_; }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_SIGNALS_HEADER
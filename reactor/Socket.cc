@@ -1,5 +1,7 @@
 #include "Socket.hh"
 
+#include <util/ErrnoException.hh>
+
 #include <stdexcept>
 #include <netdb.h>
 #include <cstring> // memset()
@@ -9,6 +11,123 @@ using namespace reactor;
 const int Socket::ANY = 0;
 const int Socket::STREAM = SOCK_STREAM;
 const int Socket::DGRAM = SOCK_DGRAM;
+const int Socket::SEQPACKET = SOCK_SEQPACKET;
+
+void
+Socket::applyOption(const SocketOptions::Setting &setting)
+const
+{
+	if (setsockopt(fd_.get(), setting.level, setting.name, &setting.value, sizeof(setting.value))) {
+		throw util::ErrnoException("setsockopt");
+	}
+}
+
+void
+Socket::applyDevice()
+const
+{
+	const std::string &device = options_.device();
+
+	if (setsockopt(fd_.get(), SOL_SOCKET, SO_BINDTODEVICE, device.data(), device.size())) {
+		throw util::ErrnoException("setsockopt");
+	}
+}
+
+void
+Socket::applyOptions()
+const
+{
+	const SocketOptions::Settings &settings = options_.settings();
+
+	for (SocketOptions::Settings::const_iterator i(settings.begin()); i != settings.end(); ++i) {
+		applyOption(*i);
+	}
+	if (!options_.device().empty()) {
+		applyDevice();
+	}
+}
+
+void
+Socket::setOption(int level, int name, int value)
+{
+	if (fd_.valid()) {
+		applyOption(SocketOptions::Setting(level, name, value));
+	}
+	options_.set(level, name, value);
+}
+
+void
+Socket::setOptions(const SocketOptions &options)
+{
+	const SocketOptions::Settings &settings = options.settings();
+
+	for (SocketOptions::Settings::const_iterator i(settings.begin()); i != settings.end(); ++i) {
+		setOption(i->level, i->name, i->value);
+	}
+	if (!options.device().empty()) {
+		setDevice(options.device());
+	}
+}
+
+// an empty name removes the binding
+void
+Socket::setDevice(const std::string &device)
+{
+	std::string previous(options_.device());
+
+	options_.bindToDevice(device);
+	if (fd_.valid()) {
+		try {
+			applyDevice();
+		} catch (...) {
+			options_.bindToDevice(previous);
+			throw;
+		}
+	}
+}
+
+size_t
+Socket::send(const void *buffer, size_t length, int flags)
+const
+{
+	return trySend(buffer, length, flags).check("send");
+}
+
+size_t
+Socket::send(const struct iovec *iov, size_t count, int flags)
+const
+{
+	return trySend(iov, count, flags).check("sendmsg");
+}
+
+util::IoResult
+Socket::trySend(const void *buffer, size_t length, int flags)
+const
+{
+	return util::IoResult::fromReturn(::send(fd_.get(), buffer, length, flags));
+}
+
+util::IoResult
+Socket::trySend(const struct iovec *iov, size_t count, int flags)
+const
+{
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<struct iovec *>(iov);
+	msg.msg_iovlen = count;
+
+	return util::IoResult::fromReturn(::sendmsg(fd_.get(), &msg, flags));
+}
+
+void
+Socket::adopt(const util::Fd &fd)
+{
+	fd_.reset(fd.get());
+	if (fd_.valid()) {
+		applyOptions();
+	}
+}
 
 void
 Socket::connect(const net::Host &targetHost, const net::Service &targetServ)
@@ -30,10 +149,17 @@ Socket::connect(const net::Host &targetHost, const net::Service &targetServ)
 		fd_.reset(socket(p->ai_family, p->ai_socktype, p->ai_protocol));
 		if (!fd_.valid()) continue;
 
+		try {
+			applyOptions();
+		} catch (...) {
+			freeaddrinfo(res);
+			throw;
+		}
+
 		ret = ::connect(fd_.get(), p->ai_addr, p->ai_addrlen);
 		if (ret != -1) break;
 
-		fd_.release();
+		fd_.reset();
 	}
 
 	freeaddrinfo(res);
@@ -42,3 +168,114 @@ Socket::connect(const net::Host &targetHost, const net::Service &targetServ)
 		throw std::runtime_error("failed to connect");
 	}
 }
+
+void
+Socket::connect(const net::Address &address)
+{
+	fd_.reset(socket(address.family(), type_ | SOCK_CLOEXEC, 0));
+	if (!fd_.valid()) {
+		throw util::ErrnoException("socket");
+	}
+
+	applyOptions();
+	if (::connect(fd_.get(), address.get(), address.length())) {
+		util::ErrnoException e("connect");
+
+		fd_.reset();
+		throw e;
+	}
+}
+
+void
+Socket::bind(const net::Address &address)
+{
+	fd_.reset(socket(address.family(), type_ | SOCK_CLOEXEC, 0));
+	if (!fd_.valid()) {
+		throw util::ErrnoException("socket");
+	}
+
+	applyOptions();
+	if (::bind(fd_.get(), address.get(), address.length())) {
+		util::ErrnoException e("bind");
+
+		fd_.reset();
+		throw e;
+	}
+}
+
+void
+Socket::pair(Socket &first, Socket &second)
+{
+	int fds[2];
+
+	if (first.type_ != second.type_) {
+		throw std::invalid_argument("socket types differ");
+	}
+	if (socketpair(AF_UNIX, first.type_ | SOCK_CLOEXEC, 0, fds)) {
+		throw util::ErrnoException("socketpair");
+	}
+	first.adopt(util::Fd(fds[0]));
+	second.adopt(util::Fd(fds[1]));
+}
+
+void
+Socket::bind(const net::Host &host, const net::Service &serv)
+{
+	int ret;
+	struct addrinfo hints, *res;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = type_;
+	hints.ai_flags = AI_PASSIVE | host.aiFlags() | serv.aiFlags();
+
+	ret = getaddrinfo(host.spec().empty() ? 0 : host.spec().c_str(), serv.spec().c_str(), &hints, &res);
+	if (ret) {
+		throw std::runtime_error(gai_strerror(ret));
+	}
+
+	for (struct addrinfo *p = res; p; p = p->ai_next) {
+		fd_.reset(socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol));
+		if (!fd_.valid()) continue;
+
+		try {
+			applyOptions();
+		} catch (...) {
+			freeaddrinfo(res);
+			throw;
+		}
+
+		ret = ::bind(fd_.get(), p->ai_addr, p->ai_addrlen);
+		if (ret != -1) break;
+
+		fd_.reset();
+	}
+
+	freeaddrinfo(res);
+
+	if (!fd_.valid()) {
+		throw std::runtime_error("failed to bind");
+	}
+}
+
+void
+Socket::listen(int backlog)
+{
+	if (::listen(fd_.get(), backlog)) {
+		throw util::ErrnoException("listen");
+	}
+}
+
+net::Address
+Socket::localAddress()
+const
+{
+	net::Address result;
+	socklen_t length = net::Address::capacity();
+
+	if (getsockname(fd_.get(), result.get(), &length)) {
+		throw util::ErrnoException("getsockname");
+	}
+	result.setLength(length);
+	return result;
+}
@@ -1,25 +1,63 @@
 #ifndef REACTOR_REACTOR_SOCKET_HEADER
 #define REACTOR_REACTOR_SOCKET_HEADER
 
+#include <net/Address.hh>
 #include <net/Host.hh>
 #include <net/Service.hh>
+#include <reactor/SocketOptions.hh>
 #include <util/AutoFd.hh>
+#include <util/IoResult.hh>
 #include <util/Noncopyable.hh>
 
+#include <string>
+
+struct iovec;
+
 namespace reactor {
 
 class Socket : public util::Noncopyable {
 	util::AutoFd fd_;
 	int type_;
+	// everything set so far, applied again to each socket created
+	SocketOptions options_;
+
+	void applyOption(const SocketOptions::Setting &setting) const;
+	void applyDevice() const;
+	void applyOptions() const;
 
 public:
 	static const int ANY;
 	static const int STREAM;
 	static const int DGRAM;
+	static const int SEQPACKET;
 
 	Socket(int type) : type_(type) {}
 
+	void setOption(int level, int name, int value);
+	void setOptions(const SocketOptions &options);
+	void setDevice(const std::string &device);
+	const SocketOptions &options() const { return options_; }
+
 	void connect(const net::Host &targetHost, const net::Service &targetServ);
+	void connect(const net::Address &address);
+	void bind(const net::Host &host, const net::Service &serv);
+	void bind(const net::Address &address);
+	void listen(int backlog);
+
+	size_t send(const void *buffer, size_t length, int flags) const;
+	size_t send(const struct iovec *iov, size_t count, int flags) const;
+	util::IoResult trySend(const void *buffer, size_t length, int flags) const;
+	util::IoResult trySend(const struct iovec *iov, size_t count, int flags) const;
+
+	void adopt(const util::Fd &fd);
+	void close() { fd_.reset(); }
+	int release() { return fd_.release(); }
+
+	net::Address localAddress() const;
+
+	static void pair(Socket &first, Socket &second);
+
+	void blocking(bool block) { fd_.blocking(block); }
 	const util::Fd &fd() const { return fd_; }
 };
 
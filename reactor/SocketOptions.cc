@@ -0,0 +1,103 @@
+#include "SocketOptions.hh"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+using namespace reactor;
+
+namespace {
+
+const int LATENCY_NOTSENT_LOWAT = 16 * 1024;
+
+} // namespace
+
+SocketOptions &
+SocketOptions::set(int level, int name, int value)
+{
+	for (Settings::iterator i(settings_.begin()); i != settings_.end(); ++i) {
+		if (i->level == level && i->name == name) {
+			i->value = value;
+			return *this;
+		}
+	}
+	settings_.push_back(Setting(level, name, value));
+	return *this;
+}
+
+SocketOptions &
+SocketOptions::noDelay(bool on)
+{
+	return set(IPPROTO_TCP, TCP_NODELAY, on);
+}
+
+// the kernel may drop back to delayed acks on its own, set it again after reads when it matters
+SocketOptions &
+SocketOptions::quickAck(bool on)
+{
+	return set(IPPROTO_TCP, TCP_QUICKACK, on);
+}
+
+SocketOptions &
+SocketOptions::notSentLowat(int bytes)
+{
+	return set(IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes);
+}
+
+SocketOptions &
+SocketOptions::receiveLowat(int bytes)
+{
+	return set(SOL_SOCKET, SO_RCVLOWAT, bytes);
+}
+
+SocketOptions &
+SocketOptions::receiveBuffer(int bytes)
+{
+	return set(SOL_SOCKET, SO_RCVBUF, bytes);
+}
+
+SocketOptions &
+SocketOptions::sendBuffer(int bytes)
+{
+	return set(SOL_SOCKET, SO_SNDBUF, bytes);
+}
+
+// raising it above net.core.busy_poll requires CAP_NET_ADMIN
+SocketOptions &
+SocketOptions::busyPoll(int usecs)
+{
+	return set(SOL_SOCKET, SO_BUSY_POLL, usecs);
+}
+
+SocketOptions &
+SocketOptions::reuseAddress(bool on)
+{
+	return set(SOL_SOCKET, SO_REUSEADDR, on);
+}
+
+SocketOptions &
+SocketOptions::bindToDevice(const std::string &device)
+{
+	device_ = device;
+	return *this;
+}
+
+SocketOptions
+SocketOptions::latency()
+{
+	SocketOptions result;
+
+	result.noDelay(true).quickAck(true).notSentLowat(LATENCY_NOTSENT_LOWAT);
+	return result;
+}
+
+SocketOptions
+SocketOptions::throughput(int bufferSize)
+{
+	SocketOptions result;
+
+	if (bufferSize > 0) {
+		result.receiveBuffer(bufferSize).sendBuffer(bufferSize);
+	}
+	return result;
+}
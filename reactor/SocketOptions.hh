@@ -0,0 +1,58 @@
+#ifndef REACTOR_REACTOR_SOCKETOPTIONS_HEADER
+#define REACTOR_REACTOR_SOCKETOPTIONS_HEADER
+
+#include <string>
+#include <vector>
+
+namespace reactor {
+
+// A set of typed socket options, applied with Socket::setOptions(). Options
+// set before the socket exists are applied as soon as it is created.
+class SocketOptions {
+public:
+	struct Setting {
+		int level;
+		int name;
+		int value;
+
+		Setting(int level0, int name0, int value0)
+		: level(level0)
+		, name(name0)
+		, value(value0)
+		{}
+	};
+	typedef std::vector<Setting> Settings;
+
+private:
+	Settings settings_;
+	std::string device_;
+
+public:
+	// any option by number, a later value for the same option replaces the earlier one
+	SocketOptions &set(int level, int name, int value);
+	SocketOptions &noDelay(bool on);
+	SocketOptions &quickAck(bool on);
+	SocketOptions &notSentLowat(int bytes);
+	SocketOptions &receiveLowat(int bytes);
+	SocketOptions &receiveBuffer(int bytes);
+	SocketOptions &sendBuffer(int bytes);
+	SocketOptions &busyPoll(int usecs);
+	SocketOptions &reuseAddress(bool on);
+	SocketOptions &bindToDevice(const std::string &device);
+
+	const Settings &settings() const { return settings_; }
+	const std::string &device() const { return device_; }
+
+	// Small writes go out at once and acks are not delayed; unsent data is
+	// kept short so that fresh messages do not queue behind stale ones.
+	static SocketOptions latency();
+	// Nagle's algorithm and buffer autotuning, both on by default, already
+	// favour full segments. A fixed buffer size turns autotuning off for the
+	// socket and is capped by net.core.rmem_max and wmem_max, so it only pays
+	// where the bandwidth-delay product is known and the limits are raised.
+	static SocketOptions throughput(int bufferSize = 0);
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_SOCKETOPTIONS_HEADER
@@ -0,0 +1,596 @@
+#include "StreamConnection.hh"
+
+#include <util/ErrnoException.hh>
+#include <util/SigPipeGuard.hh>
+
+#include <stdexcept>
+#include <cerrno>
+#include <cstring> // memset(), memcpy()
+#include <linux/errqueue.h>
+#include <netinet/in.h> // IP_RECVERR, IPV6_RECVERR
+#include <sys/sendfile.h>
+#include <sys/socket.h> // MSG_MORE, MSG_ZEROCOPY, MSG_NOSIGNAL
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+using namespace reactor;
+
+const size_t StreamConnection::DEFAULT_READ_SIZE = 64 * 1024;
+const size_t StreamConnection::DEFAULT_ZEROCOPY_THRESHOLD = 32 * 1024;
+
+StreamConnection::StreamConnection(Dispatcher &dispatcher)
+: dispatcher_(dispatcher)
+, readSize_(DEFAULT_READ_SIZE)
+, highWatermark_(0)
+, lowWatermark_(0)
+, zeroCopyThreshold_(DEFAULT_ZEROCOPY_THRESHOLD)
+, zeroCopyCopied_(0)
+, nextCompletionId_(0)
+, socket_(false)
+, reading_(false)
+, writing_(false)
+, watchingErrors_(false)
+, zeroCopy_(false)
+, closing_(false)
+, aboveHighWatermark_(false)
+, corking_(false)
+, flushDeferred_(false)
+{}
+
+StreamConnection::~StreamConnection()
+{
+	shutdown();
+}
+
+void
+StreamConnection::execute(const std::unique_ptr<Command> &command, StreamConnection &connection)
+{
+	if (command) {
+		command->execute(connection);
+	}
+}
+
+void
+StreamConnection::setHighWatermark(size_t bytes, const Command &command)
+{
+	highWatermark_ = bytes;
+	highWatermarkCommand_.reset(command.clone());
+}
+
+void
+StreamConnection::setLowWatermark(size_t bytes, const Command &command)
+{
+	lowWatermark_ = bytes;
+	lowWatermarkCommand_.reset(command.clone());
+}
+
+void
+StreamConnection::setZeroCopy(bool on, size_t threshold)
+{
+	sock_.setOption(SOL_SOCKET, SO_ZEROCOPY, on);
+	zeroCopy_ = on;
+	zeroCopyThreshold_ = threshold;
+}
+
+void
+StreamConnection::adopt(const util::Fd &fd)
+{
+	if (open()) {
+		throw std::runtime_error("connection is already open");
+	}
+	sock_.adopt(fd);
+	start();
+}
+
+void
+StreamConnection::connect(const net::Host &targetHost, const net::Service &targetServ)
+{
+	if (open()) {
+		throw std::runtime_error("connection is already open");
+	}
+	sock_.connect(targetHost, targetServ);
+	start();
+}
+
+void
+StreamConnection::start()
+{
+	struct stat st;
+
+	sock_.blocking(false);
+	socket_ = !fstat(sock_.fd().get(), &st) && S_ISSOCK(st.st_mode);
+	closing_ = false;
+	aboveHighWatermark_ = false;
+	nextCompletionId_ = 0;
+	watchReadable(true);
+}
+
+void
+StreamConnection::watchReadable(bool on)
+{
+	if (on == reading_) {
+		return;
+	}
+
+	FdEvent event(sock_.fd(), FdEvent::READ);
+
+	if (on) {
+		dispatcher_.add(event, util::commandForMethod(*this, &StreamConnection::onReadable));
+	} else {
+		dispatcher_.remove(event);
+	}
+	reading_ = on;
+}
+
+void
+StreamConnection::watchWritable(bool on)
+{
+	if (on == writing_) {
+		return;
+	}
+
+	FdEvent event(sock_.fd(), FdEvent::WRITE);
+
+	if (on) {
+		dispatcher_.add(event, util::commandForMethod(*this, &StreamConnection::onWritable));
+	} else {
+		dispatcher_.remove(event);
+	}
+	writing_ = on;
+}
+
+void
+StreamConnection::watchErrors(bool on)
+{
+	if (on == watchingErrors_) {
+		return;
+	}
+
+	FdEvent event(sock_.fd(), FdEvent::ERROR);
+
+	if (on) {
+		dispatcher_.add(event, util::commandForMethod(*this, &StreamConnection::onError));
+	} else {
+		dispatcher_.remove(event);
+	}
+	watchingErrors_ = on;
+}
+
+void
+StreamConnection::write(const void *data, size_t length, bool more)
+{
+	if (!open() || closing_) {
+		throw std::runtime_error("connection is not open");
+	}
+
+	const char *p = static_cast<const char *>(data);
+
+	if (corked()) {
+		tail().append(p, length);
+		checkHighWatermark();
+		return;
+	}
+
+	bool zeroCopy = zeroCopy_ && length >= zeroCopyThreshold_;
+
+	if (output_.empty() && transfers_.empty() && length && !zeroCopy) {
+		util::IoResult result(socket_ ? sock_.trySend(p, length, MSG_NOSIGNAL | (more ? MSG_MORE : 0)) : sock_.fd().tryWrite(p, length));
+
+		if (!result.ok() && !result.transient()) {
+			finish();
+			return;
+		}
+		p += result.bytes();
+		length -= result.bytes();
+	}
+	tail().append(p, length);
+	if (zeroCopy && !flush()) {
+		return;
+	}
+	queued();
+}
+
+void
+StreamConnection::write(const util::IoBuffer &buffer)
+{
+	if (!open() || closing_) {
+		throw std::runtime_error("connection is not open");
+	}
+
+	tail().append(buffer);
+	if (corked()) {
+		checkHighWatermark();
+	} else if (flush()) {
+		queued();
+	}
+}
+
+void
+StreamConnection::sendFile(const util::Fd &file, off_t offset, size_t length)
+{
+	queueFile(new FileTransfer(file, offset, length, 0));
+}
+
+void
+StreamConnection::sendFile(const util::Fd &file, off_t offset, size_t length, const FileCommand &progress)
+{
+	queueFile(new FileTransfer(file, offset, length, progress.clone()));
+}
+
+void
+StreamConnection::queueFile(FileTransfer *transfer)
+{
+	std::unique_ptr<FileTransfer> guard(transfer);
+
+	if (!open() || closing_) {
+		throw std::runtime_error("connection is not open");
+	}
+
+	transfers_.push_back(guard.release());
+	if (corked()) {
+		checkHighWatermark();
+	} else if (flush()) {
+		queued();
+	}
+}
+
+size_t
+StreamConnection::pendingOutput()
+const
+{
+	size_t result = output_.size();
+
+	for (FileTransfers::const_iterator i(transfers_.begin()); i != transfers_.end(); ++i) {
+		result += (*i)->length - (*i)->sent + (*i)->trailer.size();
+	}
+	return result;
+}
+
+util::IoBuffer &
+StreamConnection::tail()
+{
+	return transfers_.empty() ? output_ : transfers_.back()->trailer;
+}
+
+bool
+StreamConnection::flushFile(FileTransfer &transfer, bool &blocked)
+{
+	ssize_t ret = sendfile(sock_.fd().get(), transfer.file.get(), &transfer.offset, transfer.length - transfer.sent);
+
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+			blocked = errno != EINTR;
+			return true;
+		}
+		finish();
+		return false;
+	} else if (!ret) {
+		// the file is shorter than announced, the stream cannot be continued
+		finish();
+		return false;
+	}
+
+	transfer.sent += ret;
+	if (transfer.progress) {
+		transfer.progress->execute(FileProgress(transfer.file, transfer.sent, transfer.length));
+	}
+	return open();
+}
+
+util::IoResult
+StreamConnection::sendOutput()
+{
+	if (!socket_) {
+		return output_.tryWriteTo(sock_.fd());
+	}
+
+	struct iovec iov[util::IoBuffer::MAX_IOVECS];
+	size_t count = output_.fillIovecs(iov, util::IoBuffer::MAX_IOVECS);
+
+	if (!count) {
+		return util::IoResult::success(0);
+	}
+
+	util::IoResult result(sock_.trySend(iov, count, MSG_NOSIGNAL));
+
+	if (result.ok()) {
+		output_.consume(result.bytes());
+	}
+	return result;
+}
+
+util::IoResult
+StreamConnection::sendZeroCopy()
+{
+	struct iovec iov[util::IoBuffer::MAX_IOVECS];
+	size_t count = output_.fillIovecs(iov, util::IoBuffer::MAX_IOVECS);
+	util::IoResult result(sock_.trySend(iov, count, MSG_ZEROCOPY | MSG_NOSIGNAL));
+
+	if (!result.ok()) {
+		// out of optmem for pinned pages, copy this round
+		return result.error() == ENOBUFS ? sendOutput() : result;
+	}
+
+	completions_.push_back(Completion(nextCompletionId_++, output_.slice(0, result.bytes())));
+	output_.consume(result.bytes());
+	watchErrors(true);
+	return result;
+}
+
+bool
+StreamConnection::reapCompletions()
+{
+	bool reaped = false;
+
+	for (;;) {
+		char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+		struct msghdr msg;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(sock_.fd().get(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+				return reaped;
+			}
+			throw util::ErrnoException("recvmsg");
+		}
+
+		for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+			    !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+				continue;
+			}
+
+			struct sock_extended_err err;
+
+			memcpy(&err, CMSG_DATA(cm), sizeof(err));
+			if (err.ee_errno || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+			if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				++zeroCopyCopied_;
+			}
+			releaseCompletions(err.ee_info, err.ee_data);
+			reaped = true;
+		}
+	}
+}
+
+void
+StreamConnection::releaseCompletions(uint32_t first, uint32_t last)
+{
+	Completions::iterator i(completions_.begin());
+
+	while (i != completions_.end()) {
+		if (i->id - first <= last - first) {
+			i = completions_.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+bool
+StreamConnection::flush()
+{
+	bool blocked = false;
+	// sendfile() takes no MSG_NOSIGNAL, the mask changes once for the whole batch
+	util::SigPipeGuard guard(!transfers_.empty());
+
+	while (!blocked) {
+		if (!output_.empty()) {
+			bool zeroCopy = zeroCopy_ && output_.size() >= zeroCopyThreshold_;
+			util::IoResult result(zeroCopy ? sendZeroCopy() : sendOutput());
+
+			if (result.transient()) {
+				break;
+			} else if (!result.ok()) {
+				finish();
+				return false;
+			}
+		} else if (!transfers_.empty()) {
+			FileTransfer *transfer = transfers_.front();
+
+			if (transfer->sent < transfer->length && !flushFile(*transfer, blocked)) {
+				return false;
+			}
+			if (transfer->sent == transfer->length) {
+				output_.swap(transfer->trailer);
+				transfers_.pop_front();
+				delete transfer;
+			}
+		} else {
+			break;
+		}
+	}
+	return true;
+}
+
+bool
+StreamConnection::corked()
+{
+	if (!corking_ || !dispatcher_.draining()) {
+		return false;
+	}
+
+	if (!flushDeferred_) {
+		dispatcher_.defer(this, util::commandForMethod(*this, &StreamConnection::flushAtIterationEnd));
+		flushDeferred_ = true;
+	}
+	return true;
+}
+
+void
+StreamConnection::flushAtIterationEnd()
+{
+	flushDeferred_ = false;
+	if (flush()) {
+		queued();
+	}
+}
+
+void
+StreamConnection::queued()
+{
+	if (!pendingOutput()) {
+		return;
+	}
+
+	watchWritable(true);
+	checkHighWatermark();
+}
+
+void
+StreamConnection::checkHighWatermark()
+{
+	if (highWatermarkCommand_ && !aboveHighWatermark_ && pendingOutput() >= highWatermark_) {
+		aboveHighWatermark_ = true;
+		highWatermarkCommand_->execute(*this);
+	}
+}
+
+void
+StreamConnection::drained()
+{
+	if (aboveHighWatermark_ && pendingOutput() <= lowWatermark_) {
+		aboveHighWatermark_ = false;
+		execute(lowWatermarkCommand_, *this);
+	}
+}
+
+void
+StreamConnection::close()
+{
+	if (!open()) {
+		return;
+	}
+
+	if (idle()) {
+		finish();
+	} else {
+		watchReadable(false);
+		closing_ = true;
+	}
+}
+
+void
+StreamConnection::pauseReading()
+{
+	if (open()) {
+		watchReadable(false);
+	}
+}
+
+void
+StreamConnection::resumeReading()
+{
+	if (open() && !closing_) {
+		watchReadable(true);
+	}
+}
+
+void
+StreamConnection::shutdown()
+{
+	if (!open()) {
+		return;
+	}
+
+	if (flushDeferred_) {
+		dispatcher_.cancelDeferred(this);
+		flushDeferred_ = false;
+	}
+	watchReadable(false);
+	watchWritable(false);
+	watchErrors(false);
+	sock_.close();
+	completions_.clear();
+	output_.clear();
+	while (!transfers_.empty()) {
+		delete transfers_.front();
+		transfers_.pop_front();
+	}
+	closing_ = false;
+}
+
+void
+StreamConnection::finish()
+{
+	shutdown();
+	execute(closeCommand_, *this);
+}
+
+void
+StreamConnection::onReadable(const FdEvent &event)
+{
+	util::IoResult result(input_.tryReadFrom(event.fd, readSize_));
+
+	if (!result.ok()) {
+		if (!result.transient()) {
+			finish();
+		}
+		return;
+	}
+
+	if (!result.bytes()) {
+		if (idle()) {
+			finish();
+		} else {
+			watchReadable(false);
+			closing_ = true;
+		}
+		return;
+	}
+
+	execute(readCommand_, *this);
+}
+
+void
+StreamConnection::onWritable(const FdEvent &)
+{
+	if (!flush()) {
+		return;
+	}
+
+	if (!pendingOutput()) {
+		watchWritable(false);
+		if (closing_ && completions_.empty()) {
+			finish();
+			return;
+		}
+	}
+	drained();
+}
+
+void
+StreamConnection::onError(const FdEvent &)
+{
+	// finished by an earlier job of this iteration, the fd is gone
+	if (!open()) {
+		return;
+	}
+
+	try {
+		if (!reapCompletions()) {
+			int error = 0;
+			socklen_t length = sizeof(error);
+
+			// not a completion, so a pending socket error raised POLLERR
+			if (getsockopt(sock_.fd().get(), SOL_SOCKET, SO_ERROR, &error, &length) || error) {
+				finish();
+			}
+			return;
+		}
+	} catch (const util::ErrnoException &) {
+		finish();
+		return;
+	}
+
+	if (completions_.empty()) {
+		watchErrors(false);
+		if (closing_ && !pendingOutput()) {
+			finish();
+		}
+	}
+}
@@ -0,0 +1,157 @@
+#ifndef REACTOR_REACTOR_STREAMCONNECTION_HEADER
+#define REACTOR_REACTOR_STREAMCONNECTION_HEADER
+
+#include <reactor/Dispatcher.hh>
+#include <reactor/StreamSock.hh>
+
+#include <net/Host.hh>
+#include <net/Service.hh>
+#include <util/IoBuffer.hh>
+#include <util/Noncopyable.hh>
+
+#include <cstdint>
+#include <deque>
+#include <memory> // unique_ptr
+#include <sys/types.h> // off_t
+
+namespace reactor {
+
+class StreamConnection : public util::Noncopyable {
+public:
+	typedef util::Command1<void, StreamConnection &> Command;
+
+	struct FileProgress {
+		util::Fd file;
+		size_t sent;
+		size_t length;
+
+		FileProgress(const util::Fd &file0, size_t sent0, size_t length0)
+		: file(file0)
+		, sent(sent0)
+		, length(length0)
+		{}
+	};
+	typedef util::Command1<void, const FileProgress &> FileCommand;
+
+	static const size_t DEFAULT_READ_SIZE;
+	static const size_t DEFAULT_ZEROCOPY_THRESHOLD;
+
+private:
+	struct FileTransfer : public util::Noncopyable {
+		util::Fd file;
+		off_t offset;
+		size_t sent;
+		size_t length;
+		std::unique_ptr<FileCommand> progress;
+		util::IoBuffer trailer;
+
+		FileTransfer(const util::Fd &file0, off_t offset0, size_t length0, FileCommand *progress0)
+		: file(file0)
+		, offset(offset0)
+		, sent(0)
+		, length(length0)
+		, progress(progress0)
+		{}
+	};
+	typedef std::deque<FileTransfer *> FileTransfers;
+
+	// data handed to the kernel with MSG_ZEROCOPY, kept until the send is reported done
+	struct Completion {
+		uint32_t id;
+		util::IoBuffer data;
+
+		Completion(uint32_t id0, const util::IoBuffer &data0)
+		: id(id0)
+		, data(data0)
+		{}
+	};
+	typedef std::deque<Completion> Completions;
+
+	Dispatcher &dispatcher_;
+	StreamSock sock_;
+	util::IoBuffer input_;
+	util::IoBuffer output_;
+	FileTransfers transfers_;
+	Completions completions_;
+	std::unique_ptr<Command> readCommand_;
+	std::unique_ptr<Command> closeCommand_;
+	std::unique_ptr<Command> highWatermarkCommand_;
+	std::unique_ptr<Command> lowWatermarkCommand_;
+	size_t readSize_;
+	size_t highWatermark_;
+	size_t lowWatermark_;
+	size_t zeroCopyThreshold_;
+	size_t zeroCopyCopied_;
+	uint32_t nextCompletionId_;
+	// sockets are written with MSG_NOSIGNAL, a pipe (a child's stdin) cannot be
+	bool socket_;
+	bool reading_;
+	bool writing_;
+	bool watchingErrors_;
+	bool zeroCopy_;
+	bool closing_;
+	bool aboveHighWatermark_;
+	bool corking_;
+	bool flushDeferred_;
+
+	void start();
+	void watchReadable(bool on);
+	void watchWritable(bool on);
+	void watchErrors(bool on);
+	util::IoBuffer &tail();
+	void queueFile(FileTransfer *transfer);
+	bool corked();
+	bool flushFile(FileTransfer &transfer, bool &blocked);
+	util::IoResult sendOutput();
+	util::IoResult sendZeroCopy();
+	bool reapCompletions();
+	void releaseCompletions(uint32_t first, uint32_t last);
+	bool flush();
+	bool idle() const { return !pendingOutput() && completions_.empty(); }
+	void flushAtIterationEnd();
+	void queued();
+	void checkHighWatermark();
+	void drained();
+	void shutdown();
+	void finish();
+
+	void onReadable(const FdEvent &event);
+	void onWritable(const FdEvent &event);
+	void onError(const FdEvent &event);
+
+	static void execute(const std::unique_ptr<Command> &command, StreamConnection &connection);
+
+public:
+	explicit StreamConnection(Dispatcher &dispatcher);
+	~StreamConnection();
+
+	void setReadCommand(const Command &command) { readCommand_.reset(command.clone()); }
+	void setCloseCommand(const Command &command) { closeCommand_.reset(command.clone()); }
+	void setHighWatermark(size_t bytes, const Command &command);
+	void setLowWatermark(size_t bytes, const Command &command);
+	void setReadSize(size_t readSize) { readSize_ = readSize; }
+	void setCorking(bool on) { corking_ = on; }
+	void setCork(bool on) { sock_.setCork(on); }
+	void setZeroCopy(bool on, size_t threshold = DEFAULT_ZEROCOPY_THRESHOLD);
+
+	void adopt(const util::Fd &fd);
+	void connect(const net::Host &targetHost, const net::Service &targetServ);
+	void write(const void *data, size_t length, bool more = false);
+	void write(const util::IoBuffer &buffer);
+	void sendFile(const util::Fd &file, off_t offset, size_t length);
+	void sendFile(const util::Fd &file, off_t offset, size_t length, const FileCommand &progress);
+	void close();
+	void pauseReading();
+	void resumeReading();
+
+	util::IoBuffer &input() { return input_; }
+	size_t pendingOutput() const;
+	size_t pendingCompletions() const { return completions_.size(); }
+	size_t zeroCopyCopied() const { return zeroCopyCopied_; }
+	bool open() const { return sock_.fd().valid(); }
+	const util::Fd &fd() const { return sock_.fd(); }
+};
+
+} // namespace reactor
+
+#endif // REACTOR_REACTOR_STREAMCONNECTION_HEADER
@@ -3,11 +3,16 @@
 
 #include <reactor/Socket.hh>
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
 namespace reactor {
 
 class StreamSock : public Socket {
 public:
 	StreamSock() : Socket(STREAM) {}
+
+	void setCork(bool on) { setOption(IPPROTO_TCP, TCP_CORK, on); }
 };
 
 } // namespace reactor
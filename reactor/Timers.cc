@@ -1,10 +1,41 @@
 #include "Timers.hh"
 
-#include <list>
+#include <algorithm> // find
 #include <stdexcept>
 
 using namespace reactor;
 
+namespace {
+
+// refers to the timer's command, which the arena keeps alive until the job is gone
+class TimerJob : public Backlog::Job {
+	const Timers &timers_;
+	const TimerCommand &command_;
+	TimerEvent event_;
+
+public:
+	TimerJob(const Timers &timers, const TimerCommand &command, const TimerEvent &event)
+	: timers_(timers)
+	, command_(command)
+	, event_(event)
+	{}
+
+	virtual TimerJob *clone() const { return new TimerJob(*this); }
+	virtual TimerJob *clone(util::Arena &arena) const { return arena.make<TimerJob>(*this); }
+
+	virtual void
+	execute()
+	const
+	{
+		// an earlier job of the iteration may have removed the timer
+		if (timers_.live(&command_)) {
+			command_.execute(event_);
+		}
+	}
+};
+
+} // namespace
+
 Timers::~Timers()
 {
 	while (!queue_.empty()) {
@@ -14,39 +45,84 @@ Timers::~Timers()
 }
 
 void
-Timers::add(const Timer &timer, const TimerCommand &timerCommand)
+Timers::reserve(size_t timers)
 {
-	queue_.push(TimerAndCommand(timer, timerCommand.clone()));
+	queue_.reserve(timers);
+	reinsertands_.reserve(timers);
+	fired_.reserve(timers);
+	removed_.reserve(timers);
 }
 
 void
-Timers::harvest()
+Timers::add(const Timer &timer, const TimerCommand &timerCommand, const void *owner)
+{
+	queue_.push(TimerAndCommand(timer, timerCommand.clone(), owner));
+}
+
+void
+Timers::remove(const void *owner)
 {
-	typedef std::list<TimerAndCommand> Reinsertands;
-	Reinsertands ri;
+	Queue kept;
 
+	kept.reserve(queue_.size());
+	while (!queue_.empty()) {
+		if (queue_.top().owner == owner) {
+			// a harvested job may still refer to it
+			removed_.push_back(backlog_.arena().adopt(queue_.top().command));
+		} else {
+			kept.push(queue_.top());
+		}
+		queue_.pop();
+	}
+	queue_.swap(kept);
+	for (Reinsertands::const_iterator i(fired_.begin()); i != fired_.end(); ++i) {
+		if (i->owner == owner) {
+			removed_.push_back(i->command);
+		}
+	}
+}
+
+void
+Timers::harvest()
+{
+	// the jobs of the previous iteration have all run
+	reinsertands_.clear();
+	fired_.clear();
+	removed_.clear();
 	while (!queue_.empty()) {
 		TimerAndCommand tac(queue_.top());
-		const util::DiffTime dt(tac.timer.expiration() - nowFunc_());
+		const util::Time now(nowFunc_());
+		const util::DiffTime dt(tac.timer.expiration() - now);
 
 		if (!dt.positive()) {
 			queue_.pop();
-			backlog_.enqueueClone(bindCommand(*tac.command, TimerEvent(tac.timer)));
+			if (metrics_) {
+				metrics_->recordTimer(now - tac.timer.expiration());
+			}
+			backlog_.enqueueClone(TimerJob(*this, *tac.command, TimerEvent(tac.timer)), Backlog::HIGH);
 			tac.timer.fire();
 			if (tac.timer.hasRemainingIterations()) {
-				ri.push_back(tac);
+				reinsertands_.push_back(tac);
 			} else {
-				delete tac.command;
+				backlog_.arena().adopt(tac.command);
+				fired_.push_back(tac);
 			}
 		} else {
 			break;
 		}
 	}
-	for (Reinsertands::const_iterator i(ri.begin()); i != ri.end(); ++i) {
+	for (Reinsertands::const_iterator i(reinsertands_.begin()); i != reinsertands_.end(); ++i) {
 		queue_.push(*i);
 	}
 }
 
+bool
+Timers::live(const TimerCommand *command)
+const
+{
+	return std::find(removed_.begin(), removed_.end(), command) == removed_.end();
+}
+
 bool
 Timers::isTicking()
 const
@@ -4,10 +4,12 @@
 #include <reactor/LazyTimer.hh>
 #include <reactor/TimerCommand.hh>
 #include <reactor/Backlog.hh>
+#include <reactor/LoopMetrics.hh>
 
 #include <util/Noncopyable.hh>
 
 #include <queue>
+#include <vector>
 
 namespace reactor {
 
@@ -19,10 +21,12 @@ private:
 	struct TimerAndCommand {
 		Timer timer;
 		TimerCommand *command;
+		const void *owner;
 
-		TimerAndCommand(const Timer &timer0, TimerCommand *command0)
+		TimerAndCommand(const Timer &timer0, TimerCommand *command0, const void *owner0)
 		: timer(timer0)
 		, command(command0)
+		, owner(owner0)
 		{}
 	};
 
@@ -30,22 +34,43 @@ private:
 	public:
 		bool operator() (const TimerAndCommand &a, const TimerAndCommand &b) const { return !(a.timer < b.timer); }
 	};
-	typedef std::priority_queue<TimerAndCommand, std::vector<TimerAndCommand>, TimerAndCommandComparator> Queue;
+	typedef std::priority_queue<TimerAndCommand, std::vector<TimerAndCommand>, TimerAndCommandComparator> Heap;
+
+	// exposes the heap's vector for reserve()
+	class Queue : public Heap {
+	public:
+		void reserve(size_t count) { c.reserve(count); }
+	};
+	typedef std::vector<TimerAndCommand> Reinsertands;
+	typedef std::vector<const TimerCommand *> Commands;
 
 	Queue queue_;
+	Reinsertands reinsertands_;
+	// harvested timers that will not come back, their jobs may still be queued
+	Reinsertands fired_;
+	// commands removed since the last harvest, their queued jobs are skipped
+	Commands removed_;
 	Backlog &backlog_;
 	NowFunc nowFunc_;
+	LoopMetrics *metrics_;
 
 public:
 	Timers(Backlog &backlog, const NowFunc &nowFunc = util::Time::now)
 	: backlog_(backlog)
 	, nowFunc_(nowFunc)
+	, metrics_(0)
 	{}
 
 	~Timers();
 
-	void add(const Timer &timer, const TimerCommand &timerCommand);
+	void reserve(size_t timers);
+	// records fired timers and their lateness, none when null
+	void setMetrics(LoopMetrics *metrics) { metrics_ = metrics; }
+	void add(const Timer &timer, const TimerCommand &timerCommand, const void *owner = 0);
+	void remove(const void *owner);
 	void harvest();
+	// false once the command was removed, for jobs harvested before that
+	bool live(const TimerCommand *command) const;
 	bool isTicking() const;
 	util::DiffTime remainingTime() const;
 };
@@ -3,12 +3,28 @@
 all: out/libreactor.a
 
 libreactor_SOURCE_NAMES := \
+	Acceptor.cc \
 	Backlog.cc \
+	ChildProcess.cc \
 	Client.cc \
+	ConnectionPool.cc \
+	Connector.cc \
+	DatagramEndpoint.cc \
 	Dispatcher.cc \
+	FdChannel.cc \
+	FileIo.cc \
+	FileReader.cc \
+	FileWatcher.cc \
+	LoopMetrics.cc \
+	OffloadPool.cc \
 	PollDemuxer.cc \
 	Reactor.cc \
+	Relay.cc \
+	ShardedAcceptor.cc \
+	Signals.cc \
 	Socket.cc \
+	SocketOptions.cc \
+	StreamConnection.cc \
 	Timer.cc \
 	Timers.cc
 
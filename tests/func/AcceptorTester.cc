@@ -0,0 +1,78 @@
+#include "FunctionalTest.hh"
+
+#include <reactor/Dispatcher.hh>
+#include <reactor/Acceptor.hh>
+#include <reactor/Reactor.hh>
+
+#include <stdexcept>
+#include <iostream>
+#include <cstdlib>
+
+using namespace reactor;
+
+class AcceptorTester : public FunctionalTest {
+	Reactor reactor_;
+	Acceptor acceptor_;
+	util::AutoFd peer_;
+
+public:
+	AcceptorTester(int argc, char *argv[]);
+
+	void onAccept(const util::Fd &fd);
+	void onFdPeer(const FdEvent &);
+	virtual int run();
+};
+
+AcceptorTester::AcceptorTester(int argc, char *argv[])
+: reactor_()
+, acceptor_(Dispatcher::instance(), util::commandForMethod(*this, &AcceptorTester::onAccept))
+{
+	if (argc != 3) throw std::runtime_error("argc must be 3");
+	acceptor_.setReuseAddr(true);
+	std::cerr << "listening..." << std::endl;
+	acceptor_.listen(net::Host(argv[1]), net::Service(argv[2]));
+}
+
+int
+AcceptorTester::run()
+{
+	try {
+		return reactor_.loop();
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+}
+
+void
+AcceptorTester::onAccept(const util::Fd &fd)
+{
+	if (peer_.valid()) {
+		util::AutoFd extra(fd.get());
+		return;
+	}
+
+	std::cerr << "accepted." << std::endl;
+	peer_.reset(fd.get());
+	Dispatcher::instance().add(FdEvent(peer_, FdEvent::READ), util::commandForMethod(*this, &AcceptorTester::onFdPeer));
+}
+
+void
+AcceptorTester::onFdPeer(const FdEvent &event)
+{
+	char buf[128];
+	size_t rd = event.fd.read(buf, sizeof(buf));
+
+	if (!rd) {
+		Dispatcher::instance().remove(event);
+		reactor_.quit();
+	} else {
+		size_t wr = util::Fd::STDOUT.write(buf, rd);
+
+		if (wr != rd) {
+			throw std::runtime_error("partial send");
+		}
+	}
+}
+
+REGISTER_FUNCTIONAL_TEST(AcceptorTester);
@@ -0,0 +1,95 @@
+#include "FunctionalTest.hh"
+
+#include <reactor/Dispatcher.hh>
+#include <reactor/ShardedAcceptor.hh>
+
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <iostream>
+#include <cstdlib>
+
+using namespace reactor;
+
+class ShardedAcceptorTester : public FunctionalTest {
+	ShardedAcceptor acceptor_;
+	std::mutex mutex_;
+	std::condition_variable done_;
+	bool finished_;
+	bool accepted_;
+
+public:
+	ShardedAcceptorTester(int argc, char *argv[]);
+
+	void onAccept(const util::Fd &fd);
+	void onFdPeer(const FdEvent &);
+	virtual int run();
+};
+
+ShardedAcceptorTester::ShardedAcceptorTester(int argc, char *argv[])
+: acceptor_(util::commandForMethod(*this, &ShardedAcceptorTester::onAccept), 2)
+, finished_(false)
+, accepted_(false)
+{
+	if (argc != 3) throw std::runtime_error("argc must be 3");
+	acceptor_.setCpuAffinity(true);
+	acceptor_.setSteering(true);
+	std::cerr << "listening..." << std::endl;
+	acceptor_.start(net::Host(argv[1]), net::Service(argv[2]));
+}
+
+int
+ShardedAcceptorTester::run()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	while (!finished_) {
+		done_.wait(lock);
+	}
+	lock.unlock();
+	acceptor_.stop();
+	if (acceptor_.error()) {
+		std::rethrow_exception(acceptor_.error());
+	}
+
+	return EXIT_SUCCESS;
+}
+
+void
+ShardedAcceptorTester::onAccept(const util::Fd &fd)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (accepted_) {
+		util::AutoFd extra(fd.get());
+		return;
+	}
+
+	std::cerr << "accepted." << std::endl;
+	accepted_ = true;
+	Dispatcher::current().add(FdEvent(fd, FdEvent::READ), util::commandForMethod(*this, &ShardedAcceptorTester::onFdPeer));
+}
+
+void
+ShardedAcceptorTester::onFdPeer(const FdEvent &event)
+{
+	char buf[128];
+	size_t rd = event.fd.read(buf, sizeof(buf));
+
+	if (!rd) {
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Dispatcher::current().remove(event);
+		util::AutoFd peer(event.fd.get());
+		finished_ = true;
+		done_.notify_all();
+	} else {
+		size_t wr = util::Fd::STDOUT.write(buf, rd);
+
+		if (wr != rd) {
+			throw std::runtime_error("partial send");
+		}
+	}
+}
+
+REGISTER_FUNCTIONAL_TEST(ShardedAcceptorTester);
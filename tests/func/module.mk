@@ -8,7 +8,9 @@ run_funcTests: tests/func/script/run-tests.sh out/testFuncs
 	$Q$< $(FUNCTIONAL_TESTS)
 
 testFuncs_TESTER_SOURCES := \
-	tests/func/ClientTester.cc
+	tests/func/AcceptorTester.cc \
+	tests/func/ClientTester.cc \
+	tests/func/ShardedAcceptorTester.cc
 
 FUNCTIONAL_TESTS := $(notdir $(basename $(testFuncs_TESTER_SOURCES)))
 
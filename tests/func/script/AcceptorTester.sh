@@ -0,0 +1,8 @@
+#!/bin/sh
+
+out/testFuncs AcceptorTester 127.0.0.1 9244 > out/c 2>/dev/null &
+echo valami > out/d
+sleep 0.1
+( cat out/d; sleep 0.1 ) | out/testFuncs ClientTester 127.0.0.1 9244 2>/dev/null
+wait
+diff -u3 out/c out/d
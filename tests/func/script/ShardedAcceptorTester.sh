@@ -0,0 +1,8 @@
+#!/bin/sh
+
+out/testFuncs ShardedAcceptorTester 127.0.0.1 9245 > out/e 2>/dev/null &
+echo valami > out/f
+sleep 0.1
+( cat out/f; sleep 0.1 ) | out/testFuncs ClientTester 127.0.0.1 9245 2>/dev/null
+wait
+diff -u3 out/e out/f
@@ -0,0 +1,153 @@
+#include <reactor/Acceptor.hh>
+
+#include <util/AutoFd.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdexcept>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h> // dup()
+
+using namespace util;
+using namespace reactor;
+
+class AcceptorTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(AcceptorTester);
+	CPPUNIT_TEST(testAccept);
+	CPPUNIT_TEST(testBatch);
+	CPPUNIT_TEST(testExhausted);
+	CPPUNIT_TEST(testInvalid);
+	CPPUNIT_TEST(testRegisterFailure);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	Acceptor *acceptor_;
+	std::vector<AutoFd *> accepted_;
+	std::vector<AutoFd *> clients_;
+
+	void onAccept(const Fd &fd) { accepted_.push_back(new AutoFd(fd.get())); }
+	void onOther(const FdEvent &) {}
+
+	void
+	connectClient()
+	{
+		net::Address address(acceptor_->localAddress());
+		AutoFd *client = new AutoFd(socket(address.family(), SOCK_STREAM | SOCK_CLOEXEC, 0));
+
+		clients_.push_back(client);
+		CPPUNIT_ASSERT_EQUAL(0, connect(client->get(), address.get(), address.length()));
+	}
+
+	static void
+	clear(std::vector<AutoFd *> &fds)
+	{
+		for (size_t i = 0; i < fds.size(); ++i) {
+			delete fds[i];
+		}
+		fds.clear();
+	}
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		acceptor_ = new Acceptor(*disp_, commandForMethod(*this, &AcceptorTester::onAccept));
+		acceptor_->listen(net::Host("127.0.0.1"), net::Service("0"));
+	}
+
+	void
+	tearDown()
+	{
+		clear(accepted_);
+		clear(clients_);
+		delete acceptor_;
+		delete disp_;
+	}
+
+	void
+	testAccept()
+	{
+		connectClient();
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, accepted_.size());
+		CPPUNIT_ASSERT_EQUAL(true, accepted_[0]->valid());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, acceptor_->exhausted());
+	}
+
+	void
+	testBatch()
+	{
+		acceptor_->setBatchSize(2);
+		for (size_t i = 0; i < 5; ++i) {
+			connectClient();
+		}
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)2, accepted_.size());
+		while (accepted_.size() < 5) {
+			disp_->stepSingleThread();
+		}
+	}
+
+	void
+	testExhausted()
+	{
+		struct rlimit limit, lowered;
+		int probe = dup(0);
+
+		acceptor_->setPauseDelay(DiffTime::ms(5));
+		connectClient();
+
+		// the accepted fd would need a number at or above the lowest free one
+		CPPUNIT_ASSERT(probe >= 0);
+		close(probe);
+		CPPUNIT_ASSERT_EQUAL(0, getrlimit(RLIMIT_NOFILE, &limit));
+		lowered = limit;
+		lowered.rlim_cur = probe;
+		CPPUNIT_ASSERT_EQUAL(0, setrlimit(RLIMIT_NOFILE, &lowered));
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL(0, setrlimit(RLIMIT_NOFILE, &limit));
+
+		CPPUNIT_ASSERT_EQUAL((size_t)0, accepted_.size());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, acceptor_->exhausted());
+		CPPUNIT_ASSERT_EQUAL(true, acceptor_->paused());
+
+		// the pending connection is picked up once the pause is over
+		while (accepted_.empty()) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL(false, acceptor_->paused());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, acceptor_->exhausted());
+	}
+
+	void
+	testInvalid()
+	{
+		CPPUNIT_ASSERT_THROW(acceptor_->setBatchSize(0), std::invalid_argument);
+		CPPUNIT_ASSERT_THROW(acceptor_->listen(net::Host("127.0.0.1"), net::Service("0")), std::runtime_error);
+	}
+
+	void
+	testRegisterFailure()
+	{
+		Acceptor *acceptor = new Acceptor(*disp_, commandForMethod(*this, &AcceptorTester::onAccept));
+		int probe = dup(0);
+
+		// the listening socket takes the lowest free number, already taken in the dispatcher
+		CPPUNIT_ASSERT(probe >= 0);
+		close(probe);
+		disp_->add(FdEvent(Fd(probe), FdEvent::READ), commandForMethod(*this, &AcceptorTester::onOther));
+		CPPUNIT_ASSERT_THROW(acceptor->listen(net::Host("127.0.0.1"), net::Service("0")), std::runtime_error);
+		CPPUNIT_ASSERT_EQUAL(false, acceptor->fd().valid());
+
+		// neither throws from the destructor nor takes the other registration along
+		delete acceptor;
+		disp_->remove(FdEvent(Fd(probe), FdEvent::READ));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AcceptorTester);
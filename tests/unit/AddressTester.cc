@@ -0,0 +1,71 @@
+#include <net/Address.hh>
+#include <net/Ip.hh>
+#include <net/Port.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdexcept>
+
+using namespace net;
+
+class AddressTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(AddressTester);
+	CPPUNIT_TEST(testConstruction);
+	CPPUNIT_TEST(testResolve);
+	CPPUNIT_TEST(testCompare);
+	CPPUNIT_TEST(testLocal);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void
+	testConstruction()
+	{
+		Address address;
+
+		CPPUNIT_ASSERT_EQUAL(false, address.valid());
+		CPPUNIT_ASSERT_EQUAL(std::string(), address.toString());
+		CPPUNIT_ASSERT_THROW(address.setLength(Address::capacity() + 1), std::length_error);
+	}
+
+	void
+	testResolve()
+	{
+		Address v4(Address::resolve(Ip("127.0.0.1"), Port(8080)));
+		Address v6(Address::resolve(Ip("::1"), Port(53)));
+
+		CPPUNIT_ASSERT_EQUAL(AF_INET, v4.family());
+		CPPUNIT_ASSERT_EQUAL(8080, v4.port());
+		CPPUNIT_ASSERT_EQUAL(std::string("127.0.0.1:8080"), v4.toString());
+		CPPUNIT_ASSERT_EQUAL(AF_INET6, v6.family());
+		CPPUNIT_ASSERT_EQUAL(std::string("[::1]:53"), v6.toString());
+	}
+
+	void
+	testCompare()
+	{
+		Address a(Address::resolve(Ip("127.0.0.1"), Port(1)));
+		Address b(Address::resolve(Ip("127.0.0.1"), Port(2)));
+		Address c(a.get(), a.length());
+
+		CPPUNIT_ASSERT(a == c);
+		CPPUNIT_ASSERT(a != b);
+		CPPUNIT_ASSERT(a < b || b < a);
+		CPPUNIT_ASSERT(!(a < c) && !(c < a));
+	}
+
+	void
+	testLocal()
+	{
+		Address path(Address::local("/tmp/reactor.sock"));
+		Address abstract(Address::abstract("reactor"));
+
+		CPPUNIT_ASSERT_EQUAL(AF_UNIX, path.family());
+		CPPUNIT_ASSERT_EQUAL(std::string("/tmp/reactor.sock"), path.toString());
+		CPPUNIT_ASSERT_EQUAL(0, path.port());
+		CPPUNIT_ASSERT_EQUAL(std::string("@reactor"), abstract.toString());
+		CPPUNIT_ASSERT(path != abstract);
+		CPPUNIT_ASSERT_THROW(Address::local(std::string(200, 'x')), std::length_error);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(AddressTester);
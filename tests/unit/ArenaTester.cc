@@ -0,0 +1,209 @@
+#include <util/Arena.hh>
+
+#include <reactor/Dispatcher.hh>
+
+#include <util/Pipe.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+using namespace util;
+using namespace reactor;
+
+namespace {
+
+bool countAllocations = false;
+size_t allocations = 0;
+
+} // namespace
+
+// counts heap allocations made while a test window is open, this tester
+// has a binary of its own so that no other tester runs on it
+void *
+operator new(size_t size)
+{
+	if (countAllocations) {
+		++allocations;
+	}
+
+	void *result = malloc(size ? size : 1);
+
+	if (!result) {
+		throw std::bad_alloc();
+	}
+	return result;
+}
+
+void
+operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void
+operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+class ArenaTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ArenaTester);
+	CPPUNIT_TEST(testAlignment);
+	CPPUNIT_TEST(testGrowth);
+	CPPUNIT_TEST(testDestructors);
+	CPPUNIT_TEST(testCommandClone);
+	CPPUNIT_TEST(testIterationAllocations);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	struct Tracked {
+		size_t &destroyed;
+		size_t order;
+
+		Tracked(size_t &destroyed0) : destroyed(destroyed0), order(0) {}
+		~Tracked() { order = ++destroyed; }
+	};
+
+	MyDispatcher *disp_;
+	size_t fdCount_;
+	size_t timerCount_;
+	size_t deferredCount_;
+
+	void
+	onReadable(const FdEvent &)
+	{
+		++fdCount_;
+		disp_->defer(this, commandForMethod(*this, &ArenaTester::onDeferred));
+	}
+
+	void onTimer(const TimerEvent &) { ++timerCount_; }
+	void onDeferred() { ++deferredCount_; }
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		fdCount_ = timerCount_ = deferredCount_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		countAllocations = false;
+		delete disp_;
+	}
+
+	void
+	testAlignment()
+	{
+		Arena arena(256);
+
+		arena.allocate(1, 1);
+		CPPUNIT_ASSERT_EQUAL((uintptr_t)0, reinterpret_cast<uintptr_t>(arena.allocate(8, 8)) % 8);
+		arena.allocate(3, 1);
+		CPPUNIT_ASSERT_EQUAL((uintptr_t)0, reinterpret_cast<uintptr_t>(arena.allocate(16, 64)) % 64);
+	}
+
+	void
+	testGrowth()
+	{
+		Arena arena(128);
+
+		arena.allocate(100);
+		arena.allocate(100);
+		arena.allocate(1000);
+		CPPUNIT_ASSERT(arena.capacity() >= 1228);
+
+		size_t capacity = arena.capacity();
+
+		arena.reset();
+		CPPUNIT_ASSERT_EQUAL((size_t)0, arena.used());
+		countAllocations = true;
+		allocations = 0;
+		arena.allocate(100);
+		arena.allocate(100);
+		arena.allocate(1000);
+		countAllocations = false;
+		CPPUNIT_ASSERT_EQUAL((size_t)0, allocations);
+		CPPUNIT_ASSERT_EQUAL(capacity, arena.capacity());
+
+		arena.reserve(capacity + 4096);
+		CPPUNIT_ASSERT(arena.capacity() >= capacity + 4096);
+		countAllocations = true;
+		arena.allocate(3000);
+		countAllocations = false;
+		CPPUNIT_ASSERT_EQUAL((size_t)0, allocations);
+	}
+
+	void
+	testDestructors()
+	{
+		Arena arena;
+		size_t destroyed = 0;
+		Tracked *first = arena.make<Tracked>(destroyed);
+		Tracked *second = arena.make<Tracked>(destroyed);
+
+		arena.adopt(new Tracked(destroyed));
+		CPPUNIT_ASSERT_EQUAL((size_t)0, destroyed);
+		arena.reset();
+		CPPUNIT_ASSERT_EQUAL((size_t)3, destroyed);
+		CPPUNIT_ASSERT_EQUAL((size_t)2, second->order);
+		CPPUNIT_ASSERT_EQUAL((size_t)3, first->order);
+	}
+
+	void
+	testCommandClone()
+	{
+		Arena arena;
+
+		arena.allocate(1);
+		countAllocations = true;
+		allocations = 0;
+
+		Command0<void> *command = commandForMethod(*this, &ArenaTester::onDeferred).clone(arena);
+
+		CPPUNIT_ASSERT_EQUAL((size_t)0, allocations);
+		delete command->clone();
+		countAllocations = false;
+		CPPUNIT_ASSERT_EQUAL((size_t)1, allocations);
+		command->execute();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, deferredCount_);
+		CPPUNIT_ASSERT(arena.used() >= sizeof(*command));
+		arena.reset();
+	}
+
+	void
+	testIterationAllocations()
+	{
+		Pipe pipe;
+
+		// an unread byte keeps the pipe readable on every iteration
+		pipe.write("x", 1);
+		disp_->add(FdEvent(pipe.readFd(), FdEvent::READ), commandForMethod(*this, &ArenaTester::onReadable));
+		disp_->add(Timer(DiffTime::raw(1)), commandForMethod(*this, &ArenaTester::onTimer));
+
+		for (int i = 0; i < 4; ++i) {
+			disp_->stepSingleThread();
+		}
+
+		countAllocations = true;
+		allocations = 0;
+		for (int i = 0; i < 100; ++i) {
+			disp_->stepSingleThread();
+		}
+		countAllocations = false;
+
+		CPPUNIT_ASSERT_EQUAL((size_t)0, allocations);
+		CPPUNIT_ASSERT_EQUAL((size_t)104, fdCount_);
+		CPPUNIT_ASSERT_EQUAL((size_t)104, deferredCount_);
+		CPPUNIT_ASSERT(timerCount_ >= 100);
+		disp_->remove(FdEvent(pipe.readFd(), FdEvent::READ));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ArenaTester);
@@ -0,0 +1,158 @@
+#include <reactor/Backlog.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+using namespace util;
+using namespace reactor;
+
+class BacklogTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(BacklogTester);
+	CPPUNIT_TEST(testWrapAround);
+	CPPUNIT_TEST(testGrow);
+	CPPUNIT_TEST(testReject);
+	CPPUNIT_TEST(testShed);
+	CPPUNIT_TEST(testCapacity);
+	CPPUNIT_TEST_SUITE_END();
+
+	Arena *arena_;
+	Backlog *bl_;
+	std::vector<int> ran_;
+
+	void run(int id) { ran_.push_back(id); }
+
+	bool
+	enqueue(int id, Backlog::Priority priority = Backlog::NORMAL)
+	{
+		return bl_->enqueueClone(bindCommand(commandForMethod(*this, &BacklogTester::run), id), priority);
+	}
+
+	void
+	executeAll()
+	{
+		while (!bl_->empty()) {
+			bl_->dequeue()->execute();
+		}
+		arena_->reset();
+	}
+
+public:
+	void
+	setUp()
+	{
+		arena_ = new Arena();
+		bl_ = new Backlog(*arena_, 4);
+		ran_.clear();
+	}
+
+	void
+	tearDown()
+	{
+		delete bl_;
+		delete arena_;
+	}
+
+	void
+	testWrapAround()
+	{
+		for (int round = 0; round < 3; ++round) {
+			enqueue(1);
+			enqueue(2);
+			enqueue(3);
+			bl_->dequeue()->execute();
+			enqueue(4);
+			enqueue(5);
+			executeAll();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)4, bl_->capacity());
+		CPPUNIT_ASSERT_EQUAL((size_t)15, ran_.size());
+		for (size_t i = 0; i < ran_.size(); ++i) {
+			CPPUNIT_ASSERT_EQUAL((int)(i % 5) + 1, ran_[i]);
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)4, bl_->highWaterMark());
+		CPPUNIT_ASSERT_THROW(bl_->dequeue(), std::runtime_error);
+	}
+
+	void
+	testGrow()
+	{
+		for (int i = 0; i < 9; ++i) {
+			CPPUNIT_ASSERT(enqueue(i));
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)16, bl_->capacity());
+		CPPUNIT_ASSERT_EQUAL((size_t)9, bl_->highWaterMark());
+		executeAll();
+		for (int i = 0; i < 9; ++i) {
+			CPPUNIT_ASSERT_EQUAL(i, ran_[i]);
+		}
+		bl_->resetHighWaterMark();
+		CPPUNIT_ASSERT_EQUAL((size_t)0, bl_->highWaterMark());
+	}
+
+	void
+	testReject()
+	{
+		bl_->setOverloadPolicy(Backlog::REJECT);
+		for (int i = 0; i < 4; ++i) {
+			CPPUNIT_ASSERT(enqueue(i));
+		}
+		CPPUNIT_ASSERT(!enqueue(4));
+		CPPUNIT_ASSERT(!bl_->admit(Backlog::LOW));
+		CPPUNIT_ASSERT_EQUAL((size_t)2, bl_->rejected());
+
+		// high priority work is never refused
+		CPPUNIT_ASSERT(enqueue(5, Backlog::HIGH));
+		CPPUNIT_ASSERT_EQUAL((size_t)8, bl_->capacity());
+
+		bl_->dequeue()->execute();
+		CPPUNIT_ASSERT(enqueue(6));
+		executeAll();
+		CPPUNIT_ASSERT_EQUAL((size_t)6, ran_.size());
+		CPPUNIT_ASSERT_EQUAL(6, ran_.back());
+	}
+
+	void
+	testShed()
+	{
+		bl_->setOverloadPolicy(Backlog::SHED);
+		enqueue(0, Backlog::NORMAL);
+		enqueue(1, Backlog::LOW);
+		enqueue(2, Backlog::NORMAL);
+		enqueue(3, Backlog::LOW);
+
+		// nothing below the newcomer, so it is the one shed
+		CPPUNIT_ASSERT(!enqueue(4, Backlog::LOW));
+		CPPUNIT_ASSERT(enqueue(5, Backlog::NORMAL));
+		CPPUNIT_ASSERT(enqueue(6, Backlog::NORMAL));
+		CPPUNIT_ASSERT(!enqueue(7, Backlog::NORMAL));
+		CPPUNIT_ASSERT_EQUAL((size_t)4, bl_->shed());
+		CPPUNIT_ASSERT_EQUAL((size_t)4, bl_->capacity());
+
+		executeAll();
+		CPPUNIT_ASSERT_EQUAL((size_t)4, ran_.size());
+		CPPUNIT_ASSERT_EQUAL(0, ran_[0]);
+		CPPUNIT_ASSERT_EQUAL(2, ran_[1]);
+		CPPUNIT_ASSERT_EQUAL(5, ran_[2]);
+		CPPUNIT_ASSERT_EQUAL(6, ran_[3]);
+	}
+
+	void
+	testCapacity()
+	{
+		bl_->setCapacity(5);
+		CPPUNIT_ASSERT_EQUAL((size_t)8, bl_->capacity());
+		for (int i = 0; i < 3; ++i) {
+			enqueue(i);
+		}
+		CPPUNIT_ASSERT_THROW(bl_->setCapacity(2), std::invalid_argument);
+		CPPUNIT_ASSERT_THROW(bl_->setCapacity(0), std::invalid_argument);
+		bl_->setCapacity(3);
+		bl_->reserve(2);
+		CPPUNIT_ASSERT_EQUAL((size_t)4, bl_->capacity());
+		executeAll();
+		CPPUNIT_ASSERT_EQUAL((size_t)3, ran_.size());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BacklogTester);
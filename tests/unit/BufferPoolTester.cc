@@ -0,0 +1,113 @@
+#include <util/BufferPool.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <thread>
+#include <vector>
+
+using namespace util;
+
+class BufferPoolTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(BufferPoolTester);
+	CPPUNIT_TEST(testClassSize);
+	CPPUNIT_TEST(testReuse);
+	CPPUNIT_TEST(testOversize);
+	CPPUNIT_TEST(testTrim);
+	CPPUNIT_TEST(testThreadHandoff);
+	CPPUNIT_TEST_SUITE_END();
+
+	static void
+	churn(size_t count, size_t size)
+	{
+		BufferPool &pool = BufferPool::instance();
+		std::vector<void *> buffers;
+
+		for (size_t i = 0; i < count; ++i) {
+			buffers.push_back(pool.allocate(size));
+		}
+		for (size_t i = 0; i < count; ++i) {
+			pool.release(buffers[i], size);
+		}
+	}
+
+public:
+	void
+	setUp()
+	{
+		BufferPool::instance().trim();
+	}
+
+	void
+	testClassSize()
+	{
+		CPPUNIT_ASSERT_EQUAL((size_t)2048, BufferPool::classSize(1));
+		CPPUNIT_ASSERT_EQUAL((size_t)4096, BufferPool::classSize(2049));
+		CPPUNIT_ASSERT_EQUAL(BufferPool::MAX_CLASS_SIZE, BufferPool::classSize(BufferPool::MAX_CLASS_SIZE));
+		CPPUNIT_ASSERT_EQUAL(BufferPool::MAX_CLASS_SIZE + 1, BufferPool::classSize(BufferPool::MAX_CLASS_SIZE + 1));
+	}
+
+	void
+	testReuse()
+	{
+		BufferPool &pool = BufferPool::instance();
+		size_t misses = pool.misses();
+		void *first = pool.allocate(3000);
+
+		CPPUNIT_ASSERT_EQUAL(misses + 1, pool.misses());
+		pool.release(first, 3000);
+
+		size_t hits = pool.hits();
+		void *second = pool.allocate(4096);
+
+		CPPUNIT_ASSERT_EQUAL(first, second);
+		CPPUNIT_ASSERT_EQUAL(hits + 1, pool.hits());
+		CPPUNIT_ASSERT_EQUAL(misses + 1, pool.misses());
+		pool.release(second, 4096);
+	}
+
+	void
+	testOversize()
+	{
+		BufferPool &pool = BufferPool::instance();
+		size_t size = BufferPool::MAX_CLASS_SIZE * 2;
+		size_t resident = pool.bytesResident();
+		void *buffer = pool.allocate(size);
+
+		CPPUNIT_ASSERT_EQUAL(resident + size, pool.bytesResident());
+		pool.release(buffer, size);
+		CPPUNIT_ASSERT_EQUAL(resident, pool.bytesResident());
+	}
+
+	void
+	testTrim()
+	{
+		BufferPool &pool = BufferPool::instance();
+		size_t resident = pool.bytesResident();
+
+		churn(64, 16 * 1024);
+		CPPUNIT_ASSERT(pool.bytesResident() >= resident + 16 * 16 * 1024);
+		pool.trim();
+		CPPUNIT_ASSERT_EQUAL(resident, pool.bytesResident());
+	}
+
+	void
+	testThreadHandoff()
+	{
+		BufferPool &pool = BufferPool::instance();
+		size_t allocations = pool.hits() + pool.misses();
+		std::thread worker(&BufferPoolTester::churn, 8, 2048);
+
+		worker.join();
+		// the worker's counts outlive its cache
+		CPPUNIT_ASSERT_EQUAL(allocations + 8, pool.hits() + pool.misses());
+
+		// the worker's cache went to the shared reserve when it exited
+		size_t hits = pool.hits();
+		void *buffer = pool.allocate(2048);
+
+		CPPUNIT_ASSERT_EQUAL(hits + 1, pool.hits());
+		pool.release(buffer, 2048);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BufferPoolTester);
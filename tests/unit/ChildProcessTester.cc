@@ -0,0 +1,200 @@
+#include <reactor/ChildProcess.hh>
+
+#include <util/ErrnoException.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory> // unique_ptr
+#include <string>
+#include <vector>
+#include <fcntl.h> // fcntl()
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h> // setrlimit()
+#include <unistd.h> // dup()
+
+using namespace util;
+using namespace reactor;
+
+class ChildProcessTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ChildProcessTester);
+	CPPUNIT_TEST(testExitStatus);
+	CPPUNIT_TEST(testStdio);
+	CPPUNIT_TEST(testSignalWatch);
+	CPPUNIT_TEST(testKill);
+	CPPUNIT_TEST(testSpawnFailure);
+	CPPUNIT_TEST(testPidfdFailure);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	ChildProcess *child_;
+	std::unique_ptr<ChildProcess::ExitEvent> exit_;
+	std::string output_;
+	std::string errors_;
+	size_t closeCount_;
+
+	void onExit(const ChildProcess::ExitEvent &event) { exit_.reset(new ChildProcess::ExitEvent(event)); }
+
+	void
+	onOutput(StreamConnection &connection)
+	{
+		std::string &target(&connection == child_->out() ? output_ : errors_);
+		size_t size = connection.input().size();
+
+		target.resize(target.size() + size);
+		connection.input().copyOut(&target[target.size() - size], size);
+		connection.input().consume(size);
+	}
+
+	void onClose(StreamConnection &) { ++closeCount_; }
+	void onSignal(const SignalEvent &) {}
+
+	void
+	run(size_t closes = 0)
+	{
+		while (!exit_ || closeCount_ < closes) {
+			disp_->stepSingleThread();
+		}
+	}
+
+	static ChildProcess::Arguments
+	shell(const char *script)
+	{
+		ChildProcess::Arguments arguments;
+
+		arguments.push_back("sh");
+		arguments.push_back("-c");
+		arguments.push_back(script);
+		return arguments;
+	}
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		child_ = new ChildProcess(*disp_, commandForMethod(*this, &ChildProcessTester::onExit));
+		exit_.reset();
+		output_.clear();
+		errors_.clear();
+		closeCount_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		delete child_;
+		delete disp_;
+	}
+
+	void
+	testExitStatus()
+	{
+		child_->spawn(shell("exit 3"), ChildProcess::NONE);
+		CPPUNIT_ASSERT(child_->running());
+		run();
+
+		CPPUNIT_ASSERT(!child_->running());
+		CPPUNIT_ASSERT(exit_->exited());
+		CPPUNIT_ASSERT_EQUAL(3, exit_->status);
+		CPPUNIT_ASSERT(!child_->in());
+	}
+
+	void
+	testStdio()
+	{
+		child_->spawn(shell("read line; echo \"got $line\"; echo oops >&2"));
+		child_->out()->setReadCommand(commandForMethod(*this, &ChildProcessTester::onOutput));
+		child_->out()->setCloseCommand(commandForMethod(*this, &ChildProcessTester::onClose));
+		child_->err()->setReadCommand(commandForMethod(*this, &ChildProcessTester::onOutput));
+		child_->err()->setCloseCommand(commandForMethod(*this, &ChildProcessTester::onClose));
+		child_->in()->write("hello\n", 6);
+		child_->in()->close();
+		run(2);
+
+		CPPUNIT_ASSERT_EQUAL(0, exit_->status);
+		CPPUNIT_ASSERT_EQUAL(std::string("got hello\n"), output_);
+		CPPUNIT_ASSERT_EQUAL(std::string("oops\n"), errors_);
+	}
+
+	void
+	testSignalWatch()
+	{
+		sigset_t current;
+
+		child_->setWatch(ChildProcess::SIGNAL);
+		child_->spawn(shell("exit 5"), ChildProcess::NONE);
+		CPPUNIT_ASSERT(!child_->pidfd());
+		run();
+		CPPUNIT_ASSERT_EQUAL(5, exit_->status);
+
+		// the last child gives SIGCHLD back
+		pthread_sigmask(SIG_BLOCK, 0, &current);
+		CPPUNIT_ASSERT(!sigismember(&current, SIGCHLD));
+	}
+
+	void
+	testKill()
+	{
+		child_->spawn(shell("exec sleep 10"), ChildProcess::NONE);
+		child_->kill(SIGKILL);
+		run();
+
+		CPPUNIT_ASSERT_EQUAL(CLD_KILLED, exit_->code);
+		CPPUNIT_ASSERT_EQUAL(SIGKILL, exit_->status);
+		CPPUNIT_ASSERT_THROW(child_->kill(), std::runtime_error);
+	}
+
+	void
+	testSpawnFailure()
+	{
+		ChildProcess::Arguments arguments;
+
+		arguments.push_back("/nonexistent/program");
+		CPPUNIT_ASSERT_THROW(child_->spawn(arguments), ErrnoException);
+		CPPUNIT_ASSERT(!child_->running());
+		CPPUNIT_ASSERT_THROW(child_->spawn(ChildProcess::Arguments()), std::invalid_argument);
+	}
+
+	void
+	testPidfdFailure()
+	{
+		struct rlimit saved, limit;
+		std::vector<int> filler;
+
+		// the signalfd exists already, so the fallback needs no new fd
+		disp_->add(Signal(SIGUSR2), commandForMethod(*this, &ChildProcessTester::onSignal));
+		getrlimit(RLIMIT_NOFILE, &saved);
+		limit = saved;
+		limit.rlim_cur = dup(0) + 16;
+		close(limit.rlim_cur - 16);
+		setrlimit(RLIMIT_NOFILE, &limit);
+		// the table fills up here, the child gets its fds back with exec
+		for (int fd; (fd = fcntl(0, F_DUPFD_CLOEXEC, 0)) >= 0;) {
+			filler.push_back(fd);
+		}
+		auto restore = [&]() {
+			for (size_t i = 0; i < filler.size(); ++i) {
+				close(filler[i]);
+			}
+			setrlimit(RLIMIT_NOFILE, &saved);
+		};
+
+		try {
+			child_->spawn(shell("exit 7"), ChildProcess::NONE);
+		} catch (...) {
+			restore();
+			throw;
+		}
+		restore();
+
+		CPPUNIT_ASSERT(!child_->pidfd());
+		run();
+		CPPUNIT_ASSERT_EQUAL(7, exit_->status);
+		disp_->remove(Signal(SIGUSR2));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ChildProcessTester);
@@ -0,0 +1,210 @@
+#include <reactor/ConnectionPool.hh>
+#include <reactor/StreamSock.hh>
+
+#include <net/Ip.hh>
+#include <net/Port.hh>
+#include <util/AutoFd.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory> // unique_ptr
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h> // usleep()
+
+using namespace util;
+using namespace reactor;
+
+class ConnectionPoolTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ConnectionPoolTester);
+	CPPUNIT_TEST(testReuse);
+	CPPUNIT_TEST(testWaiters);
+	CPPUNIT_TEST(testDeadIdle);
+	CPPUNIT_TEST(testIdleExpiry);
+	CPPUNIT_TEST(testIdleExpiryStaggered);
+	CPPUNIT_TEST(testForeignFd);
+	CPPUNIT_TEST(testConnectFailure);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	ConnectionPool *pool_;
+	StreamSock *listener_;
+	std::unique_ptr<net::Port> port_;
+	const net::Ip host_;
+	std::vector<Fd> acquired_;
+
+	void onAcquire(const Fd &fd) { acquired_.push_back(fd); }
+
+	void
+	acquire()
+	{
+		pool_->acquire(host_, *port_, commandForMethod(*this, &ConnectionPoolTester::onAcquire));
+	}
+
+	// new connections complete from the dispatcher
+	void
+	await(size_t count)
+	{
+		while (acquired_.size() < count) {
+			disp_->stepSingleThread();
+		}
+	}
+
+public:
+	ConnectionPoolTester()
+	: host_("127.0.0.1")
+	{}
+
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		pool_ = new ConnectionPool(*disp_);
+		listener_ = new StreamSock();
+		listener_->bind(host_, net::Port(0));
+		listener_->listen(16);
+		port_.reset(new net::Port(listener_->localAddress().port()));
+		acquired_.clear();
+	}
+
+	void
+	tearDown()
+	{
+		// every test leaves only the connections it still holds
+		for (size_t i = 0; i < acquired_.size(); ++i) {
+			pool_->discard(acquired_[i]);
+		}
+		delete pool_;
+		delete listener_;
+		delete disp_;
+	}
+
+	void
+	testReuse()
+	{
+		acquire();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->connecting(host_, *port_));
+		await(1);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->connecting(host_, *port_));
+		CPPUNIT_ASSERT_EQUAL((size_t)1, acquired_.size());
+		CPPUNIT_ASSERT_EQUAL(true, acquired_[0].valid());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->connected());
+
+		pool_->release(acquired_[0]);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->idle(host_, *port_));
+
+		acquire();
+		CPPUNIT_ASSERT_EQUAL((size_t)2, acquired_.size());
+		CPPUNIT_ASSERT(acquired_[0] == acquired_[1]);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->connected());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->reused());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->idle(host_, *port_));
+		acquired_.pop_back();
+	}
+
+	void
+	testWaiters()
+	{
+		pool_->setMaxPerTarget(1);
+		acquire();
+		acquire();
+		await(1);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, acquired_.size());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->waiting(host_, *port_));
+
+		pool_->release(acquired_[0]);
+		CPPUNIT_ASSERT_EQUAL((size_t)2, acquired_.size());
+		CPPUNIT_ASSERT(acquired_[0] == acquired_[1]);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->waiting(host_, *port_));
+
+		acquire();
+		pool_->discard(acquired_[1]);
+		await(3);
+		CPPUNIT_ASSERT_EQUAL((size_t)3, acquired_.size());
+		CPPUNIT_ASSERT_EQUAL(true, acquired_[2].valid());
+		CPPUNIT_ASSERT_EQUAL((size_t)2, pool_->connected());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->open(host_, *port_));
+		acquired_.erase(acquired_.begin(), acquired_.begin() + 2);
+	}
+
+	void
+	testDeadIdle()
+	{
+		acquire();
+		await(1);
+
+		AutoFd server(accept(listener_->fd().get(), 0, 0));
+
+		pool_->release(acquired_[0]);
+		acquired_.clear();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->idle(host_, *port_));
+
+		server.reset();
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->idle(host_, *port_));
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->open(host_, *port_));
+	}
+
+	void
+	testIdleExpiry()
+	{
+		pool_->setIdleTimeout(DiffTime::ms(10));
+		acquire();
+		await(1);
+		pool_->release(acquired_[0]);
+		acquired_.clear();
+
+		while (pool_->idle(host_, *port_)) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->open(host_, *port_));
+	}
+
+	void
+	testIdleExpiryStaggered()
+	{
+		pool_->setIdleTimeout(DiffTime::ms(100));
+		acquire();
+		acquire();
+		await(2);
+		pool_->release(acquired_[0]);
+		usleep(50 * 1000);
+		pool_->release(acquired_[1]);
+		acquired_.clear();
+
+		// the timer armed for the first one comes back for the second
+		while (pool_->idle(host_, *port_) == 2) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->idle(host_, *port_));
+		while (pool_->idle(host_, *port_)) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->open(host_, *port_));
+	}
+
+	void
+	testForeignFd()
+	{
+		CPPUNIT_ASSERT_THROW(pool_->release(Fd(0)), std::invalid_argument);
+		CPPUNIT_ASSERT_THROW(pool_->setMaxPerTarget(0), std::invalid_argument);
+	}
+
+	void
+	testConnectFailure()
+	{
+		delete listener_;
+		listener_ = 0;
+		acquire();
+		await(1);
+		CPPUNIT_ASSERT_EQUAL(false, acquired_[0].valid());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->open(host_, *port_));
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->waiting(host_, *port_));
+		CPPUNIT_ASSERT_EQUAL((size_t)0, pool_->connected());
+		acquired_.clear();
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ConnectionPoolTester);
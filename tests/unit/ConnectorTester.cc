@@ -0,0 +1,234 @@
+#include <reactor/Connector.hh>
+#include <reactor/StreamSock.hh>
+
+#include <net/Ip.hh>
+#include <net/Port.hh>
+#include <util/AutoFd.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <algorithm> // std::find
+#include <memory> // unique_ptr
+#include <vector>
+#include <sys/socket.h>
+
+using namespace util;
+using namespace reactor;
+
+// reports every watched write event at once, unless held
+class WritableDemuxer : public Demuxer {
+	std::vector<int> fds_;
+
+public:
+	bool held;
+
+	WritableDemuxer() : held(false) {}
+
+	virtual void
+	add(const FdEvent &fdEvent)
+	{
+		if (fdEvent.what == FdEvent::WRITE) {
+			fds_.push_back(fdEvent.fd.get());
+		}
+	}
+
+	virtual void
+	remove(const FdEvent &fdEvent)
+	{
+		std::vector<int>::iterator i(std::find(fds_.begin(), fds_.end(), fdEvent.fd.get()));
+
+		if (fdEvent.what == FdEvent::WRITE && i != fds_.end()) {
+			fds_.erase(i);
+		}
+	}
+
+	virtual void
+	demux(const DiffTime *, FdEvents &fdEvents)
+	{
+		for (size_t i = 0; !held && i < fds_.size(); ++i) {
+			fdEvents.push_back(FdEvent(Fd(fds_[i]), FdEvent::WRITE));
+		}
+	}
+};
+
+class ConnectorTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(ConnectorTester);
+	CPPUNIT_TEST(testInterleave);
+	CPPUNIT_TEST(testConnect);
+	CPPUNIT_TEST(testRace);
+	CPPUNIT_TEST(testSameIteration);
+	CPPUNIT_TEST(testAllFail);
+	CPPUNIT_TEST(testTimeout);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {
+	public:
+		explicit MyDispatcher(Demuxer *demuxer = 0) : Dispatcher(demuxer) {}
+	};
+
+	MyDispatcher *disp_;
+	Connector *connector_;
+	StreamSock *listener_;
+	std::unique_ptr<AutoFd> connected_;
+	size_t completions_;
+
+	void
+	onConnect(const Fd &fd)
+	{
+		connected_.reset(new AutoFd(fd.get()));
+		++completions_;
+	}
+
+	void
+	run()
+	{
+		while (connector_->connecting()) {
+			disp_->stepSingleThread();
+		}
+	}
+
+	net::Address
+	listenerAddress()
+	{
+		return listener_->localAddress();
+	}
+
+	static net::Address
+	address(const char *ip, int port)
+	{
+		return net::Address::resolve(net::Ip(ip), net::Port(port));
+	}
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		connector_ = new Connector(*disp_, commandForMethod(*this, &ConnectorTester::onConnect));
+		listener_ = new StreamSock();
+		listener_->bind(net::Ip("127.0.0.1"), net::Port(0));
+		listener_->listen(16);
+		connected_.reset();
+		completions_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		connected_.reset();
+		delete listener_;
+		delete connector_;
+		delete disp_;
+	}
+
+	void
+	testInterleave()
+	{
+		Connector::Addresses addresses;
+
+		addresses.push_back(address("::1", 1));
+		addresses.push_back(address("::1", 2));
+		addresses.push_back(address("::1", 3));
+		addresses.push_back(address("127.0.0.1", 4));
+
+		Connector::Addresses result(Connector::interleave(addresses));
+
+		CPPUNIT_ASSERT_EQUAL((size_t)4, result.size());
+		CPPUNIT_ASSERT_EQUAL(1, result[0].port());
+		CPPUNIT_ASSERT_EQUAL(4, result[1].port());
+		CPPUNIT_ASSERT_EQUAL(2, result[2].port());
+		CPPUNIT_ASSERT_EQUAL(3, result[3].port());
+	}
+
+	void
+	testConnect()
+	{
+		connector_->connect(net::Ip("127.0.0.1"), net::Port(listenerAddress().port()));
+		run();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, completions_);
+		CPPUNIT_ASSERT_EQUAL(true, connected_->valid());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, connector_->attemptCount());
+	}
+
+	void
+	testRace()
+	{
+		Connector::Addresses addresses;
+		struct sockaddr_storage peer;
+		socklen_t length = sizeof(peer);
+
+		// TEST-NET-1 is never routed, the attempt either hangs or fails at once
+		addresses.push_back(address("192.0.2.1", listenerAddress().port()));
+		addresses.push_back(listenerAddress());
+		connector_->setAttemptDelay(DiffTime::ms(20));
+		connector_->connect(addresses);
+		run();
+
+		CPPUNIT_ASSERT_EQUAL((size_t)1, completions_);
+		CPPUNIT_ASSERT_EQUAL(true, connected_->valid());
+		CPPUNIT_ASSERT_EQUAL((size_t)2, connector_->attemptCount());
+		CPPUNIT_ASSERT_EQUAL(0, getpeername(connected_->get(), (struct sockaddr *)&peer, &length));
+		CPPUNIT_ASSERT(net::Address((struct sockaddr *)&peer, length) == listenerAddress());
+	}
+
+	void
+	testSameIteration()
+	{
+		WritableDemuxer demuxer;
+		MyDispatcher disp(&demuxer);
+		Connector connector(disp, commandForMethod(*this, &ConnectorTester::onConnect));
+		Connector::Addresses addresses;
+
+		addresses.push_back(listenerAddress());
+		addresses.push_back(listenerAddress());
+		connector.setAttemptDelay(DiffTime::ms(0));
+		connector.connect(addresses);
+
+		// the attempt timer starts the second attempt before either is reported
+		demuxer.held = true;
+		disp.stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)2, connector.attemptCount());
+
+		// both are writable in one iteration, only the first completes
+		demuxer.held = false;
+		disp.stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL(false, connector.connecting());
+		disp.stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, completions_);
+		CPPUNIT_ASSERT_EQUAL(true, connected_->valid());
+	}
+
+	void
+	testAllFail()
+	{
+		Connector::Addresses addresses;
+		net::Address refused(listenerAddress());
+
+		delete listener_;
+		listener_ = 0;
+		addresses.push_back(refused);
+		addresses.push_back(refused);
+		connector_->connect(addresses);
+		run();
+
+		CPPUNIT_ASSERT_EQUAL((size_t)1, completions_);
+		CPPUNIT_ASSERT_EQUAL(false, connected_->valid());
+		CPPUNIT_ASSERT_EQUAL((size_t)2, connector_->attemptCount());
+	}
+
+	void
+	testTimeout()
+	{
+		Connector::Addresses addresses;
+
+		addresses.push_back(address("192.0.2.1", 9));
+		connector_->setTimeout(DiffTime::ms(20));
+		connector_->connect(addresses);
+		run();
+
+		CPPUNIT_ASSERT_EQUAL((size_t)1, completions_);
+		CPPUNIT_ASSERT_EQUAL(false, connected_->valid());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ConnectorTester);
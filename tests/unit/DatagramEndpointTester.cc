@@ -0,0 +1,202 @@
+#include <reactor/DatagramEndpoint.hh>
+
+#include <net/Ip.hh>
+#include <net/Port.hh>
+
+#include <util/BufferPool.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+using namespace util;
+using namespace reactor;
+
+class DatagramEndpointTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DatagramEndpointTester);
+	CPPUNIT_TEST(testExchange);
+	CPPUNIT_TEST(testBatchedReceive);
+	CPPUNIT_TEST(testTruncated);
+	CPPUNIT_TEST(testBuffersKept);
+	CPPUNIT_TEST(testQueueLimit);
+	CPPUNIT_TEST(testSegmentation);
+	CPPUNIT_TEST(testCoalescedReceive);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	DatagramEndpoint *first_;
+	DatagramEndpoint *second_;
+	std::vector<std::string> received_;
+	size_t truncated_;
+	net::Address lastSource_;
+
+	void
+	onReceive(const DatagramEndpoint::Datagram &datagram)
+	{
+		received_.push_back(std::string(datagram.data, datagram.length));
+		truncated_ += datagram.truncated;
+		lastSource_ = datagram.source;
+	}
+
+	void
+	onEcho(const DatagramEndpoint::Datagram &datagram)
+	{
+		second_->send(datagram.data, datagram.length, datagram.source);
+	}
+
+	void
+	receive(size_t count)
+	{
+		while (received_.size() < count) {
+			disp_->stepSingleThread();
+		}
+	}
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		first_ = new DatagramEndpoint(*disp_, commandForMethod(*this, &DatagramEndpointTester::onReceive));
+		second_ = new DatagramEndpoint(*disp_, commandForMethod(*this, &DatagramEndpointTester::onReceive));
+		first_->bind(net::Ip("127.0.0.1"), net::Port(0));
+		second_->bind(net::Ip("127.0.0.1"), net::Port(0));
+		received_.clear();
+		truncated_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		delete second_;
+		delete first_;
+		delete disp_;
+	}
+
+	void
+	testExchange()
+	{
+		delete second_;
+		second_ = new DatagramEndpoint(*disp_, commandForMethod(*this, &DatagramEndpointTester::onEcho));
+		second_->bind(net::Ip("127.0.0.1"), net::Port(0));
+
+		first_->send("ping", 4, second_->localAddress());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, first_->sent());
+		receive(1);
+		CPPUNIT_ASSERT_EQUAL(std::string("ping"), received_[0]);
+		CPPUNIT_ASSERT(second_->localAddress() == lastSource_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, second_->sent());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, second_->received());
+	}
+
+	void
+	testBatchedReceive()
+	{
+		const size_t count = 200;
+
+		second_->setBatchSize(16);
+		for (size_t i = 0; i < count; ++i) {
+			std::string payload(1 + i, 'a' + i % 26);
+
+			first_->send(payload.data(), payload.size(), second_->localAddress());
+		}
+		CPPUNIT_ASSERT_EQUAL(count, first_->sent() + first_->dropped());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, first_->queued());
+
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)16, received_.size());
+
+		receive(first_->sent());
+		for (size_t i = 0; i < received_.size(); ++i) {
+			CPPUNIT_ASSERT_EQUAL(std::string(1 + i, 'a' + i % 26), received_[i]);
+		}
+	}
+
+	void
+	testTruncated()
+	{
+		std::string payload(100, 't');
+
+		second_->setMaxDatagramSize(10);
+		first_->send(payload.data(), payload.size(), second_->localAddress());
+		receive(1);
+		CPPUNIT_ASSERT_EQUAL(std::string(10, 't'), received_[0]);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, truncated_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, second_->truncated());
+	}
+
+	void
+	testBuffersKept()
+	{
+		BufferPool &pool = BufferPool::instance();
+
+		first_->send("one", 3, second_->localAddress());
+		receive(1);
+		first_->send("two", 3, second_->localAddress());
+
+		// later wakeups read into the buffers taken by the first one
+		size_t allocations = pool.hits() + pool.misses();
+
+		receive(2);
+		CPPUNIT_ASSERT_EQUAL(allocations, pool.hits() + pool.misses());
+	}
+
+	void
+	sendSegmented(size_t count, size_t segmentSize)
+	{
+		IoBuffer buffer;
+
+		for (size_t i = 0; i < count; ++i) {
+			std::string payload(i + 1 < count ? segmentSize : segmentSize / 2, 'a' + i);
+
+			buffer.append(payload.data(), payload.size());
+		}
+		first_->send(buffer, second_->localAddress(), segmentSize);
+		CPPUNIT_ASSERT_EQUAL(count, first_->sent());
+	}
+
+	void
+	checkSegmented(size_t count, size_t segmentSize)
+	{
+		receive(count);
+		CPPUNIT_ASSERT_EQUAL(count, received_.size());
+		for (size_t i = 0; i < count; ++i) {
+			CPPUNIT_ASSERT_EQUAL(std::string(i + 1 < count ? segmentSize : segmentSize / 2, 'a' + i), received_[i]);
+		}
+	}
+
+	void
+	testSegmentation()
+	{
+		CPPUNIT_ASSERT_THROW(first_->send(IoBuffer(), second_->localAddress(), 0), std::invalid_argument);
+		sendSegmented(10, 1000);
+		checkSegmented(10, 1000);
+	}
+
+	void
+	testCoalescedReceive()
+	{
+		second_->setGro(true);
+		sendSegmented(20, 1200);
+		checkSegmented(20, 1200);
+		CPPUNIT_ASSERT_EQUAL((size_t)20, second_->received());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, second_->truncated());
+	}
+
+	void
+	testQueueLimit()
+	{
+		first_->setMaxQueued(0);
+		first_->send("x", 1, second_->localAddress());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, first_->dropped());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, first_->sent());
+
+		first_->close();
+		CPPUNIT_ASSERT_THROW(first_->send("x", 1, second_->localAddress()), std::runtime_error);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DatagramEndpointTester);
@@ -6,6 +6,7 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <stdexcept>
+#include <sys/resource.h>
 
 using namespace util;
 using namespace reactor;
@@ -14,7 +15,7 @@ class MyDemuxer : public Demuxer {
 public:
 	virtual void add(const FdEvent &fdEvent);
 	virtual void remove(const FdEvent &fdEvent);
-	virtual FdEvents *demux(const DiffTime *interval);
+	virtual void demux(const DiffTime *interval, FdEvents &fdEvents);
 };
 
 void
@@ -29,19 +30,16 @@ MyDemuxer::remove(const FdEvent &fdEvent)
 	(void)fdEvent;
 }
 
-MyDemuxer::FdEvents *
-MyDemuxer::demux(const DiffTime *interval)
+void
+MyDemuxer::demux(const DiffTime *interval, FdEvents &fdEvents)
 {
-	FdEvents *result = new FdEvents();
 	Mocked &m = MockRegistry::find("demux");
 
 	(void)interval;
 
 	for (int i = m.expectedInt(); i; --i) {
-		result->push_back(FdEvent(Fd(m.expectedInt()), FdEvent::READ));
+		fdEvents.push_back(FdEvent(Fd(m.expectedInt()), FdEvent::READ));
 	}
-
-	return result;
 }
 
 class MyDispatcher : public Dispatcher {
@@ -55,21 +53,34 @@ class DispatcherTester : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(DispatcherTester);
 	CPPUNIT_TEST(testFdAction);
 	CPPUNIT_TEST(testInvalidFdAction);
+	CPPUNIT_TEST(testDuplicateFdAction);
+	CPPUNIT_TEST(testRemoveFdAction);
+	CPPUNIT_TEST(testRemoveFromFdAction);
+	CPPUNIT_TEST(testRemoveFromEarlierJob);
+	CPPUNIT_TEST(testDeferredJob);
 	CPPUNIT_TEST(testTimerAction);
 	CPPUNIT_TEST(testLazyTimerAction);
+	CPPUNIT_TEST(testRemoveTimerFromEarlierJob);
+	CPPUNIT_TEST(testReserve);
+	CPPUNIT_TEST(testOverloadReject);
 	CPPUNIT_TEST_SUITE_END();
 
 	const MethodCommand1<void, DispatcherTester, const FdEvent &> fdMethodCommand_;
 	const MethodCommand1<void, DispatcherTester, const TimerEvent &> timerMethodCommand_;
+	const MethodCommand1<void, DispatcherTester, const FdEvent &> removingMethodCommand_;
 	MyDemuxer *dmx_;
 	MyDispatcher *disp_;
 	size_t fdCommandCount_;
 	size_t timerCommandCount_;
+	size_t deferredCount_;
+	bool drainingSeen_;
+	int victim_;
 
 public:
 	DispatcherTester()
 	: fdMethodCommand_(MethodCommand1<void, DispatcherTester, const FdEvent &>(*this, &DispatcherTester::fdCommand))
 	, timerMethodCommand_(MethodCommand1<void, DispatcherTester, const TimerEvent &>(*this, &DispatcherTester::timerCommand))
+	, removingMethodCommand_(MethodCommand1<void, DispatcherTester, const FdEvent &>(*this, &DispatcherTester::removingCommand))
 	{}
 
 	void
@@ -79,6 +90,8 @@ public:
 		disp_ = new MyDispatcher(dmx_, &DispatcherTester::now);
 		fdCommandCount_ = 0;
 		timerCommandCount_ = 0;
+		deferredCount_ = 0;
+		drainingSeen_ = false;
 	}
 
 	void
@@ -94,12 +107,50 @@ public:
 		++fdCommandCount_;
 	}
 
+	void
+	removingCommand(const FdEvent &event)
+	{
+		++fdCommandCount_;
+		disp_->remove(event);
+	}
+
+	void
+	removingOtherCommand(const FdEvent &)
+	{
+		++fdCommandCount_;
+		disp_->remove(FdEvent(Fd(victim_), FdEvent::READ));
+	}
+
+	void
+	deferringCommand(const FdEvent &)
+	{
+		++fdCommandCount_;
+		drainingSeen_ = disp_->draining();
+		disp_->defer(this, commandForMethod(*this, &DispatcherTester::deferredCommand));
+		disp_->defer(&fdCommandCount_, commandForMethod(*this, &DispatcherTester::deferredCommand));
+		disp_->cancelDeferred(&fdCommandCount_);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, deferredCount_);
+	}
+
+	void
+	deferredCommand()
+	{
+		++deferredCount_;
+	}
+
 	void
 	timerCommand(const TimerEvent &)
 	{
 		++timerCommandCount_;
 	}
 
+	void
+	removingTimerCommand(const TimerEvent &)
+	{
+		++timerCommandCount_;
+		disp_->removeTimers(&victim_);
+	}
+
 	void
 	testFdAction()
 	{
@@ -123,6 +174,88 @@ public:
 		CPPUNIT_ASSERT_THROW(disp_->collectEvents(disp_->wait()), std::runtime_error);
 	}
 
+	void
+	testDuplicateFdAction()
+	{
+		Fd fd(44);
+
+		disp_->add(FdEvent(fd, FdEvent::READ), fdMethodCommand_);
+		CPPUNIT_ASSERT_THROW(disp_->add(FdEvent(fd, FdEvent::READ), fdMethodCommand_), std::runtime_error);
+		CPPUNIT_ASSERT_NO_THROW(disp_->add(FdEvent(fd, FdEvent::WRITE), fdMethodCommand_));
+	}
+
+	void
+	testRemoveFdAction()
+	{
+		Mocked demux("demux");
+		Fd fd(45);
+
+		CPPUNIT_ASSERT_THROW(disp_->remove(FdEvent(fd, FdEvent::READ)), std::runtime_error);
+		disp_->add(FdEvent(fd, FdEvent::READ), fdMethodCommand_);
+		disp_->remove(FdEvent(fd, FdEvent::READ));
+		CPPUNIT_ASSERT_THROW(disp_->remove(FdEvent(fd, FdEvent::READ)), std::runtime_error);
+		demux.expectf("%d%d", 1, 45);
+		CPPUNIT_ASSERT_THROW(disp_->collectEvents(disp_->wait()), std::runtime_error);
+		disp_->add(FdEvent(fd, FdEvent::READ), fdMethodCommand_);
+		demux.expectf("%d%d", 1, 45);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fdCommandCount_);
+	}
+
+	void
+	testRemoveFromFdAction()
+	{
+		Mocked demux("demux");
+		Fd fd(46);
+
+		disp_->add(FdEvent(fd, FdEvent::READ), removingMethodCommand_);
+		demux.expectf("%d%d", 1, 46);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fdCommandCount_);
+		CPPUNIT_ASSERT_THROW(disp_->remove(FdEvent(fd, FdEvent::READ)), std::runtime_error);
+		disp_->add(FdEvent(fd, FdEvent::READ), fdMethodCommand_);
+		demux.expectf("%d%d", 1, 46);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)2, fdCommandCount_);
+	}
+
+	void
+	testRemoveFromEarlierJob()
+	{
+		Mocked demux("demux");
+		Fd fd1(48), fd2(49);
+
+		victim_ = 49;
+		disp_->add(FdEvent(fd1, FdEvent::READ), commandForMethod(*this, &DispatcherTester::removingOtherCommand));
+		disp_->add(FdEvent(fd2, FdEvent::READ), fdMethodCommand_);
+		demux.expectf("%d%d%d", 2, 48, 49);
+		disp_->stepSingleThread();
+		// the job queued for fd2 is stale once its registration is gone
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fdCommandCount_);
+
+		// a new registration of the same fd is served again
+		disp_->add(FdEvent(fd2, FdEvent::READ), fdMethodCommand_);
+		demux.expectf("%d%d", 1, 49);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)2, fdCommandCount_);
+	}
+
+	void
+	testDeferredJob()
+	{
+		Mocked demux("demux");
+		Fd fd(47);
+
+		disp_->add(FdEvent(fd, FdEvent::READ), commandForMethod(*this, &DispatcherTester::deferringCommand));
+		demux.expectf("%d%d", 1, 47);
+		CPPUNIT_ASSERT_EQUAL(false, disp_->draining());
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL(false, disp_->draining());
+		CPPUNIT_ASSERT_EQUAL(true, drainingSeen_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fdCommandCount_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, deferredCount_);
+	}
+
 	static Time
 	now()
 	{
@@ -161,6 +294,67 @@ public:
 		CPPUNIT_ASSERT_EQUAL((size_t)1, fdCommandCount_);
 		CPPUNIT_ASSERT_EQUAL((size_t)1, timerCommandCount_);
 	}
+
+	void
+	testRemoveTimerFromEarlierJob()
+	{
+		Mocked demux("demux");
+		Mocked now("now");
+
+		// both expire in one iteration, the first removes the second after its job was queued
+		disp_->add(Timer(DiffTime::raw(1), 1, Time::raw(0)), commandForMethod(*this, &DispatcherTester::removingTimerCommand));
+		disp_->add(Timer(DiffTime::raw(2), 1, Time::raw(0)), timerMethodCommand_, &victim_);
+		demux.expect(0);
+		now.expect(2);
+		now.expect(2);
+		now.expect(2);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, timerCommandCount_);
+	}
+
+	void
+	testReserve()
+	{
+		Mocked demux("demux");
+		Fd fd(1000);
+		struct rlimit limit;
+
+		disp_->reserve(1024, 16, 256);
+		disp_->add(FdEvent(fd, FdEvent::READ), fdMethodCommand_);
+		demux.expectf("%d%d", 1, 1000);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fdCommandCount_);
+		disp_->remove(FdEvent(fd, FdEvent::READ));
+		CPPUNIT_ASSERT_THROW(disp_->add(FdEvent(Fd(), FdEvent::READ), fdMethodCommand_), std::invalid_argument);
+
+		CPPUNIT_ASSERT_EQUAL(0, getrlimit(RLIMIT_NOFILE, &limit));
+		CPPUNIT_ASSERT_EQUAL((size_t)limit.rlim_cur, Dispatcher::raiseFdLimit(limit.rlim_cur / 2));
+		if (limit.rlim_max != RLIM_INFINITY) {
+			CPPUNIT_ASSERT_EQUAL((size_t)limit.rlim_max, Dispatcher::raiseFdLimit(limit.rlim_max));
+		}
+	}
+
+	void
+	testOverloadReject()
+	{
+		Mocked demux("demux");
+		Fd fd1(46), fd2(47);
+
+		disp_->backlog().setCapacity(1);
+		disp_->backlog().setOverloadPolicy(Backlog::REJECT);
+		disp_->add(FdEvent(fd1, FdEvent::READ), fdMethodCommand_);
+		disp_->add(FdEvent(fd2, FdEvent::READ), fdMethodCommand_);
+		demux.expectf("%d%d%d", 2, 46, 47);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fdCommandCount_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, disp_->backlog().rejected());
+
+		// the refused fd was never suspended and is reported again
+		demux.expectf("%d%d", 1, 47);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)2, fdCommandCount_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, disp_->backlog().highWaterMark());
+	}
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(DispatcherTester);
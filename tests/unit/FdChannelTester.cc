@@ -0,0 +1,191 @@
+#include <reactor/FdChannel.hh>
+
+#include <util/AutoFd.hh>
+#include <util/Pipe.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h> // getpid()
+
+using namespace util;
+using namespace reactor;
+
+class FdChannelTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FdChannelTester);
+	CPPUNIT_TEST(testPassFds);
+	CPPUNIT_TEST(testQueued);
+	CPPUNIT_TEST(testPeerClose);
+	CPPUNIT_TEST(testEmptyPayload);
+	CPPUNIT_TEST(testStreamRefused);
+	CPPUNIT_TEST(testAbstractAddress);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	FdChannel *sender_;
+	FdChannel *receiver_;
+	std::string data_;
+	std::vector<AutoFd *> fds_;
+	size_t messages_;
+	size_t closeCount_;
+
+	void
+	onReceive(const FdChannel::Message &message)
+	{
+		data_.assign(message.data, message.length);
+		for (FdChannel::Fds::const_iterator i(message.fds.begin()); i != message.fds.end(); ++i) {
+			fds_.push_back(new AutoFd(i->get()));
+		}
+		++messages_;
+	}
+
+	void onClose(FdChannel &) { ++closeCount_; }
+
+	void
+	clearFds()
+	{
+		for (size_t i = 0; i < fds_.size(); ++i) {
+			delete fds_[i];
+		}
+		fds_.clear();
+	}
+
+public:
+	void
+	setUp()
+	{
+		Socket first(Socket::SEQPACKET), second(Socket::SEQPACKET);
+
+		Socket::pair(first, second);
+		disp_ = new MyDispatcher();
+		sender_ = new FdChannel(*disp_, commandForMethod(*this, &FdChannelTester::onReceive));
+		receiver_ = new FdChannel(*disp_, commandForMethod(*this, &FdChannelTester::onReceive));
+		receiver_->setCloseCommand(commandForMethod(*this, &FdChannelTester::onClose));
+		sender_->adopt(Fd(first.release()));
+		receiver_->adopt(Fd(second.release()));
+		data_.clear();
+		messages_ = closeCount_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		clearFds();
+		delete receiver_;
+		delete sender_;
+		delete disp_;
+	}
+
+	void
+	testPassFds()
+	{
+		Pipe pipe;
+		FdChannel::Fds fds;
+		char c = 0;
+
+		fds.push_back(pipe.readFd());
+		fds.push_back(pipe.writeFd());
+		sender_->send(fds, "conn", 4);
+		disp_->stepSingleThread();
+
+		CPPUNIT_ASSERT_EQUAL((size_t)1, messages_);
+		CPPUNIT_ASSERT_EQUAL(std::string("conn"), data_);
+		CPPUNIT_ASSERT_EQUAL((size_t)2, fds_.size());
+		CPPUNIT_ASSERT(fds_[0]->get() != pipe.readFd().get());
+
+		// the received write end feeds the original read end
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fds_[1]->write("x", 1));
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pipe.readFd().read(&c, 1));
+		CPPUNIT_ASSERT_EQUAL('x', c);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, receiver_->truncated());
+	}
+
+	void
+	testQueued()
+	{
+		Pipe pipe;
+		FdChannel::Fds fds;
+		std::string payload(1024, 'q');
+		size_t sent = 0;
+
+		fds.push_back(pipe.writeFd());
+		while (!sender_->queued()) {
+			sender_->send(fds, payload.data(), payload.size());
+			++sent;
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)1, sender_->queued());
+
+		while (messages_ < sent) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)0, sender_->queued());
+		CPPUNIT_ASSERT_EQUAL(sent, fds_.size());
+	}
+
+	void
+	testPeerClose()
+	{
+		sender_->send(FdChannel::Fds(), "bye", 3);
+		sender_->close();
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, messages_);
+		CPPUNIT_ASSERT_EQUAL(std::string("bye"), data_);
+		CPPUNIT_ASSERT_EQUAL(false, receiver_->open());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, closeCount_);
+	}
+
+	void
+	testEmptyPayload()
+	{
+		Pipe pipe;
+		FdChannel::Fds fds;
+
+		CPPUNIT_ASSERT_THROW(sender_->send(fds), std::invalid_argument);
+		fds.push_back(pipe.readFd());
+		sender_->send(fds);
+		data_ = "stale";
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, messages_);
+		CPPUNIT_ASSERT_EQUAL(std::string(), data_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fds_.size());
+		CPPUNIT_ASSERT_EQUAL(true, receiver_->open());
+	}
+
+	void
+	testStreamRefused()
+	{
+		Socket first(Socket::STREAM), second(Socket::STREAM);
+		FdChannel channel(*disp_, commandForMethod(*this, &FdChannelTester::onReceive));
+
+		Socket::pair(first, second);
+		CPPUNIT_ASSERT_THROW(channel.adopt(first.fd()), std::invalid_argument);
+		CPPUNIT_ASSERT_EQUAL(false, channel.open());
+	}
+
+	void
+	testAbstractAddress()
+	{
+		net::Address address(net::Address::abstract("reactor-FdChannelTester-" + std::to_string(getpid())));
+		Socket listener(Socket::SEQPACKET);
+		FdChannel client(*disp_, commandForMethod(*this, &FdChannelTester::onReceive));
+
+		CPPUNIT_ASSERT_EQUAL('@', address.toString()[0]);
+		listener.bind(address);
+		listener.listen(1);
+		client.connect(address);
+
+		AutoFd accepted(accept(listener.fd().get(), 0, 0));
+		char c = 0;
+
+		client.send(FdChannel::Fds(), "a", 1);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, accepted.read(&c, 1));
+		CPPUNIT_ASSERT_EQUAL('a', c);
+		CPPUNIT_ASSERT(listener.localAddress() == address);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FdChannelTester);
@@ -4,9 +4,13 @@
 
 #include <tests/unit/mock/MockedFunction.hh>
 #include <tests/unit/mock/unistd.h>
+#include <tests/unit/mock/uio.h>
 
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <cerrno>
+#include <cstdio> // tmpfile()
+#include <string>
 #include <fcntl.h>
 
 using namespace util;
@@ -16,6 +20,11 @@ class FdTester : public CppUnit::TestFixture {
 	CPPUNIT_TEST(testConstruction);
 	CPPUNIT_TEST(testRead);
 	CPPUNIT_TEST(testWrite);
+	CPPUNIT_TEST(testReadv);
+	CPPUNIT_TEST(testWritev);
+	CPPUNIT_TEST(testTryRead);
+	CPPUNIT_TEST(testTryWritev);
+	CPPUNIT_TEST(testReadWriteAt);
 	CPPUNIT_TEST(testClose);
 	CPPUNIT_TEST(testGetBlocking);
 	CPPUNIT_TEST(testSetBlockingThrows);
@@ -56,6 +65,90 @@ public:
 		CPPUNIT_ASSERT_EQUAL(sizeof(buf), fd.write(buf, sizeof(buf)));
 	}
 
+	void
+	testReadv()
+	{
+		MOCK_FUNCTION_DEFAULT(readv);
+		Fd fd(44);
+		struct iovec iov[3];
+
+		readv->expectf("%d%p%d%d", 44, (void *)iov, 3, -1);
+		CPPUNIT_ASSERT_THROW(fd.readv(iov, 3), ErrnoException);
+		readv->expectf("%d%p%d%d", 44, (void *)iov, 3, 12);
+		CPPUNIT_ASSERT_EQUAL((size_t)12, fd.readv(iov, 3));
+	}
+
+	void
+	testWritev()
+	{
+		MOCK_FUNCTION_DEFAULT(writev);
+		Fd fd(79);
+		struct iovec iov[2];
+
+		writev->expectf("%d%p%d%d", 79, (void *)iov, 2, -1);
+		CPPUNIT_ASSERT_THROW(fd.writev(iov, 2), ErrnoException);
+		writev->expectf("%d%p%d%d", 79, (void *)iov, 2, 7);
+		CPPUNIT_ASSERT_EQUAL((size_t)7, fd.writev(iov, 2));
+	}
+
+	void
+	testTryRead()
+	{
+		MOCK_FUNCTION_DEFAULT(read);
+		Fd fd(46);
+		char buf[8];
+
+		read->expectf("%d%p%d%d", 46, (void *)buf, (int)sizeof(buf), -1);
+		errno = EAGAIN;
+		IoResult result(fd.tryRead(buf, sizeof(buf)));
+		CPPUNIT_ASSERT_EQUAL(false, result.ok());
+		CPPUNIT_ASSERT_EQUAL(EAGAIN, result.error());
+		CPPUNIT_ASSERT_EQUAL(true, result.wouldBlock());
+		CPPUNIT_ASSERT_EQUAL(true, result.transient());
+		CPPUNIT_ASSERT_THROW(result.check("read"), ErrnoException);
+
+		read->expectf("%d%p%d%d", 46, (void *)buf, (int)sizeof(buf), 5);
+		result = fd.tryRead(buf, sizeof(buf));
+		CPPUNIT_ASSERT_EQUAL(true, result.ok());
+		CPPUNIT_ASSERT_EQUAL((size_t)5, result.bytes());
+		CPPUNIT_ASSERT_EQUAL((size_t)5, result.check("read"));
+	}
+
+	void
+	testTryWritev()
+	{
+		MOCK_FUNCTION_DEFAULT(writev);
+		Fd fd(81);
+		struct iovec iov[2];
+
+		writev->expectf("%d%p%d%d", 81, (void *)iov, 2, -1);
+		errno = EPIPE;
+		IoResult result(fd.tryWritev(iov, 2));
+		CPPUNIT_ASSERT_EQUAL(EPIPE, result.error());
+		CPPUNIT_ASSERT_EQUAL(false, result.transient());
+
+		writev->expectf("%d%p%d%d", 81, (void *)iov, 2, 3);
+		CPPUNIT_ASSERT_EQUAL((size_t)3, fd.tryWritev(iov, 2).bytes());
+	}
+
+	void
+	testReadWriteAt()
+	{
+		FILE *file = tmpfile();
+		Fd fd(fileno(file));
+		char buf[4] = { 0 };
+
+		CPPUNIT_ASSERT_EQUAL((size_t)6, fd.writeAt("abcdef", 6, 0));
+		CPPUNIT_ASSERT_EQUAL((size_t)2, fd.writeAt("XY", 2, 2));
+		CPPUNIT_ASSERT_EQUAL((size_t)3, fd.readAt(buf, 3, 1));
+		CPPUNIT_ASSERT_EQUAL(std::string("bXY"), std::string(buf));
+		CPPUNIT_ASSERT_EQUAL((size_t)0, fd.tryReadAt(buf, 3, 100).bytes());
+		// the file offset is untouched
+		CPPUNIT_ASSERT_EQUAL((off_t)0, lseek(fd.get(), 0, SEEK_CUR));
+		CPPUNIT_ASSERT_THROW(Fd().readAt(buf, 3, 0), ErrnoException);
+		fclose(file);
+	}
+
 	void
 	testClose()
 	{
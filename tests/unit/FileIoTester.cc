@@ -0,0 +1,147 @@
+#include <reactor/FileIo.hh>
+
+#include <util/BufferPool.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdio> // tmpfile()
+#include <cstring> // memset()
+#include <string>
+
+using namespace util;
+using namespace reactor;
+
+class FileIoTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FileIoTester);
+	CPPUNIT_TEST(testRing);
+	CPPUNIT_TEST(testOffload);
+	CPPUNIT_TEST(testDepth);
+	CPPUNIT_TEST(testCancel);
+	CPPUNIT_TEST(testError);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	FILE *file_;
+	size_t completions_;
+	size_t bytes_;
+	int error_;
+
+	void
+	onDone(const FileIo::Completion &completion)
+	{
+		++completions_;
+		bytes_ += completion.result.bytes();
+		error_ = completion.result.error();
+	}
+
+	void
+	run(size_t completions)
+	{
+		while (completions_ < completions) {
+			disp_->stepSingleThread();
+		}
+	}
+
+	void
+	roundTrip(FileIo &io)
+	{
+		Fd fd(fileno(file_));
+		char buf[6];
+
+		memset(buf, 0, sizeof(buf));
+		CPPUNIT_ASSERT(io.writeAt(fd, "hello world", 11, 0, commandForMethod(*this, &FileIoTester::onDone)));
+		run(1);
+		CPPUNIT_ASSERT(io.readAt(fd, buf, 5, 6, commandForMethod(*this, &FileIoTester::onDone)));
+		CPPUNIT_ASSERT_EQUAL((size_t)1, io.inflight());
+		run(2);
+
+		CPPUNIT_ASSERT_EQUAL((size_t)16, bytes_);
+		CPPUNIT_ASSERT_EQUAL(std::string("world"), std::string(buf));
+		CPPUNIT_ASSERT_EQUAL((size_t)0, io.inflight());
+	}
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		file_ = tmpfile();
+		completions_ = bytes_ = 0;
+		error_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		fclose(file_);
+		delete disp_;
+	}
+
+	void
+	testRing()
+	{
+		FileIo io(*disp_);
+
+		// io_uring may be forbidden here, the fallback is covered below
+		if (io.backend() == FileIo::RING) {
+			roundTrip(io);
+		}
+	}
+
+	void
+	testOffload()
+	{
+		FileIo io(*disp_, 0, FileIo::DEFAULT_DEPTH, FileIo::OFFLOAD);
+
+		CPPUNIT_ASSERT_EQUAL(FileIo::OFFLOAD, io.backend());
+		roundTrip(io);
+	}
+
+	void
+	testDepth()
+	{
+		FileIo io(*disp_, 0, 2);
+		Fd fd(fileno(file_));
+		char buf[3][4];
+
+		CPPUNIT_ASSERT(io.readAt(fd, buf[0], 4, 0, commandForMethod(*this, &FileIoTester::onDone)));
+		CPPUNIT_ASSERT(io.readAt(fd, buf[1], 4, 0, commandForMethod(*this, &FileIoTester::onDone)));
+		CPPUNIT_ASSERT(!io.readAt(fd, buf[2], 4, 0, commandForMethod(*this, &FileIoTester::onDone)));
+		run(2);
+		CPPUNIT_ASSERT(io.readAt(fd, buf[2], 4, 0, commandForMethod(*this, &FileIoTester::onDone)));
+		run(3);
+	}
+
+	void
+	testCancel()
+	{
+		FileIo io(*disp_);
+		Fd fd(fileno(file_));
+		char buf[4];
+		void *pooled = BufferPool::instance().allocate(4096);
+
+		CPPUNIT_ASSERT(io.readAt(fd, pooled, 4096, 0, commandForMethod(*this, &FileIoTester::onDone), this));
+		CPPUNIT_ASSERT(io.readAt(fd, buf, 4, 0, commandForMethod(*this, &FileIoTester::onDone)));
+		io.cancel(this, true);
+		run(1);
+		while (io.inflight()) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)1, completions_);
+	}
+
+	void
+	testError()
+	{
+		FileIo io(*disp_, 0, FileIo::DEFAULT_DEPTH, FileIo::OFFLOAD);
+		char buf[4];
+
+		CPPUNIT_ASSERT(io.readAt(Fd(), buf, 4, 0, commandForMethod(*this, &FileIoTester::onDone)));
+		run(1);
+		CPPUNIT_ASSERT_EQUAL(EBADF, error_);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FileIoTester);
@@ -0,0 +1,221 @@
+#include <reactor/FileReader.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cerrno>
+#include <cstdio> // tmpfile()
+#include <memory> // unique_ptr
+#include <string>
+
+using namespace util;
+using namespace reactor;
+
+class FileReaderTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FileReaderTester);
+	CPPUNIT_TEST(testStreamRing);
+	CPPUNIT_TEST(testStreamOffload);
+	CPPUNIT_TEST(testRange);
+	CPPUNIT_TEST(testPause);
+	CPPUNIT_TEST(testStop);
+	CPPUNIT_TEST(testError);
+	CPPUNIT_TEST(testSharedDepth);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	FILE *file_;
+	std::string contents_;
+	std::string data_;
+	std::unique_ptr<IoResult> end_;
+	size_t chunks_;
+	size_t firstOffset_;
+	bool stopInData_;
+	FileReader *reader_;
+
+	void
+	onData(const FileReader::Chunk &chunk)
+	{
+		CPPUNIT_ASSERT_EQUAL((off_t)(firstOffset_ + data_.size()), chunk.offset);
+		data_.append(chunk.data, chunk.length);
+		++chunks_;
+		if (stopInData_) {
+			reader_->stop();
+		}
+	}
+
+	void onEnd(const IoResult &result) { end_.reset(new IoResult(result)); }
+	void onOther(const FileIo::Completion &) {}
+
+	void
+	run()
+	{
+		while (!end_) {
+			disp_->stepSingleThread();
+		}
+	}
+
+	void
+	stream(FileIo &io)
+	{
+		FileReader reader(io, commandForMethod(*this, &FileReaderTester::onData), commandForMethod(*this, &FileReaderTester::onEnd));
+
+		reader_ = &reader;
+		reader.setChunkSize(4096);
+		reader.setReadAhead(8);
+		reader.start(Fd(fileno(file_)));
+		CPPUNIT_ASSERT_EQUAL((size_t)8, reader.buffered());
+		run();
+
+		CPPUNIT_ASSERT(end_->ok());
+		CPPUNIT_ASSERT_EQUAL(contents_.size(), end_->bytes());
+		CPPUNIT_ASSERT(contents_ == data_);
+		CPPUNIT_ASSERT_EQUAL((size_t)25, chunks_);
+		CPPUNIT_ASSERT(!reader.reading());
+		reader_ = 0;
+	}
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		file_ = tmpfile();
+		contents_.clear();
+		for (size_t i = 0; contents_.size() < 100000; ++i) {
+			contents_.append(std::to_string(i)).append(1, '\n');
+		}
+		contents_.resize(100000);
+		Fd(fileno(file_)).writeAt(contents_.data(), contents_.size(), 0);
+		data_.clear();
+		end_.reset();
+		chunks_ = 0;
+		stopInData_ = false;
+		reader_ = 0;
+		firstOffset_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		fclose(file_);
+		delete disp_;
+	}
+
+	void
+	testStreamRing()
+	{
+		FileIo io(*disp_);
+
+		stream(io);
+	}
+
+	void
+	testStreamOffload()
+	{
+		OffloadPool pool(4);
+		FileIo io(*disp_, &pool, FileIo::DEFAULT_DEPTH, FileIo::OFFLOAD);
+
+		// several threads complete out of order, delivery stays in file order
+		stream(io);
+	}
+
+	void
+	testRange()
+	{
+		FileIo io(*disp_);
+		FileReader reader(io, commandForMethod(*this, &FileReaderTester::onData), commandForMethod(*this, &FileReaderTester::onEnd));
+
+		reader_ = &reader;
+		firstOffset_ = 1000;
+		reader.setChunkSize(3000);
+		reader.start(Fd(fileno(file_)), 1000, 10000);
+		run();
+		CPPUNIT_ASSERT_EQUAL((size_t)10000, end_->bytes());
+		CPPUNIT_ASSERT(contents_.substr(1000, 10000) == data_);
+		CPPUNIT_ASSERT_EQUAL((size_t)4, chunks_);
+	}
+
+	void
+	testPause()
+	{
+		FileIo io(*disp_);
+		FileReader reader(io, commandForMethod(*this, &FileReaderTester::onData), commandForMethod(*this, &FileReaderTester::onEnd));
+
+		reader_ = &reader;
+		reader.start(Fd(fileno(file_)));
+		reader.pause();
+		while (io.inflight()) {
+			disp_->stepSingleThread();
+		}
+		// the whole window was read ahead before the end of the file showed up
+		CPPUNIT_ASSERT_EQUAL((size_t)0, chunks_);
+		CPPUNIT_ASSERT_EQUAL(FileReader::DEFAULT_READ_AHEAD, reader.buffered());
+
+		reader.resume();
+		run();
+		CPPUNIT_ASSERT(contents_ == data_);
+	}
+
+	void
+	testStop()
+	{
+		FileIo io(*disp_);
+		FileReader reader(io, commandForMethod(*this, &FileReaderTester::onData), commandForMethod(*this, &FileReaderTester::onEnd));
+
+		reader_ = &reader;
+		stopInData_ = true;
+		reader.setChunkSize(1024);
+		reader.start(Fd(fileno(file_)));
+		while (!chunks_) {
+			disp_->stepSingleThread();
+		}
+		while (io.inflight()) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)1, chunks_);
+		CPPUNIT_ASSERT(!end_);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, reader.buffered());
+
+		stopInData_ = false;
+		data_.clear();
+		chunks_ = 0;
+		reader.start(Fd(fileno(file_)));
+		run();
+		CPPUNIT_ASSERT(contents_ == data_);
+	}
+
+	void
+	testError()
+	{
+		FileIo io(*disp_);
+		FileReader reader(io, commandForMethod(*this, &FileReaderTester::onData), commandForMethod(*this, &FileReaderTester::onEnd));
+
+		reader.start(Fd());
+		run();
+		CPPUNIT_ASSERT_EQUAL(EBADF, end_->error());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, chunks_);
+	}
+
+	void
+	testSharedDepth()
+	{
+		FileIo io(*disp_, 0, 2);
+		FileReader reader(io, commandForMethod(*this, &FileReaderTester::onData), commandForMethod(*this, &FileReaderTester::onEnd));
+		char other[2][16];
+
+		// another user holds the whole depth, the reader waits for it
+		CPPUNIT_ASSERT(io.readAt(Fd(fileno(file_)), other[0], sizeof(other[0]), 0, commandForMethod(*this, &FileReaderTester::onOther)));
+		CPPUNIT_ASSERT(io.readAt(Fd(fileno(file_)), other[1], sizeof(other[1]), 0, commandForMethod(*this, &FileReaderTester::onOther)));
+		reader_ = &reader;
+		reader.start(Fd(fileno(file_)));
+		CPPUNIT_ASSERT(reader.reading());
+		CPPUNIT_ASSERT(!end_);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, reader.buffered());
+		run();
+		CPPUNIT_ASSERT(end_->ok());
+		CPPUNIT_ASSERT(contents_ == data_);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FileReaderTester);
@@ -0,0 +1,186 @@
+#include <reactor/FileWatcher.hh>
+
+#include <util/AutoFd.hh>
+#include <util/ErrnoException.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdlib> // mkdtemp()
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace util;
+using namespace reactor;
+
+class FileWatcherTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FileWatcherTester);
+	CPPUNIT_TEST(testCoalesce);
+	CPPUNIT_TEST(testSelfRemoval);
+	CPPUNIT_TEST(testRename);
+	CPPUNIT_TEST(testRemove);
+	CPPUNIT_TEST(testMissingPath);
+	CPPUNIT_TEST_SUITE_END();
+
+	struct Seen {
+		int watch;
+		std::string name;
+		uint32_t mask;
+		uint32_t cookie;
+
+		Seen(const FileWatcher::Event &event)
+		: watch(event.watch)
+		, name(event.name)
+		, mask(event.mask)
+		, cookie(event.cookie)
+		{}
+	};
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	FileWatcher *watcher_;
+	std::string dir_;
+	std::vector<Seen> seen_;
+
+	void onEvent(const FileWatcher::Event &event) { seen_.push_back(Seen(event)); }
+
+	void
+	writeFile(const std::string &name, size_t writes)
+	{
+		AutoFd fd(open((dir_ + "/" + name).c_str(), O_WRONLY | O_CREAT | O_APPEND, 0600));
+
+		for (size_t i = 0; i < writes; ++i) {
+			fd.write("x", 1);
+		}
+	}
+
+	void
+	run()
+	{
+		while (seen_.empty()) {
+			disp_->stepSingleThread();
+		}
+	}
+
+public:
+	void
+	setUp()
+	{
+		char dir[] = "/tmp/FileWatcherTester.XXXXXX";
+
+		CPPUNIT_ASSERT(mkdtemp(dir));
+		dir_ = dir;
+		disp_ = new MyDispatcher();
+		watcher_ = new FileWatcher(*disp_);
+		seen_.clear();
+	}
+
+	void
+	tearDown()
+	{
+		delete watcher_;
+		delete disp_;
+		unlink((dir_ + "/a").c_str());
+		unlink((dir_ + "/b").c_str());
+		rmdir(dir_.c_str());
+	}
+
+	void
+	testCoalesce()
+	{
+		int watch = watcher_->add(dir_, IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE, commandForMethod(*this, &FileWatcherTester::onEvent));
+
+		{
+			AutoFd a(open((dir_ + "/a").c_str(), O_WRONLY | O_CREAT, 0600));
+			AutoFd b(open((dir_ + "/b").c_str(), O_WRONLY | O_CREAT, 0600));
+
+			// interleaved, so the kernel cannot fold the writes itself
+			for (size_t i = 0; i < 5; ++i) {
+				a.write("x", 1);
+				b.write("x", 1);
+			}
+		}
+		run();
+
+		CPPUNIT_ASSERT_EQUAL((size_t)6, seen_.size());
+		CPPUNIT_ASSERT_EQUAL(watch, seen_[0].watch);
+		CPPUNIT_ASSERT_EQUAL(std::string("a"), seen_[0].name);
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_CREATE, seen_[0].mask);
+		CPPUNIT_ASSERT_EQUAL(std::string("b"), seen_[1].name);
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_CREATE, seen_[1].mask);
+		// the writes to each file collapse into the first, the closes stay behind them
+		CPPUNIT_ASSERT_EQUAL(std::string("a"), seen_[2].name);
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_MODIFY, seen_[2].mask);
+		CPPUNIT_ASSERT_EQUAL(std::string("b"), seen_[3].name);
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_MODIFY, seen_[3].mask);
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_CLOSE_WRITE, seen_[4].mask);
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_CLOSE_WRITE, seen_[5].mask);
+		CPPUNIT_ASSERT_EQUAL((size_t)8, watcher_->coalesced());
+	}
+
+	void
+	testSelfRemoval()
+	{
+		std::string file(dir_ + "/a");
+
+		writeFile("a", 0);
+		watcher_->add(file, IN_DELETE_SELF, commandForMethod(*this, &FileWatcherTester::onEvent));
+		unlink(file.c_str());
+		run();
+
+		// the deletion and the kernel dropping the watch arrive together, in that order
+		CPPUNIT_ASSERT_EQUAL((size_t)2, seen_.size());
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_DELETE_SELF, seen_[0].mask);
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_IGNORED, seen_[1].mask);
+		CPPUNIT_ASSERT(seen_[0].name.empty());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, watcher_->size());
+	}
+
+	void
+	testRename()
+	{
+		watcher_->add(dir_, IN_MOVED_FROM | IN_MOVED_TO, commandForMethod(*this, &FileWatcherTester::onEvent));
+		writeFile("a", 0);
+		rename((dir_ + "/a").c_str(), (dir_ + "/b").c_str());
+		rename((dir_ + "/b").c_str(), (dir_ + "/a").c_str());
+		run();
+
+		// each move keeps its own cookie, nothing is merged across them
+		CPPUNIT_ASSERT_EQUAL((size_t)4, seen_.size());
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_MOVED_FROM, seen_[0].mask);
+		CPPUNIT_ASSERT_EQUAL(std::string("a"), seen_[0].name);
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_MOVED_TO, seen_[1].mask);
+		CPPUNIT_ASSERT_EQUAL(seen_[0].cookie, seen_[1].cookie);
+		CPPUNIT_ASSERT_EQUAL(std::string("a"), seen_[3].name);
+		CPPUNIT_ASSERT(seen_[0].cookie != seen_[2].cookie);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, watcher_->coalesced());
+	}
+
+	void
+	testRemove()
+	{
+		int watch = watcher_->add(dir_, IN_CREATE, commandForMethod(*this, &FileWatcherTester::onEvent));
+
+		watcher_->add(dir_ + "/..", IN_CREATE, commandForMethod(*this, &FileWatcherTester::onEvent));
+		watcher_->remove(watch);
+		CPPUNIT_ASSERT_THROW(watcher_->remove(watch), std::runtime_error);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, watcher_->size());
+
+		writeFile("a", 1);
+		watch = watcher_->add(dir_, IN_DELETE, commandForMethod(*this, &FileWatcherTester::onEvent));
+		unlink((dir_ + "/a").c_str());
+		run();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, seen_.size());
+		CPPUNIT_ASSERT_EQUAL((uint32_t)IN_DELETE, seen_[0].mask);
+	}
+
+	void
+	testMissingPath()
+	{
+		CPPUNIT_ASSERT_THROW(watcher_->add(dir_ + "/missing", IN_MODIFY, commandForMethod(*this, &FileWatcherTester::onEvent)), ErrnoException);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FileWatcherTester);
@@ -0,0 +1,144 @@
+#include <util/IoBuffer.hh>
+
+#include <util/AutoFd.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+using namespace util;
+
+class IoBufferTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(IoBufferTester);
+	CPPUNIT_TEST(testConstruction);
+	CPPUNIT_TEST(testAppend);
+	CPPUNIT_TEST(testPrepend);
+	CPPUNIT_TEST(testConsume);
+	CPPUNIT_TEST(testSlice);
+	CPPUNIT_TEST(testSharing);
+	CPPUNIT_TEST(testReadWrite);
+	CPPUNIT_TEST_SUITE_END();
+
+	static std::string
+	contents(const IoBuffer &buffer)
+	{
+		std::string result(buffer.size(), '\0');
+
+		buffer.copyOut(&result[0], result.size());
+		return result;
+	}
+
+public:
+	void
+	testConstruction()
+	{
+		IoBuffer buffer;
+
+		CPPUNIT_ASSERT_EQUAL(true, buffer.empty());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, buffer.size());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, buffer.segmentCount());
+	}
+
+	void
+	testAppend()
+	{
+		IoBuffer buffer;
+		std::string big(IoBuffer::SEGMENT_SIZE + 10, 'x');
+
+		buffer.append("abc", 3);
+		buffer.append("def", 3);
+		CPPUNIT_ASSERT_EQUAL(std::string("abcdef"), contents(buffer));
+		CPPUNIT_ASSERT_EQUAL((size_t)1, buffer.segmentCount());
+		buffer.append(big.data(), big.size());
+		CPPUNIT_ASSERT_EQUAL(big.size() + 6, buffer.size());
+		CPPUNIT_ASSERT_EQUAL((size_t)2, buffer.segmentCount());
+		CPPUNIT_ASSERT_EQUAL(std::string("abcdef") + big, contents(buffer));
+	}
+
+	void
+	testPrepend()
+	{
+		IoBuffer buffer;
+
+		buffer.append("world", 5);
+		buffer.prepend("hello ", 6);
+		CPPUNIT_ASSERT_EQUAL(std::string("hello world"), contents(buffer));
+		buffer.prepend(">", 1);
+		CPPUNIT_ASSERT_EQUAL(std::string(">hello world"), contents(buffer));
+		CPPUNIT_ASSERT_EQUAL((size_t)2, buffer.segmentCount());
+	}
+
+	void
+	testConsume()
+	{
+		IoBuffer buffer;
+		std::string big(2 * IoBuffer::SEGMENT_SIZE, 'y');
+
+		buffer.append(big.data(), big.size());
+		buffer.append("tail", 4);
+		buffer.consume(IoBuffer::SEGMENT_SIZE + 1);
+		CPPUNIT_ASSERT_EQUAL(IoBuffer::SEGMENT_SIZE + 3, buffer.size());
+		CPPUNIT_ASSERT_EQUAL((size_t)2, buffer.segmentCount());
+		CPPUNIT_ASSERT_THROW(buffer.consume(buffer.size() + 1), std::out_of_range);
+		buffer.consume(buffer.size());
+		CPPUNIT_ASSERT_EQUAL(true, buffer.empty());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, buffer.segmentCount());
+	}
+
+	void
+	testSlice()
+	{
+		IoBuffer buffer;
+
+		buffer.append("0123456789", 10);
+		CPPUNIT_ASSERT_EQUAL(std::string("345"), contents(buffer.slice(3, 3)));
+		CPPUNIT_ASSERT_EQUAL(std::string(""), contents(buffer.slice(10, 0)));
+		CPPUNIT_ASSERT_THROW(buffer.slice(8, 3), std::out_of_range);
+	}
+
+	void
+	testSharing()
+	{
+		IoBuffer a;
+
+		a.append("shared", 6);
+
+		IoBuffer b(a);
+
+		a.append("-a", 2);
+		b.append("-b", 2);
+		b.prepend("<", 1);
+		CPPUNIT_ASSERT_EQUAL(std::string("shared-a"), contents(a));
+		CPPUNIT_ASSERT_EQUAL(std::string("<shared-b"), contents(b));
+
+		a.append(b);
+		CPPUNIT_ASSERT_EQUAL(std::string("shared-a<shared-b"), contents(a));
+		b.clear();
+		CPPUNIT_ASSERT_EQUAL(std::string("shared-a<shared-b"), contents(a));
+	}
+
+	void
+	testReadWrite()
+	{
+		int fds[2];
+
+		CPPUNIT_ASSERT_EQUAL(0, pipe(fds));
+
+		AutoFd r(fds[0]), w(fds[1]);
+		IoBuffer out, in;
+		std::string big(3 * IoBuffer::SEGMENT_SIZE + 5, 'z');
+
+		out.append("head", 4);
+		out.append(big.data(), big.size());
+		CPPUNIT_ASSERT_EQUAL(big.size() + 4, out.writeTo(w));
+		CPPUNIT_ASSERT_EQUAL(true, out.empty());
+
+		in.append("pre", 3);
+		CPPUNIT_ASSERT_EQUAL(big.size() + 4, in.readFrom(r, 2 * big.size()));
+		CPPUNIT_ASSERT_EQUAL(std::string("prehead") + big, contents(in));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(IoBufferTester);
@@ -0,0 +1,171 @@
+#include <reactor/Dispatcher.hh>
+#include <reactor/LoopMetrics.hh>
+
+#include <util/Pipe.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <memory> // unique_ptr
+
+using namespace util;
+using namespace reactor;
+
+class LoopMetricsTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(LoopMetricsTester);
+	CPPUNIT_TEST(testBuckets);
+	CPPUNIT_TEST(testRecord);
+	CPPUNIT_TEST(testAlignment);
+	CPPUNIT_TEST(testDispatcher);
+	CPPUNIT_TEST(testDisabled);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	Pipe *pipe_;
+	size_t reads_;
+	size_t fired_;
+
+	void
+	onReadable(const FdEvent &event)
+	{
+		char c;
+
+		event.fd.read(&c, 1);
+		++reads_;
+	}
+
+	void onTimer(const TimerEvent &) { ++fired_; }
+
+	void
+	step()
+	{
+		disp_->add(FdEvent(pipe_->readFd(), FdEvent::READ), commandForMethod(*this, &LoopMetricsTester::onReadable));
+		disp_->add(Timer(DiffTime::ms(-5), 1), commandForMethod(*this, &LoopMetricsTester::onTimer));
+		pipe_->write("x", 1);
+		disp_->stepSingleThread();
+		disp_->remove(FdEvent(pipe_->readFd(), FdEvent::READ));
+	}
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		pipe_ = new Pipe();
+		reads_ = fired_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		delete pipe_;
+		delete disp_;
+	}
+
+	void
+	testBuckets()
+	{
+		LoopMetrics::HistogramSnapshot h = LoopMetrics::HistogramSnapshot();
+
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, LoopMetrics::HistogramSnapshot::upperBound(0));
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, LoopMetrics::HistogramSnapshot::upperBound(1));
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1023, LoopMetrics::HistogramSnapshot::upperBound(10));
+		CPPUNIT_ASSERT_EQUAL(UINT64_MAX, LoopMetrics::HistogramSnapshot::upperBound(LoopMetrics::BUCKETS - 1));
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, h.percentile(0.5));
+
+		h.counts[1] = 90;
+		h.counts[10] = 10;
+		CPPUNIT_ASSERT_EQUAL((uint64_t)100, h.total());
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, h.percentile(0.5));
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, h.percentile(0.9));
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1023, h.percentile(0.99));
+	}
+
+	void
+	testRecord()
+	{
+		LoopMetrics metrics;
+
+		metrics.recordWait(0, 1);
+		metrics.recordWait(700, 3);
+		metrics.recordBacklog(5);
+		metrics.recordBacklog(2);
+		metrics.recordRun(40, 6);
+		metrics.recordTimer(DiffTime::ms(2));
+		metrics.recordTimer(DiffTime::ms(-1));
+
+		LoopMetrics::Snapshot snapshot(metrics.snapshot());
+
+		CPPUNIT_ASSERT_EQUAL((uint64_t)2, snapshot.iterations);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)4, snapshot.events);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)700, snapshot.blockedTime);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)5, snapshot.maxBacklog);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)6, snapshot.jobs);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)40, snapshot.runningTime);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)2, snapshot.timersFired);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.blocked.counts[0]);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.blocked.counts[10]);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.eventsPerIteration.counts[2]);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.backlog.counts[3]);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.jobsPerIteration.counts[3]);
+		// an early timer counts as on time, 2ms lands in [1024, 2047]us
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.lateness.counts[0]);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.lateness.counts[11]);
+
+		metrics.reset();
+		snapshot = metrics.snapshot();
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, snapshot.iterations);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, snapshot.maxBacklog);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, snapshot.lateness.total());
+	}
+
+	void
+	testAlignment()
+	{
+		std::unique_ptr<LoopMetrics> metrics(new LoopMetrics());
+
+		CPPUNIT_ASSERT_EQUAL((size_t)0, (size_t)metrics.get() % 64);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, sizeof(LoopMetrics) % 64);
+	}
+
+	void
+	testDispatcher()
+	{
+		disp_->setMetricsEnabled(true);
+		CPPUNIT_ASSERT_EQUAL(true, disp_->metricsEnabled());
+		step();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, reads_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, fired_);
+
+		LoopMetrics::Snapshot snapshot(disp_->metrics());
+
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.iterations);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.events);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)2, snapshot.jobs);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)2, snapshot.maxBacklog);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.timersFired);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)1, snapshot.running.total());
+		CPPUNIT_ASSERT(snapshot.lateness.percentile(1) >= 5000);
+
+		disp_->resetMetrics();
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, disp_->metrics().iterations);
+	}
+
+	void
+	testDisabled()
+	{
+		step();
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, disp_->metrics().iterations);
+
+		disp_->setMetricsEnabled(true);
+		disp_->setMetricsEnabled(false);
+		step();
+		CPPUNIT_ASSERT_EQUAL(false, disp_->metricsEnabled());
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, disp_->metrics().iterations);
+		CPPUNIT_ASSERT_EQUAL((uint64_t)0, disp_->metrics().timersFired);
+		CPPUNIT_ASSERT_EQUAL((size_t)2, fired_);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LoopMetricsTester);
@@ -0,0 +1,212 @@
+#include <reactor/OffloadPool.hh>
+
+#include <util/Pipe.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace util;
+using namespace reactor;
+
+class OffloadPoolTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(OffloadPoolTester);
+	CPPUNIT_TEST(testCompletion);
+	CPPUNIT_TEST(testBackpressure);
+	CPPUNIT_TEST(testParked);
+	CPPUNIT_TEST(testParkedDropped);
+	CPPUNIT_TEST(testPost);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	OffloadPool *pool_;
+	std::thread::id loopThread_;
+	std::atomic<size_t> worked_;
+	std::atomic<bool> released_;
+	size_t completions_;
+	size_t wrongThread_;
+	size_t readable_;
+	std::string failure_;
+	Pipe *pipe_;
+
+	void
+	work()
+	{
+		while (!released_) {
+			std::this_thread::yield();
+		}
+		++worked_;
+	}
+
+	void failingWork() { throw std::runtime_error("work failed"); }
+
+	void
+	complete(const std::exception_ptr &error)
+	{
+		if (std::this_thread::get_id() != loopThread_) {
+			++wrongThread_;
+		}
+		if (error) {
+			try {
+				std::rethrow_exception(error);
+			} catch (const std::runtime_error &e) {
+				failure_ = e.what();
+			}
+		}
+		++completions_;
+	}
+
+	void posted() { complete(std::exception_ptr()); }
+
+	void
+	onReadable(const FdEvent &event)
+	{
+		++readable_;
+		CPPUNIT_ASSERT(pool_->submit(*disp_, event, commandForMethod(*this, &OffloadPoolTester::work), commandForMethod(*this, &OffloadPoolTester::complete)));
+	}
+
+	void
+	run(size_t completions)
+	{
+		while (completions_ < completions) {
+			disp_->stepSingleThread();
+		}
+	}
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		pool_ = new OffloadPool(2, 4);
+		loopThread_ = std::this_thread::get_id();
+		worked_ = 0;
+		released_ = true;
+		completions_ = wrongThread_ = readable_ = 0;
+		pipe_ = 0;
+		failure_.clear();
+	}
+
+	void
+	tearDown()
+	{
+		released_ = true;
+		delete pool_;
+		delete pipe_;
+		delete disp_;
+	}
+
+	void
+	testCompletion()
+	{
+		for (size_t i = 0; i < 3; ++i) {
+			CPPUNIT_ASSERT(pool_->submit(*disp_, commandForMethod(*this, &OffloadPoolTester::work), commandForMethod(*this, &OffloadPoolTester::complete)));
+		}
+		CPPUNIT_ASSERT(pool_->submit(*disp_, commandForMethod(*this, &OffloadPoolTester::failingWork), commandForMethod(*this, &OffloadPoolTester::complete)));
+		run(4);
+
+		CPPUNIT_ASSERT_EQUAL((size_t)3, (size_t)worked_);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, wrongThread_);
+		CPPUNIT_ASSERT_EQUAL((size_t)4, pool_->completed());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->failed());
+		CPPUNIT_ASSERT_EQUAL(std::string("work failed"), failure_);
+		CPPUNIT_ASSERT(pool_->utilization() >= 0 && pool_->utilization() <= 1);
+	}
+
+	void
+	testBackpressure()
+	{
+		released_ = false;
+		for (size_t i = 0; i < 6; ++i) {
+			CPPUNIT_ASSERT(pool_->submit(*disp_, commandForMethod(*this, &OffloadPoolTester::work), commandForMethod(*this, &OffloadPoolTester::complete)));
+			// two workers take one job each, the other four wait in the queue
+			while (i < 2 && pool_->active() <= i) {
+				std::this_thread::yield();
+			}
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)4, pool_->queued());
+		CPPUNIT_ASSERT(!pool_->submit(*disp_, commandForMethod(*this, &OffloadPoolTester::work), commandForMethod(*this, &OffloadPoolTester::complete)));
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->refused());
+		CPPUNIT_ASSERT_EQUAL((size_t)4, pool_->maxQueued());
+
+		released_ = true;
+		run(6);
+		CPPUNIT_ASSERT_EQUAL((size_t)6, (size_t)worked_);
+	}
+
+	void
+	testParked()
+	{
+		pipe_ = new Pipe();
+		released_ = false;
+		disp_->add(FdEvent(pipe_->readFd(), FdEvent::READ), commandForMethod(*this, &OffloadPoolTester::onReadable));
+		pipe_->write("x", 1);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, readable_);
+
+		// still readable, but parked until the completion has run
+		released_ = true;
+		run(1);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, readable_);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)2, readable_);
+
+		run(2);
+		disp_->remove(FdEvent(pipe_->readFd(), FdEvent::READ));
+	}
+
+	void
+	testParkedDropped()
+	{
+		pipe_ = new Pipe();
+		released_ = false;
+		delete pool_;
+		pool_ = new OffloadPool(1, 4);
+		CPPUNIT_ASSERT(pool_->submit(*disp_, commandForMethod(*this, &OffloadPoolTester::work), commandForMethod(*this, &OffloadPoolTester::complete)));
+		while (!pool_->active()) {
+			std::this_thread::yield();
+		}
+		disp_->add(FdEvent(pipe_->readFd(), FdEvent::READ), commandForMethod(*this, &OffloadPoolTester::onReadable));
+		pipe_->write("x", 1);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, pool_->queued());
+
+		// let the running work finish only once the pool is stopping, the parked job stays queued
+		std::thread deleter([this]() { delete pool_; });
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		released_ = true;
+		deleter.join();
+		pool_ = new OffloadPool(1, 4);
+
+		for (size_t i = 0; i < 3; ++i) {
+			disp_->post(commandForMethod(*this, &OffloadPoolTester::posted));
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)2, readable_);
+		disp_->remove(FdEvent(pipe_->readFd(), FdEvent::READ));
+	}
+
+	void
+	testPost()
+	{
+		std::thread poster([this]() {
+			for (size_t i = 0; i < 100; ++i) {
+				disp_->post(commandForMethod(*this, &OffloadPoolTester::posted));
+			}
+		});
+
+		poster.join();
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)100, completions_);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, wrongThread_);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(OffloadPoolTester);
@@ -0,0 +1,182 @@
+#include <reactor/Relay.hh>
+
+#include <util/AutoFd.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <sys/socket.h>
+
+using namespace util;
+using namespace reactor;
+
+class RelayTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(RelayTester);
+	CPPUNIT_TEST(testForward);
+	CPPUNIT_TEST(testBackpressure);
+	CPPUNIT_TEST(testHalfClose);
+	CPPUNIT_TEST(testReset);
+	CPPUNIT_TEST(testBothReset);
+	CPPUNIT_TEST(testDownstreamClosed);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	Relay *relay_;
+	AutoFd *client_;
+	AutoFd *server_;
+	size_t closeCount_;
+
+	void onClose(Relay &) { ++closeCount_; }
+
+	static std::string
+	drain(const AutoFd &fd)
+	{
+		std::string result;
+		char buf[4096];
+		ssize_t rd;
+
+		while ((rd = recv(fd.get(), buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+			result.append(buf, rd);
+		}
+		return result;
+	}
+
+public:
+	void
+	setUp()
+	{
+		int clientFds[2];
+		int serverFds[2];
+
+		CPPUNIT_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, clientFds));
+		CPPUNIT_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, serverFds));
+		disp_ = new MyDispatcher();
+		client_ = new AutoFd(clientFds[0]);
+		server_ = new AutoFd(serverFds[0]);
+		relay_ = new Relay(*disp_, Fd(clientFds[1]), Fd(serverFds[1]));
+		relay_->setCloseCommand(commandForMethod(*this, &RelayTester::onClose));
+		relay_->start();
+		closeCount_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		delete relay_;
+		delete server_;
+		delete client_;
+		delete disp_;
+	}
+
+	void
+	testForward()
+	{
+		CPPUNIT_ASSERT_EQUAL((size_t)5, client_->write("hello", 5));
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL(std::string("hello"), drain(*server_));
+		CPPUNIT_ASSERT_EQUAL((size_t)5, relay_->forwarded());
+
+		CPPUNIT_ASSERT_EQUAL((size_t)3, server_->write("bye", 3));
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL(std::string("bye"), drain(*client_));
+		CPPUNIT_ASSERT_EQUAL((size_t)3, relay_->returned());
+	}
+
+	void
+	testBackpressure()
+	{
+		std::string chunk(64 * 1024, 'b');
+		std::string sent, got;
+
+		for (size_t i = 0; i < 16; ++i) {
+			chunk[0] = 'a' + i;
+			for (size_t offset = 0; offset < chunk.size(); ) {
+				ssize_t wr = send(client_->get(), chunk.data() + offset, chunk.size() - offset, MSG_DONTWAIT);
+
+				if (wr > 0) {
+					offset += wr;
+				} else {
+					got += drain(*server_);
+					disp_->stepSingleThread();
+				}
+			}
+			sent += chunk;
+		}
+
+		while ((got += drain(*server_)).size() < sent.size()) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT(sent == got);
+		CPPUNIT_ASSERT_EQUAL(sent.size(), relay_->forwarded());
+	}
+
+	void
+	testHalfClose()
+	{
+		CPPUNIT_ASSERT_EQUAL((size_t)7, client_->write("request", 7));
+		CPPUNIT_ASSERT_EQUAL(0, shutdown(client_->get(), SHUT_WR));
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL(std::string("request"), drain(*server_));
+		disp_->stepSingleThread();
+
+		char c;
+		CPPUNIT_ASSERT_EQUAL((ssize_t)0, recv(server_->get(), &c, 1, MSG_DONTWAIT));
+		CPPUNIT_ASSERT_EQUAL(true, relay_->open());
+
+		CPPUNIT_ASSERT_EQUAL((size_t)8, server_->write("response", 8));
+		server_->reset();
+		while (relay_->open()) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL(std::string("response"), drain(*client_));
+		CPPUNIT_ASSERT_EQUAL((ssize_t)0, recv(client_->get(), &c, 1, MSG_DONTWAIT));
+		CPPUNIT_ASSERT_EQUAL((size_t)1, closeCount_);
+	}
+
+	void
+	testReset()
+	{
+		relay_->close();
+		CPPUNIT_ASSERT_EQUAL(false, relay_->open());
+		CPPUNIT_ASSERT_EQUAL((size_t)0, closeCount_);
+
+		char c;
+		CPPUNIT_ASSERT_EQUAL((ssize_t)0, recv(client_->get(), &c, 1, MSG_DONTWAIT));
+		CPPUNIT_ASSERT_EQUAL((ssize_t)0, recv(server_->get(), &c, 1, MSG_DONTWAIT));
+	}
+
+	void
+	testBothReset()
+	{
+		// closing with unread data resets the relay's ends of both pairs
+		CPPUNIT_ASSERT_EQUAL((size_t)1, client_->write("q", 1));
+		CPPUNIT_ASSERT_EQUAL((size_t)1, server_->write("r", 1));
+		disp_->stepSingleThread();
+		client_->reset();
+		server_->reset();
+
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL(false, relay_->open());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, closeCount_);
+	}
+
+	void
+	testDownstreamClosed()
+	{
+		// the splice towards the closed peer fails with EPIPE, not SIGPIPE
+		server_->reset();
+		CPPUNIT_ASSERT_EQUAL((size_t)4, client_->write("lost", 4));
+		while (relay_->open()) {
+			disp_->stepSingleThread();
+		}
+		CPPUNIT_ASSERT_EQUAL((size_t)0, relay_->forwarded());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, closeCount_);
+
+		char c;
+		CPPUNIT_ASSERT_EQUAL((ssize_t)0, recv(client_->get(), &c, 1, MSG_DONTWAIT));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RelayTester);
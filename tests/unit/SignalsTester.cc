@@ -0,0 +1,140 @@
+#include <reactor/Dispatcher.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdexcept>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h> // getpid()
+
+using namespace util;
+using namespace reactor;
+
+class SignalsTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SignalsTester);
+	CPPUNIT_TEST(testDelivery);
+	CPPUNIT_TEST(testBatch);
+	CPPUNIT_TEST(testRemove);
+	CPPUNIT_TEST(testRemoveFromEarlierJob);
+	CPPUNIT_TEST(testInvalid);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	std::vector<int> received_;
+	pid_t sender_;
+
+	void
+	onSignal(const SignalEvent &event)
+	{
+		received_.push_back(event.signal.number());
+		sender_ = event.pid;
+	}
+
+	static bool
+	blocked(int number)
+	{
+		sigset_t current;
+
+		pthread_sigmask(SIG_BLOCK, 0, &current);
+		return sigismember(&current, number);
+	}
+
+	void
+	onRemovingSignal(const SignalEvent &event)
+	{
+		received_.push_back(event.signal.number());
+		disp_->remove(Signal(SIGUSR2));
+	}
+
+	// directed at this thread, so no other thread can take it
+	static void raise(int number) { pthread_kill(pthread_self(), number); }
+
+public:
+	void
+	setUp()
+	{
+		disp_ = new MyDispatcher();
+		received_.clear();
+		sender_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		delete disp_;
+	}
+
+	void
+	testDelivery()
+	{
+		disp_->add(Signal(SIGUSR1), commandForMethod(*this, &SignalsTester::onSignal));
+		CPPUNIT_ASSERT(blocked(SIGUSR1));
+		raise(SIGUSR1);
+		disp_->stepSingleThread();
+
+		CPPUNIT_ASSERT_EQUAL((size_t)1, received_.size());
+		CPPUNIT_ASSERT_EQUAL(SIGUSR1, received_[0]);
+		CPPUNIT_ASSERT_EQUAL(getpid(), sender_);
+	}
+
+	void
+	testBatch()
+	{
+		disp_->add(Signal(SIGUSR1), commandForMethod(*this, &SignalsTester::onSignal));
+		disp_->add(Signal(SIGUSR2), commandForMethod(*this, &SignalsTester::onSignal));
+		disp_->add(Signal(SIGRTMIN), commandForMethod(*this, &SignalsTester::onSignal));
+
+		// standard signals coalesce, real-time ones are queued
+		raise(SIGUSR1);
+		raise(SIGUSR1);
+		raise(SIGUSR2);
+		for (int i = 0; i < 20; ++i) {
+			raise(SIGRTMIN);
+		}
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)22, received_.size());
+	}
+
+	void
+	testRemove()
+	{
+		disp_->add(Signal(SIGUSR2), commandForMethod(*this, &SignalsTester::onSignal));
+		CPPUNIT_ASSERT_THROW(disp_->add(Signal(SIGUSR2), commandForMethod(*this, &SignalsTester::onSignal)), std::runtime_error);
+		disp_->remove(Signal(SIGUSR2));
+		CPPUNIT_ASSERT(!blocked(SIGUSR2));
+		CPPUNIT_ASSERT_THROW(disp_->remove(Signal(SIGUSR2)), std::runtime_error);
+
+		// the mask is restored when the dispatcher goes away
+		disp_->add(Signal(SIGUSR2), commandForMethod(*this, &SignalsTester::onSignal));
+		delete disp_;
+		disp_ = 0;
+		CPPUNIT_ASSERT(!blocked(SIGUSR2));
+	}
+
+	void
+	testRemoveFromEarlierJob()
+	{
+		disp_->add(Signal(SIGUSR1), commandForMethod(*this, &SignalsTester::onRemovingSignal));
+		disp_->add(Signal(SIGUSR2), commandForMethod(*this, &SignalsTester::onSignal));
+
+		// both are read in one go, SIGUSR1 first
+		raise(SIGUSR1);
+		raise(SIGUSR2);
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, received_.size());
+		CPPUNIT_ASSERT_EQUAL(SIGUSR1, received_[0]);
+	}
+
+	void
+	testInvalid()
+	{
+		CPPUNIT_ASSERT_THROW(disp_->add(Signal(SIGKILL), commandForMethod(*this, &SignalsTester::onSignal)), std::invalid_argument);
+		CPPUNIT_ASSERT_THROW(disp_->add(Signal(0), commandForMethod(*this, &SignalsTester::onSignal)), std::invalid_argument);
+		CPPUNIT_ASSERT(!blocked(SIGKILL));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SignalsTester);
@@ -0,0 +1,116 @@
+#include <reactor/StreamSock.hh>
+
+#include <net/Ip.hh>
+#include <net/Port.hh>
+#include <util/ErrnoException.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sys/socket.h>
+
+using namespace util;
+using namespace reactor;
+
+class SocketOptionsTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SocketOptionsTester);
+	CPPUNIT_TEST(testSettings);
+	CPPUNIT_TEST(testPresets);
+	CPPUNIT_TEST(testAppliedOnCreate);
+	CPPUNIT_TEST(testAppliedToOpenSocket);
+	CPPUNIT_TEST(testRemembered);
+	CPPUNIT_TEST(testUnknownDevice);
+	CPPUNIT_TEST_SUITE_END();
+
+	static int
+	option(const Socket &sock, int level, int name)
+	{
+		int value = 0;
+		socklen_t length = sizeof(value);
+
+		CPPUNIT_ASSERT_EQUAL(0, getsockopt(sock.fd().get(), level, name, &value, &length));
+		return value;
+	}
+
+public:
+	void
+	testSettings()
+	{
+		SocketOptions options;
+
+		options.noDelay(true).receiveLowat(64).noDelay(false);
+		CPPUNIT_ASSERT_EQUAL((size_t)2, options.settings().size());
+		CPPUNIT_ASSERT_EQUAL(TCP_NODELAY, options.settings()[0].name);
+		CPPUNIT_ASSERT_EQUAL(0, options.settings()[0].value);
+		CPPUNIT_ASSERT(options.device().empty());
+		CPPUNIT_ASSERT_EQUAL(std::string("lo"), options.bindToDevice("lo").device());
+	}
+
+	void
+	testPresets()
+	{
+		SocketOptions::Settings latency(SocketOptions::latency().settings());
+		SocketOptions::Settings throughput(SocketOptions::throughput().settings());
+
+		CPPUNIT_ASSERT(!latency.empty());
+		CPPUNIT_ASSERT_EQUAL(TCP_NODELAY, latency[0].name);
+		CPPUNIT_ASSERT_EQUAL(1, latency[0].value);
+		// the kernel defaults stay in charge unless a buffer size is asked for
+		CPPUNIT_ASSERT(throughput.empty());
+		throughput = SocketOptions::throughput(1024 * 1024).settings();
+		CPPUNIT_ASSERT_EQUAL((size_t)2, throughput.size());
+		CPPUNIT_ASSERT_EQUAL(SO_RCVBUF, throughput[0].name);
+		CPPUNIT_ASSERT_EQUAL(SO_SNDBUF, throughput[1].name);
+	}
+
+	void
+	testAppliedOnCreate()
+	{
+		StreamSock sock;
+
+		sock.setOptions(SocketOptions::latency().receiveLowat(128));
+		sock.bind(net::Ip("127.0.0.1"), net::Port(0));
+		CPPUNIT_ASSERT_EQUAL(1, option(sock, IPPROTO_TCP, TCP_NODELAY));
+		CPPUNIT_ASSERT_EQUAL(128, option(sock, SOL_SOCKET, SO_RCVLOWAT));
+	}
+
+	void
+	testAppliedToOpenSocket()
+	{
+		StreamSock sock;
+
+		sock.bind(net::Ip("127.0.0.1"), net::Port(0));
+		CPPUNIT_ASSERT_EQUAL(0, option(sock, IPPROTO_TCP, TCP_NODELAY));
+		sock.setOptions(SocketOptions().noDelay(true).sendBuffer(64 * 1024));
+		CPPUNIT_ASSERT_EQUAL(1, option(sock, IPPROTO_TCP, TCP_NODELAY));
+		// the kernel doubles the requested size for bookkeeping
+		CPPUNIT_ASSERT(option(sock, SOL_SOCKET, SO_SNDBUF) >= 64 * 1024);
+	}
+
+	void
+	testRemembered()
+	{
+		StreamSock sock;
+
+		sock.setOptions(SocketOptions::latency());
+		sock.setOption(IPPROTO_TCP, TCP_NODELAY, 0);
+		sock.setOption(SOL_SOCKET, SO_RCVLOWAT, 32);
+		CPPUNIT_ASSERT_EQUAL(SocketOptions::latency().settings().size() + 1, sock.options().settings().size());
+		CPPUNIT_ASSERT_EQUAL(TCP_NODELAY, sock.options().settings()[0].name);
+		CPPUNIT_ASSERT_EQUAL(0, sock.options().settings()[0].value);
+
+		sock.bind(net::Ip("127.0.0.1"), net::Port(0));
+		CPPUNIT_ASSERT_EQUAL(0, option(sock, IPPROTO_TCP, TCP_NODELAY));
+		CPPUNIT_ASSERT_EQUAL(32, option(sock, SOL_SOCKET, SO_RCVLOWAT));
+	}
+
+	void
+	testUnknownDevice()
+	{
+		StreamSock sock;
+
+		sock.bind(net::Ip("127.0.0.1"), net::Port(0));
+		CPPUNIT_ASSERT_THROW(sock.setDevice("no-such-device0"), ErrnoException);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SocketOptionsTester);
@@ -0,0 +1,289 @@
+#include <reactor/StreamConnection.hh>
+
+#include <util/AutoFd.hh>
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstdlib> // mkstemp
+#include <cstring> // memset()
+#include <netinet/in.h>
+#include <signal.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h> // unlink
+
+using namespace util;
+using namespace reactor;
+
+class StreamConnectionTester : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(StreamConnectionTester);
+	CPPUNIT_TEST(testRead);
+	CPPUNIT_TEST(testPeerClose);
+	CPPUNIT_TEST(testWriteAfterReset);
+	CPPUNIT_TEST(testSendFileAfterReset);
+	CPPUNIT_TEST(testWriteQueue);
+	CPPUNIT_TEST(testGracefulClose);
+	CPPUNIT_TEST(testCorking);
+	CPPUNIT_TEST(testSendFile);
+	CPPUNIT_TEST(testZeroCopy);
+	CPPUNIT_TEST_SUITE_END();
+
+	class MyDispatcher : public Dispatcher {};
+
+	MyDispatcher *disp_;
+	StreamConnection *conn_;
+	AutoFd *peer_;
+	std::string received_;
+	size_t closeCount_;
+	size_t highCount_;
+	size_t lowCount_;
+	size_t queuedDuringRead_;
+	size_t fileSent_;
+
+	void
+	onRead(StreamConnection &conn)
+	{
+		std::string data(conn.input().size(), '\0');
+
+		conn.input().copyOut(&data[0], data.size());
+		conn.input().consume(data.size());
+		received_ += data;
+	}
+
+	void
+	onReadEcho(StreamConnection &conn)
+	{
+		conn.input().consume(conn.input().size());
+		conn.write("a", 1);
+		conn.write("bc", 2);
+		conn.write("def", 3);
+		queuedDuringRead_ = conn.pendingOutput();
+	}
+
+	void onFileProgress(const StreamConnection::FileProgress &progress) { fileSent_ = progress.sent; }
+	void onClose(StreamConnection &) { ++closeCount_; }
+	void onHigh(StreamConnection &) { ++highCount_; }
+	void onLow(StreamConnection &) { ++lowCount_; }
+
+	std::string
+	drainPeer()
+	{
+		std::string result;
+		char buf[4096];
+		ssize_t rd;
+
+		while ((rd = recv(peer_->get(), buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+			result.append(buf, rd);
+		}
+		return result;
+	}
+
+	// replaces the socketpair with a loopback TCP connection, MSG_ZEROCOPY needs an inet socket
+	void
+	connectTcp()
+	{
+		struct sockaddr_in addr;
+		socklen_t length = sizeof(addr);
+		AutoFd listener(socket(AF_INET, SOCK_STREAM, 0));
+		AutoFd client(socket(AF_INET, SOCK_STREAM, 0));
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		CPPUNIT_ASSERT_EQUAL(0, bind(listener.get(), (struct sockaddr *)&addr, sizeof(addr)));
+		CPPUNIT_ASSERT_EQUAL(0, listen(listener.get(), 1));
+		CPPUNIT_ASSERT_EQUAL(0, getsockname(listener.get(), (struct sockaddr *)&addr, &length));
+		CPPUNIT_ASSERT_EQUAL(0, connect(client.get(), (struct sockaddr *)&addr, sizeof(addr)));
+
+		delete conn_;
+		conn_ = new StreamConnection(*disp_);
+		peer_->reset(accept(listener.get(), 0, 0));
+		conn_->adopt(Fd(client.release()));
+	}
+
+public:
+	void
+	setUp()
+	{
+		int fds[2];
+
+		CPPUNIT_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+		disp_ = new MyDispatcher();
+		conn_ = new StreamConnection(*disp_);
+		peer_ = new AutoFd(fds[1]);
+		conn_->setReadCommand(commandForMethod(*this, &StreamConnectionTester::onRead));
+		conn_->setCloseCommand(commandForMethod(*this, &StreamConnectionTester::onClose));
+		conn_->adopt(Fd(fds[0]));
+		received_.clear();
+		closeCount_ = highCount_ = lowCount_ = queuedDuringRead_ = fileSent_ = 0;
+	}
+
+	void
+	tearDown()
+	{
+		delete peer_;
+		delete conn_;
+		delete disp_;
+	}
+
+	void
+	testRead()
+	{
+		CPPUNIT_ASSERT_EQUAL((size_t)5, peer_->write("hello", 5));
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL(std::string("hello"), received_);
+		CPPUNIT_ASSERT_EQUAL(true, conn_->input().empty());
+	}
+
+	void
+	testPeerClose()
+	{
+		peer_->reset();
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)1, closeCount_);
+		CPPUNIT_ASSERT_EQUAL(false, conn_->open());
+	}
+
+	// SIGPIPE would end the test run instead of closing the connection
+	void
+	testWriteAfterReset()
+	{
+		peer_->reset();
+		conn_->write("x", 1);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, closeCount_);
+		CPPUNIT_ASSERT_EQUAL(false, conn_->open());
+	}
+
+	void
+	testSendFileAfterReset()
+	{
+		char path[] = "/tmp/StreamConnectionTester.XXXXXX";
+		AutoFd file(mkstemp(path));
+		sigset_t pending;
+
+		CPPUNIT_ASSERT(file.valid());
+		unlink(path);
+		CPPUNIT_ASSERT_EQUAL((size_t)4, file.write("file", 4));
+		peer_->reset();
+		conn_->sendFile(file, 0, 4);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, closeCount_);
+		CPPUNIT_ASSERT_EQUAL(0, sigpending(&pending));
+		CPPUNIT_ASSERT_EQUAL(0, sigismember(&pending, SIGPIPE));
+	}
+
+	void
+	testWriteQueue()
+	{
+		std::string chunk(64 * 1024, 'q');
+		std::string sent, got;
+
+		conn_->setHighWatermark(256 * 1024, commandForMethod(*this, &StreamConnectionTester::onHigh));
+		conn_->setLowWatermark(0, commandForMethod(*this, &StreamConnectionTester::onLow));
+		for (size_t i = 0; i < 32; ++i) {
+			chunk[0] = 'a' + i;
+			conn_->write(chunk.data(), chunk.size());
+			sent += chunk;
+		}
+		CPPUNIT_ASSERT(conn_->pendingOutput() > 0);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, highCount_);
+
+		while (conn_->pendingOutput()) {
+			got += drainPeer();
+			disp_->stepSingleThread();
+		}
+		got += drainPeer();
+		CPPUNIT_ASSERT_EQUAL(sent.size(), got.size());
+		CPPUNIT_ASSERT(sent == got);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, lowCount_);
+	}
+
+	void
+	testGracefulClose()
+	{
+		std::string data(1024 * 1024, 'g');
+		std::string got;
+
+		conn_->write(data.data(), data.size());
+		CPPUNIT_ASSERT(conn_->pendingOutput() > 0);
+		conn_->close();
+		CPPUNIT_ASSERT_EQUAL(true, conn_->open());
+		while (conn_->open()) {
+			got += drainPeer();
+			disp_->stepSingleThread();
+		}
+		got += drainPeer();
+		CPPUNIT_ASSERT_EQUAL(data.size(), got.size());
+		CPPUNIT_ASSERT_EQUAL((size_t)1, closeCount_);
+	}
+
+	void
+	testCorking()
+	{
+		conn_->setCorking(true);
+		conn_->setReadCommand(commandForMethod(*this, &StreamConnectionTester::onReadEcho));
+		conn_->write("x", 1);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, conn_->pendingOutput());
+		CPPUNIT_ASSERT_EQUAL(std::string("x"), drainPeer());
+
+		CPPUNIT_ASSERT_EQUAL((size_t)4, peer_->write("ping", 4));
+		disp_->stepSingleThread();
+		CPPUNIT_ASSERT_EQUAL((size_t)6, queuedDuringRead_);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, conn_->pendingOutput());
+		CPPUNIT_ASSERT_EQUAL(std::string("abcdef"), drainPeer());
+	}
+
+	void
+	testSendFile()
+	{
+		char path[] = "/tmp/StreamConnectionTester.XXXXXX";
+		AutoFd file(mkstemp(path));
+		std::string content(300 * 1024, 'f');
+		std::string got;
+
+		CPPUNIT_ASSERT(file.valid());
+		unlink(path);
+		content[0] = 'F';
+		CPPUNIT_ASSERT_EQUAL(content.size(), file.write(content.data(), content.size()));
+
+		conn_->write("hdr", 3);
+		conn_->sendFile(file, 1, content.size() - 1, commandForMethod(*this, &StreamConnectionTester::onFileProgress));
+		conn_->write("trl", 3);
+		CPPUNIT_ASSERT(conn_->pendingOutput() > 0);
+		while (conn_->pendingOutput()) {
+			got += drainPeer();
+			disp_->stepSingleThread();
+		}
+		got += drainPeer();
+		CPPUNIT_ASSERT_EQUAL(content.size() - 1, fileSent_);
+		CPPUNIT_ASSERT(got == "hdr" + content.substr(1) + "trl");
+	}
+
+	void
+	testZeroCopy()
+	{
+		std::string data(1024 * 1024, 'z');
+		std::string got;
+		IoBuffer buffer;
+
+		connectTcp();
+		conn_->setZeroCopy(true, 16 * 1024);
+		conn_->write("small", 5);
+		CPPUNIT_ASSERT_EQUAL((size_t)0, conn_->pendingCompletions());
+
+		data[0] = 'Z';
+		buffer.append(data.data(), data.size());
+		conn_->write(buffer);
+		buffer.clear();
+		CPPUNIT_ASSERT(conn_->pendingCompletions() > 0);
+
+		while (conn_->pendingOutput() || conn_->pendingCompletions()) {
+			got += drainPeer();
+			disp_->stepSingleThread();
+		}
+		got += drainPeer();
+		CPPUNIT_ASSERT(got == "small" + data);
+		CPPUNIT_ASSERT_EQUAL(true, conn_->open());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(StreamConnectionTester);
@@ -12,11 +12,13 @@ class TimersTester : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(TimersTester);
 	CPPUNIT_TEST(testAddTimerActions);
 	CPPUNIT_TEST(testFireAllExpired);
+	CPPUNIT_TEST(testRemoveByOwner);
 	CPPUNIT_TEST_SUITE_END();
 
 	const MethodCommand1<void, TimersTester, const TimerEvent &> methodCommand1_;
 	const MethodCommand1<void, TimersTester, const TimerEvent &> methodCommand2_;
 
+	Arena *arena_;
 	Backlog *bl_;
 	Timers *t_;
 
@@ -32,7 +34,8 @@ public:
 	void
 	setUp()
 	{
-		bl_ = new Backlog();
+		arena_ = new Arena();
+		bl_ = new Backlog(*arena_);
 		t_ = new Timers(*bl_, &TimersTester::now);
 		command1Count_ = command2Count_ = 0;
 	}
@@ -42,6 +45,7 @@ public:
 	{
 		delete t_;
 		delete bl_;
+		delete arena_;
 	}
 
 	void
@@ -74,10 +78,9 @@ public:
 	executeAll()
 	{
 		while (!bl_->empty()) {
-			Backlog::Job *job = bl_->dequeue();
-			job->execute();
-			delete job;
+			bl_->dequeue()->execute();
 		}
+		arena_->reset();
 	}
 
 	void
@@ -128,6 +131,31 @@ public:
 		CPPUNIT_ASSERT_EQUAL((size_t)1, command1Count_);
 		CPPUNIT_ASSERT_EQUAL((size_t)0, command2Count_);
 	}
+
+	void
+	testRemoveByOwner()
+	{
+		Mocked now("now");
+		int owner1, owner2;
+
+		t_->add(Timer(DiffTime::raw(2), 0, Time::raw(0)), methodCommand1_, &owner1);
+		t_->add(Timer(DiffTime::raw(3), 0, Time::raw(0)), methodCommand1_, &owner1);
+		t_->add(Timer(DiffTime::raw(4), 0, Time::raw(0)), methodCommand2_, &owner2);
+
+		t_->remove(&owner1);
+		CPPUNIT_ASSERT_EQUAL(true, t_->isTicking());
+		now.expect(0);
+		CPPUNIT_ASSERT_EQUAL((int64_t)4, t_->remainingTime().raw());
+
+		now.expect(4);
+		t_->harvest();
+		executeAll();
+		CPPUNIT_ASSERT_EQUAL((size_t)0, command1Count_);
+		CPPUNIT_ASSERT_EQUAL((size_t)1, command2Count_);
+
+		t_->remove(&owner2);
+		CPPUNIT_ASSERT_EQUAL(false, t_->isTicking());
+	}
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TimersTester);
@@ -0,0 +1,29 @@
+#include "uio.h"
+
+#include <tests/unit/mock/MockRegistry.hh>
+#include <tests/unit/mock/Mocked.hh>
+
+#include </usr/include/cppunit/TestAssert.h>
+
+REDIRECT_MOCK_C_FUNCTION3(readv, ssize_t, int, fd, const struct iovec *, iov, int, iovcnt)
+REDIRECT_MOCK_C_FUNCTION3(writev, ssize_t, int, fd, const struct iovec *, iov, int, iovcnt)
+
+ssize_t
+mock_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+	Mocked &m = MockRegistry::find("readv");
+	CPPUNIT_ASSERT_EQUAL(m.expectedInt(), fd);
+	CPPUNIT_ASSERT_EQUAL(m.expectedPointer(), (void *)iov);
+	CPPUNIT_ASSERT_EQUAL(m.expectedInt(), iovcnt);
+	return m.expectedInt();
+}
+
+ssize_t
+mock_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	Mocked &m = MockRegistry::find("writev");
+	CPPUNIT_ASSERT_EQUAL(m.expectedInt(), fd);
+	CPPUNIT_ASSERT_EQUAL(m.expectedPointer(), (void *)iov);
+	CPPUNIT_ASSERT_EQUAL(m.expectedInt(), iovcnt);
+	return m.expectedInt();
+}
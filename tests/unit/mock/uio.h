@@ -0,0 +1,14 @@
+#ifndef TESTS_UNIT_MOCK_UIO_HEADER
+#define TESTS_UNIT_MOCK_UIO_HEADER
+
+#include <tests/unit/mock/RedirectMockCFunction.h>
+
+#include <sys/uio.h>
+
+DECLARE_MOCK_C_FUNCTION3(readv, ssize_t, int, const struct iovec *, int)
+ssize_t mock_readv(int fd, const struct iovec *iov, int iovcnt);
+
+DECLARE_MOCK_C_FUNCTION3(writev, ssize_t, int, const struct iovec *, int)
+ssize_t mock_writev(int fd, const struct iovec *iov, int iovcnt);
+
+#endif // TESTS_UNIT_MOCK_UIO_HEADER
@@ -5,6 +5,7 @@ testUnits_SOURCES := \
 	tests/unit/mock/MockRegistry.cc \
 	tests/unit/mock/Mocked.cc \
 	tests/unit/mock/unistd.cc \
+	tests/unit/mock/uio.cc \
 	tests/unit/mock/time.cc \
 	tests/unit/testUnits.cc
 
@@ -12,19 +13,38 @@ testUnits_SOURCES += \
 	$(libutil_SOURCES) \
 	tests/unit/ErrnoTester.cc \
 	tests/unit/FdTester.cc \
+	tests/unit/IoBufferTester.cc \
+	tests/unit/BufferPoolTester.cc \
 	tests/unit/DiffTimeTester.cc \
 	tests/unit/TimeTester.cc \
 	tests/unit/AutoFdTester.cc
 
 testUnits_SOURCES += \
 	$(libnet_SOURCES) \
-	tests/unit/SpecifierTester.cc
+	tests/unit/SpecifierTester.cc \
+	tests/unit/AddressTester.cc
 
 testUnits_SOURCES += \
 	$(libreactor_SOURCES) \
+	tests/unit/AcceptorTester.cc \
+	tests/unit/BacklogTester.cc \
+	tests/unit/ChildProcessTester.cc \
 	tests/unit/TimerTester.cc \
 	tests/unit/TimersTester.cc \
-	tests/unit/DispatcherTester.cc
+	tests/unit/DispatcherTester.cc \
+	tests/unit/StreamConnectionTester.cc \
+	tests/unit/RelayTester.cc \
+	tests/unit/DatagramEndpointTester.cc \
+	tests/unit/ConnectionPoolTester.cc \
+	tests/unit/ConnectorTester.cc \
+	tests/unit/OffloadPoolTester.cc \
+	tests/unit/FdChannelTester.cc \
+	tests/unit/FileIoTester.cc \
+	tests/unit/FileReaderTester.cc \
+	tests/unit/FileWatcherTester.cc \
+	tests/unit/LoopMetricsTester.cc \
+	tests/unit/SocketOptionsTester.cc \
+	tests/unit/SignalsTester.cc
 
 testUnits_OBJECTS := $(sort $(addprefix out/testUnits.d/,$(addsuffix .o,$(basename $(testUnits_SOURCES)))))
 -include $(addsuffix .d,$(basename $(testUnits_OBJECTS)))
@@ -38,6 +58,8 @@ testUnits_WRAPPED_SYMBOLS := \
 	close \
 	read \
 	write \
+	readv \
+	writev \
 	fcntl \
 	gettimeofday
 
@@ -60,3 +82,32 @@ run_testUnits: out/testUnits
 	$Qfind $<.d/ -name '*.gcda' -delete
 	$(if $Q,@echo "  RUN   $<")
 	$Q$<
+
+# counts heap allocations through a replaced global operator new, which
+# would otherwise apply to every tester
+testArena_SOURCES := \
+	tests/unit/ArenaTester.cc \
+	tests/unit/testUnits.cc
+
+testArena_OBJECTS := $(sort $(addprefix out/testArena.d/,$(addsuffix .o,$(basename $(testArena_SOURCES)))))
+-include $(addsuffix .d,$(basename $(testArena_OBJECTS)))
+
+out/testArena.d/%.o: %.cc
+	$Qmkdir -p $(@D)
+	$(if $Q,@echo "  CXX   $@")
+	$Q$(CXX) $(CPPFLAGS) $(CXXFLAGS) -c $< $(OUTPUT_OPTION)
+
+out/testArena: out/libreactor.a
+out/testArena: out/libutil.a
+out/testArena: out/libnet.a
+out/testArena: LDLIBS += -lreactor -lutil -lnet $(shell cppunit-config --libs)
+out/testArena: LDFLAGS += -Lout/
+
+out/testArena: $(testArena_OBJECTS)
+	$(if $Q,@echo "  LINK  $@")
+	$Q$(CXX) $(LDFLAGS) $(filter-out %.a,$^) $(LOADLIBES) $(LDLIBS) $(OUTPUT_OPTION)
+
+.PHONY: run_testArena
+run_testArena: out/testArena
+	$(if $Q,@echo "  RUN   $<")
+	$Q$<
@@ -0,0 +1,144 @@
+#include "Arena.hh"
+
+#include <algorithm> // std::max
+#include <cstdint> // uintptr_t
+
+using namespace util;
+
+const size_t Arena::DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+Arena::Arena(size_t chunkSize)
+: chunkSize_(chunkSize)
+, first_(0)
+, current_(0)
+, cursor_(0)
+, end_(0)
+, destructors_(0)
+{}
+
+Arena::~Arena()
+{
+	reset();
+	while (first_) {
+		Chunk *next = first_->next;
+
+		::operator delete(first_);
+		first_ = next;
+	}
+}
+
+void
+Arena::nextChunk(size_t size)
+{
+	Chunk *next = current_ ? current_->next : first_;
+
+	if (!next || next->size < size) {
+		size_t chunkSize = std::max(chunkSize_, size);
+		Chunk *chunk = static_cast<Chunk *>(::operator new(sizeof(Chunk) + chunkSize));
+
+		chunk->size = chunkSize;
+		chunk->next = next;
+		if (current_) {
+			current_->next = chunk;
+		} else {
+			first_ = chunk;
+		}
+		next = chunk;
+	}
+
+	current_ = next;
+	cursor_ = data(current_);
+	end_ = cursor_ + current_->size;
+}
+
+void *
+Arena::allocate(size_t size, size_t alignment)
+{
+	uintptr_t p = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+	if (!cursor_ || p + size > reinterpret_cast<uintptr_t>(end_)) {
+		nextChunk(size + alignment);
+		p = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	}
+
+	cursor_ = reinterpret_cast<char *>(p + size);
+	return reinterpret_cast<void *>(p);
+}
+
+void
+Arena::registerDestructor(void (*destroy)(void *), void *object)
+{
+	Destructor *d = static_cast<Destructor *>(allocate(sizeof(Destructor), alignof(Destructor)));
+
+	d->destroy = destroy;
+	d->object = object;
+	d->next = destructors_;
+	destructors_ = d;
+}
+
+void
+Arena::reset()
+{
+	while (destructors_) {
+		Destructor *d = destructors_;
+
+		destructors_ = d->next;
+		d->destroy(d->object);
+	}
+
+	current_ = first_;
+	cursor_ = first_ ? data(first_) : 0;
+	end_ = first_ ? cursor_ + first_->size : 0;
+}
+
+void
+Arena::reserve(size_t bytes)
+{
+	size_t have = capacity();
+
+	if (have >= bytes) {
+		return;
+	}
+
+	Chunk **tail = &first_;
+
+	while (*tail) {
+		tail = &(*tail)->next;
+	}
+
+	size_t size = std::max(chunkSize_, bytes - have);
+	Chunk *chunk = static_cast<Chunk *>(::operator new(sizeof(Chunk) + size));
+
+	chunk->size = size;
+	chunk->next = 0;
+	*tail = chunk;
+	if (!current_) {
+		current_ = first_;
+		cursor_ = data(current_);
+		end_ = cursor_ + current_->size;
+	}
+}
+
+size_t
+Arena::capacity()
+const
+{
+	size_t result = 0;
+
+	for (const Chunk *chunk = first_; chunk; chunk = chunk->next) {
+		result += chunk->size;
+	}
+	return result;
+}
+
+size_t
+Arena::used()
+const
+{
+	size_t result = 0;
+
+	for (const Chunk *chunk = first_; chunk && chunk != current_; chunk = chunk->next) {
+		result += chunk->size;
+	}
+	return current_ ? result + (cursor_ - data(current_)) : 0;
+}
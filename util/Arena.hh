@@ -0,0 +1,90 @@
+#ifndef REACTOR_UTIL_ARENA_HEADER
+#define REACTOR_UTIL_ARENA_HEADER
+
+#include <util/Noncopyable.hh>
+
+#include <cstddef>
+#include <new> // placement new
+#include <type_traits>
+#include <utility> // std::forward
+
+namespace util {
+
+// Bump-pointer allocator for objects that die together. reset() runs the
+// pending destructors in reverse order of creation and rewinds, keeping the
+// chunks for reuse, so a steady workload stops allocating after warm-up.
+class Arena : public Noncopyable {
+	struct Chunk {
+		Chunk *next;
+		size_t size;
+	};
+
+	struct Destructor {
+		void (*destroy)(void *);
+		void *object;
+		Destructor *next;
+	};
+
+	size_t chunkSize_;
+	Chunk *first_;
+	Chunk *current_;
+	char *cursor_;
+	char *end_;
+	Destructor *destructors_;
+
+	template <typename T>
+	static void destroy(void *object) { static_cast<T *>(object)->~T(); }
+
+	template <typename T>
+	static void release(void *object) { delete static_cast<T *>(object); }
+
+	static char *data(Chunk *chunk) { return reinterpret_cast<char *>(chunk + 1); }
+
+	void nextChunk(size_t size);
+	void registerDestructor(void (*destroy)(void *), void *object);
+
+public:
+	static const size_t DEFAULT_CHUNK_SIZE;
+
+	explicit Arena(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+	~Arena();
+
+	void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	template <typename T, typename... A>
+	T *
+	make(A &&... args)
+	{
+		T *result = new (allocate(sizeof(T), alignof(T))) T(std::forward<A>(args)...);
+
+		if (!std::is_trivially_destructible<T>::value) {
+			registerDestructor(&Arena::destroy<T>, result);
+		}
+		return result;
+	}
+
+	// takes a heap object that is deleted on reset, for types that cannot be built in place
+	template <typename T>
+	T *
+	adopt(T *object)
+	{
+		try {
+			registerDestructor(&Arena::release<T>, object);
+		} catch (...) {
+			delete object;
+			throw;
+		}
+		return object;
+	}
+
+	void reset();
+	// makes sure bytes fit without allocating during the next rounds
+	void reserve(size_t bytes);
+
+	size_t capacity() const;
+	size_t used() const;
+};
+
+} // namespace util
+
+#endif // REACTOR_UTIL_ARENA_HEADER
@@ -42,6 +42,7 @@ public:
 	}
 
 	virtual BoundCommand0 *clone() const { return new BoundCommand0(*this); }
+	virtual BoundCommand0 *clone(Arena &arena) const { return arena.make<BoundCommand0>(*this); }
 	virtual R execute() const { return c_->execute(); }
 };
 
@@ -86,6 +87,7 @@ public:
 	}
 
 	virtual BoundCommand1 *clone() const { return new BoundCommand1(*this); }
+	virtual BoundCommand1 *clone(Arena &arena) const { return arena.make<BoundCommand1>(*this); }
 	virtual R execute() const { return c_->execute(p1_); }
 };
 
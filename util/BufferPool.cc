@@ -0,0 +1,356 @@
+#include "BufferPool.hh"
+
+#include "ErrnoException.hh"
+
+#include <algorithm> // std::find(), std::max()
+#include <stdexcept>
+#include <sys/mman.h>
+
+using namespace util;
+
+const size_t BufferPool::CLASS_SIZES[BufferPool::CLASS_COUNT] = { 2048, 4096, 16 * 1024, 64 * 1024 };
+const size_t BufferPool::MAX_CLASS_SIZE = 64 * 1024;
+const size_t BufferPool::THREAD_CACHE_BYTES = 256 * 1024;
+const size_t BufferPool::DEFAULT_RESERVE_BYTES = 4 * 1024 * 1024;
+
+namespace {
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+const std::memory_order RELAXED = std::memory_order_relaxed;
+
+// a single writer needs no read-modify-write
+template <typename T>
+void
+bump(std::atomic<T> &counter, T n)
+{
+	counter.store(counter.load(RELAXED) + n, RELAXED);
+}
+
+} // namespace
+
+class BufferPool::ThreadCache {
+public:
+	FreeList lists[CLASS_COUNT];
+	Counters counters;
+
+	ThreadCache()
+	{
+		BufferPool &pool = instance();
+		std::lock_guard<std::mutex> lock(pool.mutex_);
+
+		pool.caches_.push_back(this);
+	}
+
+	~ThreadCache()
+	{
+		BufferPool &pool = instance();
+
+		for (int i = 0; i < CLASS_COUNT; ++i) {
+			pool.spill(*this, i, lists[i].count);
+		}
+
+		std::lock_guard<std::mutex> lock(pool.mutex_);
+
+		bump(pool.retired_.hits, counters.hits.load(RELAXED));
+		bump(pool.retired_.misses, counters.misses.load(RELAXED));
+		bump(pool.retired_.resident, counters.resident.load(RELAXED));
+		pool.caches_.erase(std::find(pool.caches_.begin(), pool.caches_.end(), this));
+	}
+};
+
+void
+BufferPool::FreeList::push(void *buffer)
+{
+	*static_cast<void **>(buffer) = head;
+	head = buffer;
+	++count;
+}
+
+void *
+BufferPool::FreeList::pop()
+{
+	void *result = head;
+
+	if (result) {
+		head = *static_cast<void **>(result);
+		--count;
+	}
+	return result;
+}
+
+BufferPool::BufferPool()
+: reserveBytes_(DEFAULT_RESERVE_BYTES)
+, arena_(0)
+, arenaSize_(0)
+, arenaUsed_(0)
+, hugePages_(false)
+{}
+
+// never destroyed, buffers may still be released while static objects go away
+BufferPool &
+BufferPool::instance()
+{
+	static BufferPool *pool = new BufferPool();
+	return *pool;
+}
+
+BufferPool::ThreadCache &
+BufferPool::threadCache()
+{
+	static thread_local ThreadCache cache;
+	return cache;
+}
+
+int
+BufferPool::classIndex(size_t size)
+{
+	for (int i = 0; i < CLASS_COUNT; ++i) {
+		if (size <= CLASS_SIZES[i]) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+size_t
+BufferPool::classSize(size_t size)
+{
+	int index = classIndex(size);
+
+	return index < 0 ? size : CLASS_SIZES[index];
+}
+
+size_t
+BufferPool::threadCacheLimit(int index)
+{
+	return std::max<size_t>(THREAD_CACHE_BYTES / CLASS_SIZES[index], 2);
+}
+
+size_t
+BufferPool::reserveLimit(size_t bytes, int index)
+{
+	return bytes / CLASS_SIZES[index];
+}
+
+bool
+BufferPool::inArena(const void *buffer)
+const
+{
+	const char *p = static_cast<const char *>(buffer);
+	const char *arena = arena_;
+
+	return arena && p >= arena && p < arena + arenaSize_;
+}
+
+void *
+BufferPool::fresh(int index, Counters &counters)
+{
+	size_t size = CLASS_SIZES[index];
+
+	if (arena_) {
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if (arenaUsed_ + size <= arenaSize_) {
+			void *result = arena_.load() + arenaUsed_;
+
+			arenaUsed_ += size;
+			return result;
+		}
+	}
+
+	void *result = ::operator new(size);
+
+	bump<int64_t>(counters.resident, size);
+	return result;
+}
+
+void
+BufferPool::discard(void *buffer, int index, Counters &counters)
+{
+	::operator delete(buffer);
+	bump<int64_t>(counters.resident, -(int64_t)CLASS_SIZES[index]);
+}
+
+void
+BufferPool::refill(FreeList &list, int index)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	FreeList &reserve = reserve_[index];
+
+	for (size_t n = threadCacheLimit(index) / 2; n && reserve.head; --n) {
+		list.push(reserve.pop());
+	}
+}
+
+void
+BufferPool::spill(ThreadCache &cache, int index, size_t count)
+{
+	FreeList &list = cache.lists[index];
+	std::lock_guard<std::mutex> lock(mutex_);
+	FreeList &reserve = reserve_[index];
+	size_t limit = reserveLimit(reserveBytes_, index);
+
+	for (; count && list.head; --count) {
+		void *buffer = list.pop();
+
+		if (reserve.count < limit || inArena(buffer)) {
+			reserve.push(buffer);
+		} else {
+			discard(buffer, index, cache.counters);
+		}
+	}
+}
+
+void *
+BufferPool::allocate(size_t size)
+{
+	int index = classIndex(size);
+	ThreadCache &cache = threadCache();
+
+	if (index < 0) {
+		void *result = ::operator new(size);
+
+		bump<size_t>(cache.counters.misses, 1);
+		bump<int64_t>(cache.counters.resident, size);
+		return result;
+	}
+
+	FreeList &list = cache.lists[index];
+
+	if (!list.head) {
+		refill(list, index);
+	}
+	if (void *result = list.pop()) {
+		bump<size_t>(cache.counters.hits, 1);
+		return result;
+	}
+	bump<size_t>(cache.counters.misses, 1);
+	return fresh(index, cache.counters);
+}
+
+void
+BufferPool::release(void *buffer, size_t size)
+{
+	int index = classIndex(size);
+	ThreadCache &cache = threadCache();
+
+	if (index < 0) {
+		::operator delete(buffer);
+		bump<int64_t>(cache.counters.resident, -(int64_t)size);
+		return;
+	}
+
+	FreeList &list = cache.lists[index];
+
+	list.push(buffer);
+	if (list.count > threadCacheLimit(index)) {
+		spill(cache, index, list.count / 2);
+	}
+}
+
+void
+BufferPool::setReserveBytes(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	reserveBytes_ = bytes;
+}
+
+void
+BufferPool::useHugePages(size_t arenaSize)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if (arena_) {
+		throw std::runtime_error("buffer pool already has an arena");
+	}
+
+	size_t size = (arenaSize + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	void *p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+	hugePages_ = p != MAP_FAILED;
+	if (!hugePages_) {
+		// no reserved huge pages, ask for transparent ones instead
+		p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			throw ErrnoException("mmap");
+		}
+		madvise(p, size, MADV_HUGEPAGE);
+	}
+
+	arenaSize_ = size;
+	arena_ = static_cast<char *>(p);
+	bump<int64_t>(retired_.resident, size);
+}
+
+void
+BufferPool::trim()
+{
+	ThreadCache &cache = threadCache();
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	for (int i = 0; i < CLASS_COUNT; ++i) {
+		FreeList kept;
+
+		while (void *buffer = cache.lists[i].pop()) {
+			reserve_[i].push(buffer);
+		}
+		while (void *buffer = reserve_[i].pop()) {
+			if (inArena(buffer)) {
+				kept.push(buffer);
+			} else {
+				discard(buffer, i, cache.counters);
+			}
+		}
+		reserve_[i] = kept;
+	}
+}
+
+void
+BufferPool::sum(size_t &hits, size_t &misses, int64_t &resident)
+const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	hits = retired_.hits.load(RELAXED);
+	misses = retired_.misses.load(RELAXED);
+	resident = retired_.resident.load(RELAXED);
+	for (ThreadCaches::const_iterator i(caches_.begin()); i != caches_.end(); ++i) {
+		hits += (*i)->counters.hits.load(RELAXED);
+		misses += (*i)->counters.misses.load(RELAXED);
+		resident += (*i)->counters.resident.load(RELAXED);
+	}
+}
+
+size_t
+BufferPool::hits()
+const
+{
+	size_t hits, misses;
+	int64_t resident;
+
+	sum(hits, misses, resident);
+	return hits;
+}
+
+size_t
+BufferPool::misses()
+const
+{
+	size_t hits, misses;
+	int64_t resident;
+
+	sum(hits, misses, resident);
+	return misses;
+}
+
+size_t
+BufferPool::bytesResident()
+const
+{
+	size_t hits, misses;
+	int64_t resident;
+
+	sum(hits, misses, resident);
+	return resident > 0 ? resident : 0;
+}
@@ -0,0 +1,104 @@
+#ifndef REACTOR_UTIL_BUFFERPOOL_HEADER
+#define REACTOR_UTIL_BUFFERPOOL_HEADER
+
+#include <util/Noncopyable.hh>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace util {
+
+// Recycles I/O buffers in a few fixed size classes. Each thread keeps a
+// small cache per class and spills into a bounded shared reserve; whatever
+// does not fit there goes back to the system, so idle connections cost
+// next to nothing. Requests above the largest class bypass the pool.
+class BufferPool : public Noncopyable {
+public:
+	enum { CLASS_COUNT = 4 };
+
+	static const size_t CLASS_SIZES[CLASS_COUNT];
+	static const size_t MAX_CLASS_SIZE;
+	static const size_t THREAD_CACHE_BYTES;
+	static const size_t DEFAULT_RESERVE_BYTES;
+
+private:
+	struct FreeList {
+		void *head;
+		size_t count;
+
+		FreeList() : head(0), count(0) {}
+
+		void push(void *buffer);
+		void *pop();
+	};
+	// written by one thread only and summed when asked for
+	struct Counters {
+		std::atomic<size_t> hits;
+		std::atomic<size_t> misses;
+		// negative in a thread freeing what others allocated
+		std::atomic<int64_t> resident;
+
+		Counters() : hits(0), misses(0), resident(0) {}
+	};
+	class ThreadCache;
+	typedef std::vector<ThreadCache *> ThreadCaches;
+
+	mutable std::mutex mutex_;
+	FreeList reserve_[CLASS_COUNT];
+	size_t reserveBytes_;
+	// set once under mutex_, fresh() checks it without taking the lock
+	std::atomic<char *> arena_;
+	size_t arenaSize_;
+	size_t arenaUsed_;
+	std::atomic<bool> hugePages_;
+	ThreadCaches caches_;
+	// of threads gone and the arena, under mutex_
+	Counters retired_;
+
+	BufferPool();
+
+	static ThreadCache &threadCache();
+	static int classIndex(size_t size);
+	static size_t threadCacheLimit(int index);
+	static size_t reserveLimit(size_t bytes, int index);
+
+	void *fresh(int index, Counters &counters);
+	void discard(void *buffer, int index, Counters &counters);
+	bool inArena(const void *buffer) const;
+	void refill(FreeList &list, int index);
+	void spill(ThreadCache &cache, int index, size_t count);
+	void sum(size_t &hits, size_t &misses, int64_t &resident) const;
+
+public:
+	static BufferPool &instance();
+
+	// size classes round up, so the buffer may hold more than requested
+	static size_t classSize(size_t size);
+
+	void *allocate(size_t size);
+	// size must be the size passed to allocate()
+	void release(void *buffer, size_t size);
+
+	// Bounds the shared reserve per size class.
+	void setReserveBytes(size_t bytes);
+	// Carves fresh buffers out of one arena backed by huge pages, with
+	// MAP_HUGETLB when the system has them reserved and transparent huge
+	// pages otherwise. Arena buffers are recycled but never unmapped.
+	void useHugePages(size_t arenaSize);
+	bool hugePages() const { return hugePages_; }
+
+	// Returns the calling thread's cache and the shared reserve to the system.
+	void trim();
+
+	// summed over the thread caches
+	size_t hits() const;
+	size_t misses() const;
+	size_t bytesResident() const;
+};
+
+} // namespace util
+
+#endif // REACTOR_UTIL_BUFFERPOOL_HEADER
@@ -1,13 +1,18 @@
 #ifndef REACTOR_UTIL_COMMAND_HEADER
 #define REACTOR_UTIL_COMMAND_HEADER
 
+#include <util/Arena.hh>
+
 namespace util {
 
+// clone(Arena &) places the copy in the arena, which destroys it on reset;
+// the default falls back to a heap copy owned by the arena
 template <typename R>
 class Command0 {
 public:
 	virtual ~Command0() {}
 	virtual Command0 *clone() const = 0;
+	virtual Command0 *clone(Arena &arena) const { return arena.adopt(clone()); }
 	virtual R execute() const = 0;
 };
 
@@ -16,6 +21,7 @@ class Command1 {
 public:
 	virtual ~Command1() {}
 	virtual Command1 *clone() const = 0;
+	virtual Command1 *clone(Arena &arena) const { return arena.adopt(clone()); }
 	virtual R execute(P1) const = 0;
 };
 
@@ -30,6 +36,7 @@ public:
 	MethodCommand0(T &t, M m) : t_(t), m_(m) {}
 
 	virtual MethodCommand0 *clone() const { return new MethodCommand0(*this); }
+	virtual MethodCommand0 *clone(Arena &arena) const { return arena.make<MethodCommand0>(*this); }
 
 	virtual R execute() const { return (t_.*m_)(); }
 };
@@ -45,6 +52,7 @@ public:
 	MethodCommand1(T &t, M m) : t_(t), m_(m) {}
 
 	virtual MethodCommand1 *clone() const { return new MethodCommand1(*this); }
+	virtual MethodCommand1 *clone(Arena &arena) const { return arena.make<MethodCommand1>(*this); }
 
 	virtual R execute(P1 p1) const { return (t_.*m_)(p1); }
 };
@@ -3,6 +3,7 @@
 #include "ErrnoException.hh"
 
 #include <fcntl.h> // blocking
+#include <sys/uio.h>
 #include <unistd.h>
 
 using namespace util;
@@ -15,24 +16,84 @@ size_t
 Fd::read(void *buffer, size_t size)
 const
 {
-	ssize_t ret = ::read(get(), buffer, size);
-
-	if (ret < 0) {
-		throw ErrnoException("read");
-	}
-	return (size_t)ret;
+	return tryRead(buffer, size).check("read");
 }
 
 size_t
 Fd::write(const void *buffer, size_t length)
 const
 {
-	ssize_t ret = ::write(get(), buffer, length);
+	return tryWrite(buffer, length).check("write");
+}
 
-	if (ret < 0) {
-		throw ErrnoException("write");
-	}
-	return (size_t)ret;
+size_t
+Fd::readv(const struct iovec *iov, size_t count)
+const
+{
+	return tryReadv(iov, count).check("readv");
+}
+
+size_t
+Fd::writev(const struct iovec *iov, size_t count)
+const
+{
+	return tryWritev(iov, count).check("writev");
+}
+
+size_t
+Fd::readAt(void *buffer, size_t size, off_t offset)
+const
+{
+	return tryReadAt(buffer, size, offset).check("pread");
+}
+
+size_t
+Fd::writeAt(const void *buffer, size_t length, off_t offset)
+const
+{
+	return tryWriteAt(buffer, length, offset).check("pwrite");
+}
+
+IoResult
+Fd::tryRead(void *buffer, size_t size)
+const
+{
+	return IoResult::fromReturn(::read(get(), buffer, size));
+}
+
+IoResult
+Fd::tryWrite(const void *buffer, size_t length)
+const
+{
+	return IoResult::fromReturn(::write(get(), buffer, length));
+}
+
+IoResult
+Fd::tryReadv(const struct iovec *iov, size_t count)
+const
+{
+	return IoResult::fromReturn(::readv(get(), iov, count));
+}
+
+IoResult
+Fd::tryWritev(const struct iovec *iov, size_t count)
+const
+{
+	return IoResult::fromReturn(::writev(get(), iov, count));
+}
+
+IoResult
+Fd::tryReadAt(void *buffer, size_t size, off_t offset)
+const
+{
+	return IoResult::fromReturn(::pread(get(), buffer, size, offset));
+}
+
+IoResult
+Fd::tryWriteAt(const void *buffer, size_t length, off_t offset)
+const
+{
+	return IoResult::fromReturn(::pwrite(get(), buffer, length, offset));
 }
 
 void
@@ -1,7 +1,12 @@
 #ifndef REACTOR_UTIL_FD_HEADER
 #define REACTOR_UTIL_FD_HEADER
 
+#include <util/IoResult.hh>
+
 #include <cstddef>
+#include <sys/types.h> // off_t
+
+struct iovec;
 
 namespace util {
 
@@ -24,6 +29,19 @@ public:
 
 	size_t read(void *buffer, size_t size) const;
 	size_t write(const void *buffer, size_t length) const;
+	size_t readv(const struct iovec *iov, size_t count) const;
+	size_t writev(const struct iovec *iov, size_t count) const;
+	// positioned, leaving the file offset alone
+	size_t readAt(void *buffer, size_t size, off_t offset) const;
+	size_t writeAt(const void *buffer, size_t length, off_t offset) const;
+
+	// non-throwing variants for the non-blocking paths
+	IoResult tryRead(void *buffer, size_t size) const;
+	IoResult tryWrite(const void *buffer, size_t length) const;
+	IoResult tryReadv(const struct iovec *iov, size_t count) const;
+	IoResult tryWritev(const struct iovec *iov, size_t count) const;
+	IoResult tryReadAt(void *buffer, size_t size, off_t offset) const;
+	IoResult tryWriteAt(const void *buffer, size_t length, off_t offset) const;
 
 	void close();
 
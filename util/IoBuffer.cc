@@ -0,0 +1,354 @@
+#include "IoBuffer.hh"
+
+#include "BufferPool.hh"
+#include "Fd.hh"
+
+#include <algorithm> // std::min
+#include <stdexcept>
+#include <cstring> // memcpy()
+#include <sys/uio.h>
+
+using namespace util;
+
+struct IoBuffer::Segment {
+	size_t refs;
+};
+
+// a segment with its header fills one page-sized pool buffer
+const size_t IoBuffer::SEGMENT_SIZE = 4096 - sizeof(IoBuffer::Segment);
+const size_t IoBuffer::MAX_IOVECS;
+
+IoBuffer::Segment *
+IoBuffer::allocateSegment()
+{
+	Segment *segment = static_cast<Segment *>(BufferPool::instance().allocate(sizeof(Segment) + SEGMENT_SIZE));
+	segment->refs = 1;
+	return segment;
+}
+
+void
+IoBuffer::acquireSegment(Segment *segment)
+{
+	++segment->refs;
+}
+
+void
+IoBuffer::releaseSegment(Segment *segment)
+{
+	if (!--segment->refs) {
+		BufferPool::instance().release(segment, sizeof(Segment) + SEGMENT_SIZE);
+	}
+}
+
+char *
+IoBuffer::bytes(Segment *segment)
+{
+	return reinterpret_cast<char *>(segment + 1);
+}
+
+bool
+IoBuffer::exclusive(const Segment *segment)
+{
+	return segment->refs == 1;
+}
+
+IoBuffer::IoBuffer(const IoBuffer &orig)
+: slices_(orig.slices_)
+, size_(orig.size_)
+{
+	for (Slices::const_iterator i(slices_.begin()); i != slices_.end(); ++i) {
+		acquireSegment(i->segment);
+	}
+}
+
+IoBuffer::~IoBuffer()
+{
+	clear();
+}
+
+IoBuffer &
+IoBuffer::operator=(const IoBuffer &rhs)
+{
+	IoBuffer copy(rhs);
+
+	swap(copy);
+	return *this;
+}
+
+size_t
+IoBuffer::tailRoom()
+const
+{
+	if (slices_.empty() || !exclusive(slices_.back().segment)) {
+		return 0;
+	}
+	return SEGMENT_SIZE - slices_.back().end;
+}
+
+size_t
+IoBuffer::headRoom()
+const
+{
+	if (slices_.empty() || !exclusive(slices_.front().segment)) {
+		return 0;
+	}
+	return slices_.front().begin;
+}
+
+void
+IoBuffer::append(const void *data, size_t length)
+{
+	const char *p = static_cast<const char *>(data);
+
+	while (length) {
+		size_t room = tailRoom();
+
+		if (!room) {
+			slices_.push_back(Slice(allocateSegment(), 0, 0));
+			room = SEGMENT_SIZE;
+		}
+
+		Slice &back = slices_.back();
+		size_t n = std::min(room, length);
+
+		memcpy(bytes(back.segment) + back.end, p, n);
+		back.end += n;
+		size_ += n;
+		p += n;
+		length -= n;
+	}
+}
+
+void
+IoBuffer::append(const IoBuffer &buffer)
+{
+	for (Slices::const_iterator i(buffer.slices_.begin()); i != buffer.slices_.end(); ++i) {
+		acquireSegment(i->segment);
+		slices_.push_back(*i);
+	}
+	size_ += buffer.size_;
+}
+
+void
+IoBuffer::prepend(const void *data, size_t length)
+{
+	const char *end = static_cast<const char *>(data) + length;
+
+	while (length) {
+		size_t room = headRoom();
+
+		if (!room) {
+			slices_.push_front(Slice(allocateSegment(), SEGMENT_SIZE, SEGMENT_SIZE));
+			room = SEGMENT_SIZE;
+		}
+
+		Slice &front = slices_.front();
+		size_t n = std::min(room, length);
+
+		front.begin -= n;
+		end -= n;
+		memcpy(bytes(front.segment) + front.begin, end, n);
+		size_ += n;
+		length -= n;
+	}
+}
+
+IoBuffer
+IoBuffer::slice(size_t offset, size_t length)
+const
+{
+	if (offset > size_ || length > size_ - offset) {
+		throw std::out_of_range("slice is out of buffer");
+	}
+
+	IoBuffer result;
+
+	for (Slices::const_iterator i(slices_.begin()); length && i != slices_.end(); ++i) {
+		size_t n = i->size();
+
+		if (offset >= n) {
+			offset -= n;
+			continue;
+		}
+
+		size_t take = std::min(n - offset, length);
+
+		acquireSegment(i->segment);
+		result.slices_.push_back(Slice(i->segment, i->begin + offset, i->begin + offset + take));
+		result.size_ += take;
+		length -= take;
+		offset = 0;
+	}
+
+	return result;
+}
+
+size_t
+IoBuffer::copyOut(void *data, size_t length, size_t offset)
+const
+{
+	char *p = static_cast<char *>(data);
+	size_t copied = 0;
+
+	for (Slices::const_iterator i(slices_.begin()); copied < length && i != slices_.end(); ++i) {
+		size_t n = i->size();
+
+		if (offset >= n) {
+			offset -= n;
+			continue;
+		}
+
+		size_t take = std::min(n - offset, length - copied);
+
+		memcpy(p + copied, bytes(i->segment) + i->begin + offset, take);
+		copied += take;
+		offset = 0;
+	}
+
+	return copied;
+}
+
+void
+IoBuffer::consume(size_t length)
+{
+	if (length > size_) {
+		throw std::out_of_range("consuming more than buffered");
+	}
+
+	size_ -= length;
+	while (length) {
+		Slice &front = slices_.front();
+		size_t n = std::min(front.size(), length);
+
+		front.begin += n;
+		length -= n;
+		if (!front.size()) {
+			releaseSegment(front.segment);
+			slices_.pop_front();
+		}
+	}
+}
+
+void
+IoBuffer::clear()
+{
+	for (Slices::const_iterator i(slices_.begin()); i != slices_.end(); ++i) {
+		releaseSegment(i->segment);
+	}
+	slices_.clear();
+	size_ = 0;
+}
+
+void
+IoBuffer::swap(IoBuffer &other)
+{
+	slices_.swap(other.slices_);
+	std::swap(size_, other.size_);
+}
+
+size_t
+IoBuffer::fillIovecs(struct iovec *iov, size_t count)
+const
+{
+	size_t filled = 0;
+
+	for (Slices::const_iterator i(slices_.begin()); filled < count && i != slices_.end(); ++i) {
+		if (i->size()) {
+			iov[filled].iov_base = bytes(i->segment) + i->begin;
+			iov[filled].iov_len = i->size();
+			++filled;
+		}
+	}
+
+	return filled;
+}
+
+size_t
+IoBuffer::readFrom(const Fd &fd, size_t length)
+{
+	return tryReadFrom(fd, length).check("readv");
+}
+
+IoResult
+IoBuffer::tryReadFrom(const Fd &fd, size_t length)
+{
+	struct iovec iov[MAX_IOVECS];
+	Segment *fresh[MAX_IOVECS];
+	size_t room = std::min(tailRoom(), length);
+	size_t count = 0, freshCount = 0;
+
+	if (room) {
+		Slice &back = slices_.back();
+
+		iov[count].iov_base = bytes(back.segment) + back.end;
+		iov[count].iov_len = room;
+		++count;
+		length -= room;
+	}
+	while (length && count < MAX_IOVECS) {
+		size_t n = std::min(SEGMENT_SIZE, length);
+
+		fresh[freshCount] = allocateSegment();
+		iov[count].iov_base = bytes(fresh[freshCount]);
+		iov[count].iov_len = n;
+		++freshCount;
+		++count;
+		length -= n;
+	}
+
+	IoResult result(count ? fd.tryReadv(iov, count) : IoResult::success(0));
+
+	if (!result.ok()) {
+		for (size_t i = 0; i < freshCount; ++i) {
+			releaseSegment(fresh[i]);
+		}
+		return result;
+	}
+
+	size_t rd = result.bytes();
+	size_t left = rd;
+
+	if (room) {
+		size_t n = std::min(room, left);
+
+		slices_.back().end += n;
+		left -= n;
+	}
+	for (size_t i = 0; i < freshCount; ++i) {
+		if (left) {
+			size_t n = std::min(SEGMENT_SIZE, left);
+
+			slices_.push_back(Slice(fresh[i], 0, n));
+			left -= n;
+		} else {
+			releaseSegment(fresh[i]);
+		}
+	}
+	size_ += rd;
+
+	return result;
+}
+
+size_t
+IoBuffer::writeTo(const Fd &fd)
+{
+	return tryWriteTo(fd).check("writev");
+}
+
+IoResult
+IoBuffer::tryWriteTo(const Fd &fd)
+{
+	struct iovec iov[MAX_IOVECS];
+	size_t count = fillIovecs(iov, MAX_IOVECS);
+
+	if (!count) {
+		return IoResult::success(0);
+	}
+
+	IoResult result(fd.tryWritev(iov, count));
+
+	if (result.ok()) {
+		consume(result.bytes());
+	}
+	return result;
+}
@@ -0,0 +1,79 @@
+#ifndef REACTOR_UTIL_IOBUFFER_HEADER
+#define REACTOR_UTIL_IOBUFFER_HEADER
+
+#include <util/IoResult.hh>
+
+#include <deque>
+#include <cstddef>
+
+struct iovec;
+
+namespace util {
+
+class Fd;
+
+class IoBuffer {
+public:
+	static const size_t SEGMENT_SIZE;
+	static const size_t MAX_IOVECS = 64;
+
+private:
+	struct Segment;
+
+	struct Slice {
+		Segment *segment;
+		size_t begin;
+		size_t end;
+
+		Slice(Segment *segment0, size_t begin0, size_t end0)
+		: segment(segment0)
+		, begin(begin0)
+		, end(end0)
+		{}
+
+		size_t size() const { return end - begin; }
+	};
+	typedef std::deque<Slice> Slices;
+
+	Slices slices_;
+	size_t size_;
+
+	static Segment *allocateSegment();
+	static void acquireSegment(Segment *segment);
+	static void releaseSegment(Segment *segment);
+	static char *bytes(Segment *segment);
+	static bool exclusive(const Segment *segment);
+
+	size_t tailRoom() const;
+	size_t headRoom() const;
+
+public:
+	IoBuffer() : size_(0) {}
+	IoBuffer(const IoBuffer &orig);
+	~IoBuffer();
+
+	IoBuffer &operator=(const IoBuffer &rhs);
+
+	size_t size() const { return size_; }
+	bool empty() const { return !size_; }
+	size_t segmentCount() const { return slices_.size(); }
+
+	void append(const void *data, size_t length);
+	void append(const IoBuffer &buffer);
+	void prepend(const void *data, size_t length);
+	IoBuffer slice(size_t offset, size_t length) const;
+	size_t copyOut(void *data, size_t length, size_t offset = 0) const;
+	void consume(size_t length);
+	void clear();
+	void swap(IoBuffer &other);
+
+	size_t fillIovecs(struct iovec *iov, size_t count) const;
+	size_t readFrom(const Fd &fd, size_t length);
+	size_t writeTo(const Fd &fd);
+	IoResult tryReadFrom(const Fd &fd, size_t length);
+	IoResult tryWriteTo(const Fd &fd);
+};
+
+} // namespace util
+
+#endif // REACTOR_UTIL_IOBUFFER_HEADER
@@ -0,0 +1,49 @@
+#ifndef REACTOR_UTIL_IORESULT_HEADER
+#define REACTOR_UTIL_IORESULT_HEADER
+
+#include <util/ErrnoException.hh>
+
+#include <cerrno>
+#include <cstddef>
+#include <sys/types.h> // ssize_t
+
+namespace util {
+
+// Outcome of a non-throwing I/O call: a byte count or an errno value.
+// EAGAIN and EINTR are ordinary on non-blocking descriptors and are
+// reported as transient instead of being thrown.
+class IoResult {
+	size_t bytes_;
+	int error_;
+
+	IoResult(size_t bytes, int error) : bytes_(bytes), error_(error) {}
+
+public:
+	static IoResult success(size_t bytes) { return IoResult(bytes, 0); }
+	static IoResult failure(int error) { return IoResult(0, error); }
+	// must be called right after the system call, before errno can change
+	static IoResult fromReturn(ssize_t ret) { return ret < 0 ? failure(errno) : success(ret); }
+
+	bool ok() const { return !error_; }
+	size_t bytes() const { return bytes_; }
+	int error() const { return error_; }
+
+	bool wouldBlock() const { return error_ == EAGAIN || error_ == EWOULDBLOCK; }
+	bool interrupted() const { return error_ == EINTR; }
+	bool transient() const { return wouldBlock() || interrupted(); }
+
+	// the byte count, or an ErrnoException for callers that treat any error as fatal
+	size_t
+	check(const std::string &name)
+	const
+	{
+		if (error_) {
+			throw ErrnoException(name, error_);
+		}
+		return bytes_;
+	}
+};
+
+} // namespace util
+
+#endif // REACTOR_UTIL_IORESULT_HEADER
@@ -2,16 +2,17 @@
 
 #include "ErrnoException.hh"
 
+#include <fcntl.h> // O_* flags for pipe2
 #include <unistd.h>
 
 using namespace util;
 
-Pipe::Pipe()
+Pipe::Pipe(int flags)
 {
 	int fds[2];
 
-	if (pipe(fds)) {
-		throw ErrnoException("pipe");
+	if (pipe2(fds, flags)) {
+		throw ErrnoException("pipe2");
 	}
 
 	readFd_.reset(fds[0]);
@@ -10,9 +10,13 @@ class Pipe {
 	AutoFd writeFd_;
 
 public:
-	Pipe();
+	explicit Pipe(int flags = 0);
 
 	const Fd &readFd() const { return readFd_; }
+	const Fd &writeFd() const { return writeFd_; }
+	// hand an end over to a new owner, the pipe no longer closes it
+	int releaseReadFd() { return readFd_.release(); }
+	int releaseWriteFd() { return writeFd_.release(); }
 
 	size_t write(const void *buffer, size_t length) const;
 };
@@ -0,0 +1,62 @@
+#include "SigPipeGuard.hh"
+
+#include <cerrno>
+#include <pthread.h>
+
+using namespace util;
+
+namespace {
+
+sigset_t
+pipeSet()
+{
+	sigset_t set;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	return set;
+}
+
+bool
+pending()
+{
+	sigset_t set;
+
+	sigpending(&set);
+	return sigismember(&set, SIGPIPE);
+}
+
+} // namespace
+
+SigPipeGuard::SigPipeGuard(bool active)
+: active_(active)
+, wasPending_(false)
+{
+	if (!active_) {
+		return;
+	}
+
+	sigset_t pipe(pipeSet());
+
+	pthread_sigmask(SIG_BLOCK, &pipe, &old_);
+	wasPending_ = pending();
+}
+
+// a signal pending from before belongs to someone else and stays
+SigPipeGuard::~SigPipeGuard()
+{
+	if (!active_) {
+		return;
+	}
+
+	int error = errno;
+
+	if (!wasPending_ && pending()) {
+		sigset_t pipe(pipeSet());
+		struct timespec zero = { 0, 0 };
+
+		sigtimedwait(&pipe, 0, &zero);
+	}
+	pthread_sigmask(SIG_SETMASK, &old_, 0);
+	errno = error;
+}
@@ -0,0 +1,26 @@
+#ifndef REACTOR_UTIL_SIGPIPEGUARD_HEADER
+#define REACTOR_UTIL_SIGPIPEGUARD_HEADER
+
+#include <util/Noncopyable.hh>
+
+#include <signal.h>
+
+namespace util {
+
+// Keeps SIGPIPE blocked on the calling thread while it lives and consumes
+// one raised meanwhile, for calls that take no MSG_NOSIGNAL such as
+// splice() and sendfile(). Such a call fails with EPIPE instead. An
+// inactive guard leaves the mask alone.
+class SigPipeGuard : public Noncopyable {
+	bool active_;
+	sigset_t old_;
+	bool wasPending_;
+
+public:
+	explicit SigPipeGuard(bool active = true);
+	~SigPipeGuard();
+};
+
+} // namespace util
+
+#endif // REACTOR_UTIL_SIGPIPEGUARD_HEADER
@@ -3,11 +3,15 @@
 all: out/libutil.a
 
 libutil_SOURCE_NAMES := \
+	Arena.cc \
 	AutoFd.cc \
+	BufferPool.cc \
 	DiffTime.cc \
 	ErrnoException.cc \
 	Fd.cc \
+	IoBuffer.cc \
 	Pipe.cc \
+	SigPipeGuard.cc \
 	Time.cc
 
 libutil_SOURCES := $(addprefix util/,$(libutil_SOURCE_NAMES))